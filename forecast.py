@@ -1,4 +1,5 @@
 import numpy as np
+import fcforecast
 import tkinter as tk
 from tkinter import ttk
 from matplotlib.figure import Figure
@@ -47,6 +48,16 @@ parameter_sets = {
 # Default parameter set
 default_set = "Physical Server/Co-location"
 
+# The "monthly" extra GB cost as a finance rules model for the native
+# engine: every month over the initial storage pays for the excess that
+# month. "one-time" is the engine's built-in finance.
+monthly_extra_gb_rules = """
+initial investment = initial_investment
+monthly expenses = (colocation_expense + marketing_expense) * step_months
+extra storage = (storage - initial_storage) * cost_per_gb * step_months if storage > initial_storage
+revenue storage = storage * price_per_gb * step_months
+"""
+
 # Function to run the forecast
 def run_forecast():
     global cancel_forecast
@@ -57,32 +68,28 @@ def run_forecast():
         cancel_forecast = True
         progress_window.destroy()
 
-    initial_investment = float(initial_investment_entry.get())
-    colocation_expense = float(colocation_expense_entry.get())
-    marketing_expense = float(marketing_expense_entry.get())
-    months = int(months_entry.get())
-    price_per_gb = float(price_per_gb_entry.get())
-    avg_gb_per_user = float(avg_gb_per_user_entry.get())
-    initial_users = int(initial_users_entry.get())
-    initial_companies = int(initial_companies_entry.get())
-    min_employees_per_company = int(min_employees_entry.get())
-    max_employees_per_company = int(max_employees_entry.get())
-    acquisition_rate = float(acquisition_rate_entry.get())
-    mean_company_size = float(mean_company_size_entry.get())
-    cost_per_gb = float(cost_per_gb_entry.get())
-    initial_storage = float(initial_storage_entry.get())
-    iterations = int(iterations_entry.get())
-    extra_gb_cost_type = extra_gb_cost_type_combobox.get()
-
-    expenses = {
-        "colocation": colocation_expense,
-        "marketing": marketing_expense
+    params = {
+        "initial_investment": float(initial_investment_entry.get()),
+        "colocation_expense": float(colocation_expense_entry.get()),
+        "marketing_expense": float(marketing_expense_entry.get()),
+        "months": int(months_entry.get()),
+        "price_per_gb": float(price_per_gb_entry.get()),
+        "avg_gb_per_user": float(avg_gb_per_user_entry.get()),
+        "initial_users": int(initial_users_entry.get()),
+        "initial_companies": int(initial_companies_entry.get()),
+        "min_employees_per_company": int(min_employees_entry.get()),
+        "max_employees_per_company": int(max_employees_entry.get()),
+        "acquisition_rate": float(acquisition_rate_entry.get()),
+        "mean_company_size": float(mean_company_size_entry.get()),
+        "cost_per_gb": float(cost_per_gb_entry.get()),
+        "initial_storage": float(initial_storage_entry.get()),
+        "iterations": int(iterations_entry.get()),
     }
-
-    cumulative_profits = []
-    monthly_storage_usages = []
-    break_even_months = []
-    no_return_count = 0
+    months = params["months"]
+    price_per_gb = params["price_per_gb"]
+    avg_gb_per_user = params["avg_gb_per_user"]
+    extra_gb_cost_type = extra_gb_cost_type_combobox.get()
+    rules = monthly_extra_gb_rules if extra_gb_cost_type == "monthly" else None
 
     # Create progress window
     progress_window = tk.Toplevel(root)
@@ -93,66 +100,52 @@ def run_forecast():
     progress_bar.pack(pady=10)
     cancel_button = ttk.Button(progress_window, text="Cancel", command=cancel)
     cancel_button.pack(pady=10)
+    progress_window.protocol("WM_DELETE_WINDOW", cancel)
+    # The engine runs one forecast at a time; keep the main window from
+    # starting another while this one redraws.
+    progress_window.grab_set()
+    run_button.state(['disabled'])
+
+    # The engine calls back between rounds of paths; returning True cancels.
+    def progress(fraction):
+        if not cancel_forecast:
+            progress_bar['value'] = fraction * 100
+            progress_window.update()
+        return cancel_forecast
+
+    try:
+        result = fcforecast.run(params, rules=rules, progress=progress)
+    except (ValueError, RuntimeError) as error:
+        result = None
+        results_text.delete(1.0, tk.END)
+        results_text.insert(tk.END, f"Forecast failed: {error}\n")
+    finally:
+        run_button.state(['!disabled'])
 
-    for i in range(iterations):
+    if not cancel_forecast:
+        progress_window.destroy()
+    if result is None:
         if cancel_forecast:
-            break
-
-        company_growth = [initial_companies]
-        user_growth = [initial_users]
-
-        for month in range(1, months):
-            new_companies = company_growth[-1] * acquisition_rate * np.exp(-company_growth[-1] / 10)
-            company_growth.append(company_growth[-1] + new_companies)
-            
-            weights = np.exp(-np.arange(min_employees_per_company, max_employees_per_company + 1) / mean_company_size)
-            new_users = new_companies * np.random.choice(np.arange(min_employees_per_company, max_employees_per_company + 1), p=weights/weights.sum())
-            user_growth.append(user_growth[-1] + new_users)
-
-        monthly_storage_usage = [users * avg_gb_per_user for users in user_growth]
-        monthly_revenue = [usage * price_per_gb for usage in monthly_storage_usage]
-
-        total_monthly_expense = [sum(expenses.values())] * months
-        one_time_extra_usage_cost = 0
-        extra_usage_applied = False
-        for month, usage in enumerate(monthly_storage_usage):
-            if usage > initial_storage and not extra_usage_applied:
-                extra_usage = usage - initial_storage
-                if extra_gb_cost_type == "one-time":
-                    one_time_extra_usage_cost += extra_usage * cost_per_gb
-                    extra_usage_applied = True
-                elif extra_gb_cost_type == "monthly":
-                    total_monthly_expense[month] += extra_usage * cost_per_gb
-
-        monthly_net_profit = [revenue - expense for revenue, expense in zip(monthly_revenue, total_monthly_expense)]
-        cumulative_profit = np.cumsum(monthly_net_profit) - initial_investment
-        cumulative_profit = [profit - one_time_extra_usage_cost if i == 0 else profit for i, profit in enumerate(cumulative_profit)]
-
-        cumulative_profits.append(cumulative_profit)
-        monthly_storage_usages.append(monthly_storage_usage)
-        break_even_month = next((i for i, profit in enumerate(cumulative_profit) if profit >= 0), None)
-        break_even_months.append(break_even_month)
-        if break_even_month is None:
-            no_return_count += 1
-
-        progress_bar['value'] = (i + 1) / iterations * 100
-        progress_window.update_idletasks()
-
-    progress_window.destroy()
-
-    if cancel_forecast:
-        results_text.delete(1.0, tk.END)
-        results_text.insert(tk.END, "Forecast cancelled.\n")
+            results_text.delete(1.0, tk.END)
+            results_text.insert(tk.END, "Forecast cancelled.\n")
         return
 
-    avg_cumulative_profit = np.mean(cumulative_profits, axis=0)
-    std_cumulative_profit = np.std(cumulative_profits, axis=0)
-    avg_monthly_storage_usage = np.mean(monthly_storage_usages, axis=0)
-    std_monthly_storage_usage = np.std(monthly_storage_usages, axis=0)
-    avg_break_even_month = np.mean([month for month in break_even_months if month is not None])
-
-    total_net_profit = avg_cumulative_profit[-1]
-    risk_of_no_return = (no_return_count / iterations) * 100
+    # Arrays over the engine's own memory, no copies
+    company_growth = result["company_growth"]
+    user_growth = result["avg_user_growth"]
+    avg_cumulative_profit = result["avg_cumulative_profit"]
+    std_cumulative_profit = result["std_cumulative_profit"]
+    avg_monthly_storage_usage = result["avg_monthly_storage_usage"]
+    std_monthly_storage_usage = result["std_monthly_storage_usage"]
+    avg_break_even_month = result["avg_break_even_month"] if result["avg_break_even_month"] >= 0 else None
+
+    total_net_profit = result["total_net_profit"]
+    risk_of_no_return = result["risk_of_no_return"]
+
+    # Averaged monthly figures for the table
+    monthly_revenue = avg_monthly_storage_usage * price_per_gb
+    monthly_net_profit = np.diff(avg_cumulative_profit, prepend=-params["initial_investment"])
+    total_monthly_expense = monthly_revenue - monthly_net_profit
 
     results_text.delete(1.0, tk.END)
     results_text.insert(tk.END, "\nCompany and User Growth Metrics (Averaged):\n")
@@ -7,7 +7,7 @@ a = Analysis(
     pathex=['.'],
     binaries=[],
     datas=[],
-    hiddenimports=['numpy', 'tkinter', 'matplotlib'],
+    hiddenimports=['fcforecast', 'numpy', 'tkinter', 'matplotlib'],
     hookspath=[],
     runtime_hooks=[],
     excludes=[],
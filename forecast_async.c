@@ -0,0 +1,158 @@
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "forecast_async.h"
+
+struct ForecastAsync {
+    ForecastPool *pool;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int shutdown;
+    int cancel;                 // stop the run in flight, publish nothing
+    int pending;                // params/seed wait for the thread
+    ParameterSet params;
+    uint64_t seed;
+    unsigned submitted;         // id of the newest submission
+    ForecastAsyncStatus status;
+    ForecastResult latest;      // newest estimate of any run
+    unsigned latest_version;
+    unsigned polled_version;
+};
+
+typedef struct {
+    ForecastAsync *async;
+    unsigned run;
+} RunContext;
+
+// A run is stale once superseded or cancelled; it then stops at its next
+// report without publishing, so the UI never shows a mix of two runs.
+static int run_stale(const ForecastAsync *async, unsigned run) {
+    return async->shutdown || async->cancel || async->submitted != run;
+}
+
+static int report_progress(void *ctx, const ForecastResult *partial) {
+    RunContext *run = ctx;
+    ForecastAsync *async = run->async;
+
+    pthread_mutex_lock(&async->lock);
+    int stop = run_stale(async, run->run);
+    if (!stop && forecast_result_copy(&async->latest, partial) == 0) {
+        async->latest_version++;
+        async->status.paths_done = partial->iterations;
+    }
+    pthread_mutex_unlock(&async->lock);
+    return stop;
+}
+
+static void *async_main(void *arg) {
+    ForecastAsync *async = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&async->lock);
+        while (!async->pending && !async->shutdown) {
+            pthread_cond_wait(&async->wake, &async->lock);
+        }
+        if (async->shutdown) {
+            pthread_mutex_unlock(&async->lock);
+            break;
+        }
+        ParameterSet params = async->params;
+        RunContext run = {async, async->submitted};
+        ForecastOptions options = {async->pool, async->seed, report_progress, &run};
+        async->pending = 0;
+        async->cancel = 0;
+        pthread_mutex_unlock(&async->lock);
+
+        ForecastResult result;
+        int status = forecast_run(&params, &options, &result);
+
+        pthread_mutex_lock(&async->lock);
+        if (!run_stale(async, run.run)) {
+            if (status == 0 && forecast_result_copy(&async->latest, &result) == 0) {
+                async->latest_version++;
+                async->status.state = FORECAST_ASYNC_DONE;
+                async->status.paths_done = result.iterations;
+            } else {
+                async->status.state = status == FORECAST_CANCELLED ? FORECAST_ASYNC_CANCELLED : FORECAST_ASYNC_FAILED;
+            }
+        }
+        pthread_mutex_unlock(&async->lock);
+        if (status == 0) forecast_result_free(&result);
+    }
+    return NULL;
+}
+
+ForecastAsync *forecast_async_create(int threads) {
+    ForecastAsync *async = calloc(1, sizeof(ForecastAsync));
+    if (!async) return NULL;
+    if (!(async->pool = forecast_pool_create(threads))) {
+        free(async);
+        return NULL;
+    }
+    pthread_mutex_init(&async->lock, NULL);
+    pthread_cond_init(&async->wake, NULL);
+    if (pthread_create(&async->thread, NULL, async_main, async) != 0) {
+        pthread_cond_destroy(&async->wake);
+        pthread_mutex_destroy(&async->lock);
+        forecast_pool_destroy(async->pool);
+        free(async);
+        return NULL;
+    }
+    return async;
+}
+
+void forecast_async_destroy(ForecastAsync *async) {
+    if (!async) return;
+
+    pthread_mutex_lock(&async->lock);
+    async->shutdown = 1;
+    pthread_cond_signal(&async->wake);
+    pthread_mutex_unlock(&async->lock);
+    pthread_join(async->thread, NULL);
+
+    forecast_result_free(&async->latest);
+    forecast_pool_destroy(async->pool);
+    pthread_cond_destroy(&async->wake);
+    pthread_mutex_destroy(&async->lock);
+    free(async);
+}
+
+unsigned forecast_async_submit(ForecastAsync *async, const ParameterSet *params, uint64_t seed) {
+    pthread_mutex_lock(&async->lock);
+    unsigned run = ++async->submitted;
+    async->params = *params;
+    async->seed = seed;
+    async->pending = 1;
+    async->status.state = FORECAST_ASYNC_RUNNING;
+    async->status.run = run;
+    async->status.paths_done = 0;
+    async->status.paths_total = params->iterations;
+    async->polled_version = async->latest_version;
+    pthread_cond_signal(&async->wake);
+    pthread_mutex_unlock(&async->lock);
+    return run;
+}
+
+void forecast_async_cancel(ForecastAsync *async) {
+    pthread_mutex_lock(&async->lock);
+    async->pending = 0;
+    async->cancel = 1;
+    if (async->status.state == FORECAST_ASYNC_RUNNING) {
+        async->status.state = FORECAST_ASYNC_CANCELLED;
+    }
+    pthread_mutex_unlock(&async->lock);
+}
+
+int forecast_async_poll(ForecastAsync *async, ForecastResult *result, ForecastAsyncStatus *status) {
+    pthread_mutex_lock(&async->lock);
+    int updated = 0;
+    if (async->latest_version != async->polled_version &&
+        forecast_result_copy(result, &async->latest) == 0) {
+        async->polled_version = async->latest_version;
+        updated = 1;
+    }
+    if (status) *status = async->status;
+    pthread_mutex_unlock(&async->lock);
+    return updated;
+}
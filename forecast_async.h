@@ -0,0 +1,47 @@
+#ifndef FORECAST_ASYNC_H
+#define FORECAST_ASYNC_H
+
+#include <stdint.h>
+
+#include "forecast_core.h"
+
+// Runs forecasts on a background thread so a front-end can keep drawing
+// while paths are simulated. Each submission supersedes the previous one:
+// a run still in flight is cancelled at its next progress report and only
+// the newest parameters are run.
+typedef struct ForecastAsync ForecastAsync;
+
+typedef enum {
+    FORECAST_ASYNC_IDLE,        // nothing submitted yet
+    FORECAST_ASYNC_RUNNING,     // queued or simulating; result is partial
+    FORECAST_ASYNC_DONE,
+    FORECAST_ASYNC_CANCELLED,
+    FORECAST_ASYNC_FAILED       // invalid parameters or OOM
+} ForecastAsyncState;
+
+typedef struct {
+    ForecastAsyncState state;
+    unsigned run;           // id returned by the submission this refers to
+    int paths_done;
+    int paths_total;
+} ForecastAsyncStatus;
+
+// Runs on a pool of its own with `threads` workers (<= 0: one per CPU).
+// forecast_pool_run() serializes the users of a pool, so sharing the
+// front-end's would block its per-frame work behind a whole round here.
+ForecastAsync *forecast_async_create(int threads);
+// Cancels any run in flight and joins the background thread.
+void forecast_async_destroy(ForecastAsync *async);
+
+// Queues a run of params and returns its id.
+unsigned forecast_async_submit(ForecastAsync *async, const ParameterSet *params, uint64_t seed);
+void forecast_async_cancel(ForecastAsync *async);
+
+// Copies the newest estimate of the newest submission into result when it
+// changed since the last poll and returns 1, else leaves result alone and
+// returns 0. Estimates are over the paths finished so far and sharpen as
+// batches complete. status may be NULL. Meant to be called once per frame
+// by one thread.
+int forecast_async_poll(ForecastAsync *async, ForecastResult *result, ForecastAsyncStatus *status);
+
+#endif
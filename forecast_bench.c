@@ -0,0 +1,350 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "forecast_core.h"
+
+#ifndef FORECAST_VERSION
+#define FORECAST_VERSION "unknown"
+#endif
+
+#define BENCH_MAX_VALUES 16
+
+// Cells above this many path-months are skipped unless -b raises it; the
+// largest default cell (10^6 paths over 3650 months) takes minutes per run.
+#define BENCH_DEFAULT_BUDGET 1e8
+
+typedef struct {
+    int values[BENCH_MAX_VALUES];
+    int count;
+} IntList;
+
+typedef struct {
+    int preset;
+    int iterations;
+    int months;
+    int threads;
+    int skipped;
+    double best_seconds;
+    double median_seconds;
+    long peak_rss_kb;
+    double scaling_efficiency;      // NAN without a one-thread cell
+} BenchCell;
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-p presets] [-n iterations] [-m months] [-t threads] [-r repeats]\n"
+                    "       [-b max path-months] [-s seed] [-o out.json] [-c baseline.json] [-T tolerance]\n"
+                    "Lists are comma separated, e.g. -n 100,10000 -t 1,2,4.\n", prog);
+}
+
+static int parse_list(const char *arg, int min, IntList *list) {
+    list->count = 0;
+    const char *at = arg;
+    while (*at) {
+        char *end;
+        long value = strtol(at, &end, 10);
+        if (end == at || value < min || list->count == BENCH_MAX_VALUES) return -1;
+        list->values[list->count++] = (int)value;
+        at = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') return -1;
+    }
+    return list->count > 0 ? 0 : -1;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Resets the kernel's peak-RSS mark so each cell reports its own peak.
+// Falls back to the process-wide peak where /proc is not writable.
+static void reset_peak_rss(void) {
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    if (!f) return;
+    fputs("5", f);
+    fclose(f);
+}
+
+static long peak_rss_kb(void) {
+    char line[256];
+    long kb = -1;
+    FILE *f = fopen("/proc/self/status", "r");
+    if (f) {
+        while (fgets(line, sizeof(line), f)) {
+            if (sscanf(line, "VmHWM: %ld kB", &kb) == 1) break;
+        }
+        fclose(f);
+    }
+    if (kb < 0) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        kb = usage.ru_maxrss;
+    }
+    return kb;
+}
+
+static void cpu_model(char *model, size_t size) {
+    char line[256];
+    snprintf(model, size, "unknown");
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    if (!f) return;
+    while (fgets(line, sizeof(line), f)) {
+        char *colon = strchr(line, ':');
+        if (strncmp(line, "model name", 10) == 0 && colon) {
+            colon += 1 + (colon[1] == ' ');
+            colon[strcspn(colon, "\n")] = '\0';
+            snprintf(model, size, "%s", colon);
+            break;
+        }
+    }
+    fclose(f);
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Times `repeats` runs of the cell's parameters; 0 on success.
+static int run_cell(BenchCell *cell, ForecastPool *pool, uint64_t seed, int repeats) {
+    ParameterSet params = parameter_sets[cell->preset];
+    params.iterations = cell->iterations;
+    params.months = cell->months;
+    ForecastOptions options = {pool, seed};
+    double seconds[BENCH_MAX_VALUES];
+
+    reset_peak_rss();
+    for (int r = 0; r < repeats; r++) {
+        ForecastResult result;
+        double start = now_seconds();
+        if (forecast_run(&params, &options, &result) != 0) return -1;
+        seconds[r] = now_seconds() - start;
+        forecast_result_free(&result);
+    }
+    cell->peak_rss_kb = peak_rss_kb();
+    qsort(seconds, repeats, sizeof(double), compare_doubles);
+    cell->best_seconds = seconds[0];
+    cell->median_seconds = seconds[repeats / 2];
+    return 0;
+}
+
+static double paths_per_second(const BenchCell *cell) {
+    return cell->iterations / cell->best_seconds;
+}
+
+static double ns_per_path_month(const BenchCell *cell) {
+    return cell->best_seconds * 1e9 / ((double)cell->iterations * cell->months);
+}
+
+// One cell per line, so baselines can be read back without a JSON parser.
+static void write_json(FILE *out, const BenchCell *cells, int count, int repeats, uint64_t seed) {
+    char model[128];
+    cpu_model(model, sizeof(model));
+    fprintf(out, "{\n  \"version\": \"%s\",\n  \"cpu_model\": \"%s\",\n  \"online_cpus\": %ld,\n"
+                 "  \"repeats\": %d,\n  \"seed\": %llu,\n  \"cells\": [\n",
+            FORECAST_VERSION, model, sysconf(_SC_NPROCESSORS_ONLN), repeats, (unsigned long long)seed);
+    for (int i = 0; i < count; i++) {
+        const BenchCell *cell = &cells[i];
+        fprintf(out, "    {\"preset\": %d, \"iterations\": %d, \"months\": %d, \"threads\": %d",
+                cell->preset, cell->iterations, cell->months, cell->threads);
+        if (cell->skipped) {
+            fprintf(out, ", \"skipped\": true}");
+        } else {
+            fprintf(out, ", \"best_s\": %.6f, \"median_s\": %.6f, \"paths_per_sec\": %.1f"
+                         ", \"ns_per_path_month\": %.3f, \"peak_rss_kb\": %ld",
+                    cell->best_seconds, cell->median_seconds, paths_per_second(cell),
+                    ns_per_path_month(cell), cell->peak_rss_kb);
+            if (!isnan(cell->scaling_efficiency)) {
+                fprintf(out, ", \"scaling_efficiency\": %.3f}", cell->scaling_efficiency);
+            } else {
+                fprintf(out, ", \"scaling_efficiency\": null}");
+            }
+        }
+        fprintf(out, "%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+static int json_int(const char *line, const char *key, int *value) {
+    const char *at = strstr(line, key);
+    return at && sscanf(at + strlen(key), " : %d", value) == 1 ? 0 : -1;
+}
+
+static int json_double(const char *line, const char *key, double *value) {
+    const char *at = strstr(line, key);
+    return at && sscanf(at + strlen(key), " : %lf", value) == 1 ? 0 : -1;
+}
+
+// Compares ns per path-month with a baseline written by -o and prints every
+// cell slower by more than `tolerance` (a fraction). Returns the number of
+// regressions, or -1 if the baseline cannot be read.
+static int compare_baseline(const char *path, const BenchCell *cells, int count, double tolerance) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char line[512];
+    int regressions = 0;
+    while (fgets(line, sizeof(line), f)) {
+        int preset, iterations, months, threads;
+        double baseline;
+        if (json_int(line, "\"preset\"", &preset) != 0 || json_int(line, "\"iterations\"", &iterations) != 0 ||
+            json_int(line, "\"months\"", &months) != 0 || json_int(line, "\"threads\"", &threads) != 0 ||
+            json_double(line, "\"ns_per_path_month\"", &baseline) != 0) {
+            continue;
+        }
+        for (int i = 0; i < count; i++) {
+            const BenchCell *cell = &cells[i];
+            if (cell->skipped || cell->preset != preset || cell->iterations != iterations ||
+                cell->months != months || cell->threads != threads) {
+                continue;
+            }
+            double current = ns_per_path_month(cell);
+            if (current > baseline * (1 + tolerance)) {
+                printf("REGRESSION preset %d, %d paths, %d months, %d threads: %.3f -> %.3f ns/path-month (%+.1f%%)\n",
+                       preset, iterations, months, threads, baseline, current, (current / baseline - 1) * 100);
+                regressions++;
+            }
+        }
+    }
+    fclose(f);
+    return regressions;
+}
+
+static void default_threads(IntList *list) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    list->count = 0;
+    for (long threads = 1; threads < cpus && list->count < BENCH_MAX_VALUES - 1; threads *= 2) {
+        list->values[list->count++] = (int)threads;
+    }
+    list->values[list->count++] = cpus > 0 ? (int)cpus : 1;
+}
+
+int main(int argc, char **argv) {
+    IntList presets = {{0}, 0};
+    IntList iterations = {{100, 1000, 10000, 100000, 1000000}, 5};
+    IntList months = {{36, 365, 3650}, 3};
+    IntList threads;
+    int repeats = 3;
+    double budget = BENCH_DEFAULT_BUDGET;
+    double tolerance = 0.10;
+    unsigned long long seed = 0;
+    const char *output = NULL;
+    const char *baseline = NULL;
+    int opt;
+
+    for (int i = 0; i < parameter_set_count && i < BENCH_MAX_VALUES; i++) {
+        presets.values[presets.count++] = i;
+    }
+    default_threads(&threads);
+
+    while ((opt = getopt(argc, argv, "p:n:m:t:r:b:s:o:c:T:h")) != -1) {
+        int bad = 0;
+        switch (opt) {
+        case 'p': bad = parse_list(optarg, 0, &presets); break;
+        case 'n': bad = parse_list(optarg, 1, &iterations); break;
+        case 'm': bad = parse_list(optarg, 1, &months); break;
+        case 't': bad = parse_list(optarg, 1, &threads); break;
+        case 'r': repeats = atoi(optarg); break;
+        case 'b': budget = atof(optarg); break;
+        case 's': seed = strtoull(optarg, NULL, 0); break;
+        case 'o': output = optarg; break;
+        case 'c': baseline = optarg; break;
+        case 'T': tolerance = atof(optarg); break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+        if (bad) {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (repeats < 1 || repeats > BENCH_MAX_VALUES) {
+        usage(argv[0]);
+        return 2;
+    }
+    for (int i = 0; i < presets.count; i++) {
+        if (presets.values[i] >= parameter_set_count) {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    ForecastPool *pools[BENCH_MAX_VALUES];
+    for (int t = 0; t < threads.count; t++) {
+        pools[t] = forecast_pool_create(threads.values[t]);
+    }
+
+    int total = presets.count * months.count * iterations.count * threads.count;
+    BenchCell *cells = calloc(total, sizeof(BenchCell));
+    if (!cells) return 1;
+
+    printf("%-28s %9s %6s %4s %10s %13s %9s %9s %6s\n", "preset", "paths", "months", "thr",
+           "best s", "paths/s", "ns/p-m", "RSS MiB", "eff");
+    int count = 0;
+    int status = 0;
+    for (int p = 0; p < presets.count; p++) {
+        for (int m = 0; m < months.count; m++) {
+            for (int n = 0; n < iterations.count; n++) {
+                const BenchCell *single = NULL;
+                for (int t = 0; t < threads.count; t++) {
+                    BenchCell *cell = &cells[count++];
+                    cell->preset = presets.values[p];
+                    cell->iterations = iterations.values[n];
+                    cell->months = months.values[m];
+                    cell->threads = forecast_pool_threads(pools[t]);
+                    cell->scaling_efficiency = NAN;
+                    if ((double)cell->iterations * cell->months > budget) {
+                        cell->skipped = 1;
+                        continue;
+                    }
+                    if (run_cell(cell, pools[t], seed, repeats) != 0) {
+                        fprintf(stderr, "forecast failed: preset %d, %d paths, %d months\n",
+                                cell->preset, cell->iterations, cell->months);
+                        cell->skipped = 1;
+                        status = 1;
+                        continue;
+                    }
+                    if (cell->threads == 1) single = cell;
+                    if (single) {
+                        cell->scaling_efficiency = single->best_seconds / (cell->best_seconds * cell->threads);
+                    }
+                    printf("%-28s %9d %6d %4d %10.4f %13.0f %9.2f %9.1f %6.2f\n",
+                           parameter_set_names[cell->preset], cell->iterations, cell->months, cell->threads,
+                           cell->best_seconds, paths_per_second(cell), ns_per_path_month(cell),
+                           cell->peak_rss_kb / 1024.0, cell->scaling_efficiency);
+                    fflush(stdout);
+                }
+            }
+        }
+    }
+
+    if (output) {
+        FILE *out = fopen(output, "w");
+        if (!out) {
+            fprintf(stderr, "cannot write %s\n", output);
+            status = 1;
+        } else {
+            write_json(out, cells, count, repeats, seed);
+            fclose(out);
+        }
+    }
+    if (baseline) {
+        int regressions = compare_baseline(baseline, cells, count, tolerance);
+        if (regressions < 0) {
+            fprintf(stderr, "cannot read baseline %s\n", baseline);
+            status = 1;
+        } else if (regressions > 0) {
+            printf("%d cell(s) slower than %s by more than %.0f%%\n", regressions, baseline, tolerance * 100);
+            if (status == 0) status = 3;
+        }
+    }
+
+    for (int t = 0; t < threads.count; t++) {
+        forecast_pool_destroy(pools[t]);
+    }
+    free(cells);
+    return status;
+}
@@ -0,0 +1,302 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "forecast_cache.h"
+#include "forecast_sketch.h"
+#include "forecast_stats.h"
+#include "forecast_trace.h"
+
+// Paths per task of the per-path passes; months are one task each.
+#define CACHE_PATHS_PER_TASK 1024
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+struct ForecastCache {
+    ForecastPool *pool;
+    ParameterSet params;
+    uint64_t keys[3];       // growth, storage, finance; aggregate follows finance
+    unsigned valid;
+    unsigned last_stages;
+
+    double *users;          // [month * iterations + path]
+    int *first_over;        // first month over the initial storage, or -1
+    double *profit;         // [month * iterations + path]
+    int *break_even;
+    ForecastResult result;
+};
+
+static uint64_t fnv_mix(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// Key of one stage: its own fields chained onto the key of the stage before.
+static uint64_t stage_key(uint64_t previous, const ParameterSet *params, ParameterStage stage) {
+    uint64_t hash = fnv_mix(FNV_OFFSET, &previous, sizeof(previous));
+    for (int i = 0; i < parameter_field_count; i++) {
+        if (parameter_fields[i].stage == stage) {
+            double value = parameter_get(params, &parameter_fields[i]);
+            hash = fnv_mix(hash, &value, sizeof(value));
+        }
+    }
+    return hash;
+}
+
+ForecastCache *forecast_cache_create(ForecastPool *pool) {
+    ForecastCache *cache = calloc(1, sizeof(ForecastCache));
+    if (cache) cache->pool = pool;
+    return cache;
+}
+
+static void cache_release(ForecastCache *cache) {
+    free(cache->users);
+    free(cache->first_over);
+    free(cache->profit);
+    free(cache->break_even);
+    cache->users = cache->profit = NULL;
+    cache->first_over = cache->break_even = NULL;
+    forecast_result_free(&cache->result);
+    cache->valid = 0;
+}
+
+void forecast_cache_destroy(ForecastCache *cache) {
+    if (!cache) return;
+    cache_release(cache);
+    free(cache);
+}
+
+unsigned forecast_cache_last_stages(const ForecastCache *cache) {
+    return cache->last_stages;
+}
+
+// Sizes every array for params; a new shape invalidates everything.
+static int cache_reserve(ForecastCache *cache, const ParameterSet *params) {
+    ForecastResult *r = &cache->result;
+    if (r->company_growth && r->months == params->months && r->iterations == params->iterations) {
+        return 0;
+    }
+
+    cache_release(cache);
+    int months = params->months;
+    size_t paths = (size_t)months * params->iterations;
+    cache->users = malloc(paths * sizeof(double));
+    cache->profit = malloc(paths * sizeof(double));
+    cache->first_over = malloc(params->iterations * sizeof(int));
+    cache->break_even = malloc(params->iterations * sizeof(int));
+    if (!cache->users || !cache->profit || !cache->first_over || !cache->break_even ||
+        forecast_result_alloc(r, months, params->iterations) != 0) {
+        cache_release(cache);
+        return -1;
+    }
+    return 0;
+}
+
+static void path_range(const ForecastCache *cache, int task, int *begin, int *end) {
+    *begin = task * CACHE_PATHS_PER_TASK;
+    *end = *begin + CACHE_PATHS_PER_TASK;
+    if (*end > cache->params.iterations) *end = cache->params.iterations;
+}
+
+// P5/P50/P95 of values * scale.
+static void month_percentiles(const double *values, int count, double scale, double *p5, double *p50, double *p95) {
+    QuantileSketch sketch;
+    sketch_reset(&sketch);
+    for (int path = 0; path < count; path++) {
+        sketch_push(&sketch, values[path] * scale);
+    }
+    *p5 = sketch_quantile(&sketch, 0.05);
+    *p50 = sketch_quantile(&sketch, 0.50);
+    *p95 = sketch_quantile(&sketch, 0.95);
+}
+
+static void user_moments_task(void *ctx, int month, int worker) {
+    ForecastCache *cache = ctx;
+    TRACE_BEGIN(start);
+    int iterations = cache->params.iterations;
+    const double *users = cache->users + (size_t)month * iterations;
+    RunningMoments m = {0};
+    for (int path = 0; path < iterations; path++) {
+        moments_push(&m, users[path]);
+    }
+    cache->result.avg_user_growth[month] = m.mean;
+    TRACE_END(TRACE_AGGREGATE, start);
+    (void)worker;
+}
+
+static void storage_task(void *ctx, int month, int worker) {
+    ForecastCache *cache = ctx;
+    TRACE_BEGIN(start);
+    int iterations = cache->params.iterations;
+    double gb = cache->params.avg_gb_per_user;
+    const double *users = cache->users + (size_t)month * iterations;
+    RunningMoments m = {0};
+    for (int path = 0; path < iterations; path++) {
+        moments_push(&m, users[path] * gb);
+    }
+    cache->result.avg_monthly_storage_usage[month] = m.mean;
+    cache->result.std_monthly_storage_usage[month] = moments_std(&m);
+    month_percentiles(users, iterations, gb, &cache->result.p5_monthly_storage_usage[month],
+                      &cache->result.p50_monthly_storage_usage[month], &cache->result.p95_monthly_storage_usage[month]);
+    TRACE_END(TRACE_AGGREGATE, start);
+    (void)worker;
+}
+
+// Month-outer over a block of paths so every pass reads contiguously.
+static void first_over_task(void *ctx, int task, int worker) {
+    ForecastCache *cache = ctx;
+    TRACE_BEGIN(start);
+    const ParameterSet *p = &cache->params;
+    int begin, end;
+    path_range(cache, task, &begin, &end);
+
+    for (int path = begin; path < end; path++) {
+        cache->first_over[path] = -1;
+    }
+    for (int month = 0; month < p->months; month++) {
+        const double *users = cache->users + (size_t)month * p->iterations;
+        for (int path = begin; path < end; path++) {
+            if (cache->first_over[path] < 0 && users[path] * p->avg_gb_per_user > p->initial_storage) {
+                cache->first_over[path] = month;
+            }
+        }
+    }
+    TRACE_END(TRACE_FINANCE, start);
+    (void)worker;
+}
+
+// Cumulative profit of a block of paths. The one-time extra usage cost is
+// booked against the first month, as in forecast_run().
+static void finance_task(void *ctx, int task, int worker) {
+    ForecastCache *cache = ctx;
+    TRACE_BEGIN(start);
+    const ParameterSet *p = &cache->params;
+    int iterations = p->iterations;
+    double gb = p->avg_gb_per_user;
+    double price = p->price_per_gb * parameter_step_months(p);
+    double expenses = (p->colocation_expense + p->marketing_expense) * parameter_step_months(p);
+    int begin, end;
+    path_range(cache, task, &begin, &end);
+
+    for (int path = begin; path < end; path++) {
+        int over = cache->first_over[path];
+        double extra = 0;
+        if (over >= 0) {
+            double storage = cache->users[(size_t)over * iterations + path] * gb;
+            extra = (storage - p->initial_storage) * p->cost_per_gb;
+        }
+        cache->profit[path] = -p->initial_investment - extra;
+        cache->break_even[path] = -1;
+    }
+
+    for (int month = 0; month < p->months; month++) {
+        const double *users = cache->users + (size_t)month * iterations;
+        double *profit = cache->profit + (size_t)month * iterations;
+        // Month 0 starts from the opening balance written above.
+        const double *previous = month > 0 ? profit - iterations : profit;
+        for (int path = begin; path < end; path++) {
+            double cumulative = previous[path] + users[path] * gb * price - expenses;
+            profit[path] = cumulative;
+            if (cache->break_even[path] == -1 && cumulative >= 0) {
+                cache->break_even[path] = month;
+            }
+        }
+    }
+    TRACE_END(TRACE_FINANCE, start);
+    (void)worker;
+}
+
+static void profit_moments_task(void *ctx, int month, int worker) {
+    ForecastCache *cache = ctx;
+    TRACE_BEGIN(start);
+    int iterations = cache->params.iterations;
+    const double *profit = cache->profit + (size_t)month * iterations;
+    RunningMoments m = {0};
+    for (int path = 0; path < iterations; path++) {
+        moments_push(&m, profit[path]);
+    }
+    cache->result.avg_cumulative_profit[month] = m.mean;
+    cache->result.std_cumulative_profit[month] = moments_std(&m);
+    month_percentiles(profit, iterations, 1, &cache->result.p5_cumulative_profit[month],
+                      &cache->result.p50_cumulative_profit[month], &cache->result.p95_cumulative_profit[month]);
+    TRACE_END(TRACE_AGGREGATE, start);
+    (void)worker;
+}
+
+static void aggregate(ForecastCache *cache) {
+    const ParameterSet *p = &cache->params;
+    ForecastResult *r = &cache->result;
+    forecast_pool_run(cache->pool, p->months, profit_moments_task, cache);
+
+    TRACE_BEGIN(start);
+    int no_return_count = 0;
+    long long sum_break_even_months = 0;
+    memset(r->break_even_histogram, 0, p->months * sizeof(int));
+    for (int path = 0; path < p->iterations; path++) {
+        if (cache->break_even[path] == -1) {
+            no_return_count++;
+        } else {
+            sum_break_even_months += cache->break_even[path];
+            r->break_even_histogram[cache->break_even[path]]++;
+        }
+    }
+    int count_break_even_months = p->iterations - no_return_count;
+
+    r->total_net_profit = r->avg_cumulative_profit[p->months - 1];
+    r->roi = p->initial_investment > 0 ? r->total_net_profit / p->initial_investment * 100 : NAN;
+    r->risk_of_no_return = no_return_count / (double)p->iterations * 100;
+    r->avg_break_even_month = count_break_even_months > 0 ? sum_break_even_months / (double)count_break_even_months : -1;
+    TRACE_END(TRACE_AGGREGATE, start);
+}
+
+const ForecastResult *forecast_cache_update(ForecastCache *cache, const ParameterSet *params, uint64_t seed) {
+    cache->last_stages = 0;
+    if (params->months < 1 || params->iterations < 1 || cache_reserve(cache, params) != 0) {
+        return NULL;
+    }
+
+    uint64_t keys[3];
+    keys[0] = stage_key(seed, params, PARAM_GROWTH);
+    keys[1] = stage_key(keys[0], params, PARAM_STORAGE);
+    keys[2] = stage_key(keys[1], params, PARAM_FINANCE);
+    unsigned stale = 0;
+    if (!(cache->valid & FORECAST_STAGE_GROWTH) || keys[0] != cache->keys[0]) {
+        stale = FORECAST_STAGE_GROWTH | FORECAST_STAGE_STORAGE | FORECAST_STAGE_FINANCE | FORECAST_STAGE_AGGREGATE;
+    } else if (keys[1] != cache->keys[1]) {
+        stale = FORECAST_STAGE_STORAGE | FORECAST_STAGE_FINANCE | FORECAST_STAGE_AGGREGATE;
+    } else if (keys[2] != cache->keys[2]) {
+        stale = FORECAST_STAGE_FINANCE | FORECAST_STAGE_AGGREGATE;
+    }
+    if (!stale) {
+        return &cache->result;
+    }
+
+    cache->params = *params;
+    cache->valid &= ~stale;
+    int path_tasks = (params->iterations + CACHE_PATHS_PER_TASK - 1) / CACHE_PATHS_PER_TASK;
+
+    if (stale & FORECAST_STAGE_GROWTH) {
+        ForecastOptions options = {cache->pool, seed};
+        if (forecast_simulate_users(params, &options, cache->result.company_growth, cache->users) != 0) {
+            return NULL;
+        }
+        forecast_pool_run(cache->pool, params->months, user_moments_task, cache);
+    }
+    if (stale & FORECAST_STAGE_STORAGE) {
+        forecast_pool_run(cache->pool, path_tasks, first_over_task, cache);
+        forecast_pool_run(cache->pool, params->months, storage_task, cache);
+    }
+    if (stale & FORECAST_STAGE_FINANCE) {
+        forecast_pool_run(cache->pool, path_tasks, finance_task, cache);
+    }
+    aggregate(cache);
+
+    memcpy(cache->keys, keys, sizeof(keys));
+    cache->valid |= stale;
+    cache->last_stages = stale;
+    return &cache->result;
+}
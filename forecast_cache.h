@@ -0,0 +1,36 @@
+#ifndef FORECAST_CACHE_H
+#define FORECAST_CACHE_H
+
+#include <stdint.h>
+
+#include "forecast_core.h"
+
+// Stages of the cached pipeline, each rerun only when a hash of the fields
+// it depends on (and of the stages before it) changes:
+//   growth    simulated user paths       growth fields + seed
+//   storage   GB per path, extra usage   avg_gb_per_user, initial_storage
+//   finance   cumulative profit per path price, expenses, costs, investment
+//   aggregate per-month moments, totals  follows finance
+enum {
+    FORECAST_STAGE_GROWTH = 1 << 0,
+    FORECAST_STAGE_STORAGE = 1 << 1,
+    FORECAST_STAGE_FINANCE = 1 << 2,
+    FORECAST_STAGE_AGGREGATE = 1 << 3
+};
+
+typedef struct ForecastCache ForecastCache;
+
+// Keeps every path of the last run, iterations * months doubles per stage.
+ForecastCache *forecast_cache_create(ForecastPool *pool);
+void forecast_cache_destroy(ForecastCache *cache);
+
+// Brings the cached result up to date with params and seed, rerunning only
+// the invalidated stages; cheap enough to call every frame. The result is
+// owned by the cache and valid until the next update. NULL on invalid
+// parameters or OOM.
+const ForecastResult *forecast_cache_update(ForecastCache *cache, const ParameterSet *params, uint64_t seed);
+
+// FORECAST_STAGE_* bits rerun by the last update; 0 when it was a hit.
+unsigned forecast_cache_last_stages(const ForecastCache *cache);
+
+#endif
@@ -0,0 +1,76 @@
+#include <math.h>
+
+#include "forecast_chart.h"
+
+void chart_range(const double *values, int count, double *min, double *max) {
+    for (int i = 0; i < count; i++) {
+        if (!isfinite(values[i])) continue;
+        if (values[i] < *min) *min = values[i];
+        if (values[i] > *max) *max = values[i];
+    }
+}
+
+static float map_x(const ChartMapping *map, int index) {
+    return map->count > 1 ? map->x + (float)index * map->width / (map->count - 1) : map->x;
+}
+
+static float map_y(const ChartMapping *map, double value) {
+    double span = map->max - map->min;
+    double t = span > 0 ? (value - map->min) / span : 0.5;
+    return map->y + map->height - (float)(t * map->height);
+}
+
+// Pixel columns the series is split into: one per value until the values
+// outnumber the pixels.
+static int column_count(const ChartMapping *map) {
+    int width = (int)map->width;
+    if (width < 1) width = 1;
+    return map->count < width ? map->count : width;
+}
+
+static void column_range(const ChartMapping *map, int columns, int column, int *begin, int *end) {
+    *begin = (int)((long long)column * map->count / columns);
+    *end = (int)((long long)(column + 1) * map->count / columns);
+}
+
+int chart_polyline(const double *values, const ChartMapping *map, ChartPoint *out, int capacity) {
+    int columns = column_count(map);
+    int n = 0;
+    for (int column = 0; column < columns && n + 2 <= capacity; column++) {
+        int begin, end;
+        column_range(map, columns, column, &begin, &end);
+        int low = begin;
+        int high = begin;
+        for (int i = begin + 1; i < end; i++) {
+            if (values[i] < values[low]) low = i;
+            if (values[i] > values[high]) high = i;
+        }
+        int first = low < high ? low : high;
+        int second = low < high ? high : low;
+        out[n++] = (ChartPoint){map_x(map, first), map_y(map, values[first])};
+        if (second != first) {
+            out[n++] = (ChartPoint){map_x(map, second), map_y(map, values[second])};
+        }
+    }
+    return n;
+}
+
+int chart_band(const double *lower, const double *upper, const ChartMapping *map, ChartPoint *out, int capacity) {
+    int columns = column_count(map);
+    int n = 0;
+    for (int column = 0; column < columns && n + 2 <= capacity; column++) {
+        int begin, end;
+        column_range(map, columns, column, &begin, &end);
+        double low = lower[begin];
+        double high = upper[begin];
+        for (int i = begin + 1; i < end; i++) {
+            if (lower[i] < low) low = lower[i];
+            if (upper[i] > high) high = upper[i];
+        }
+        // The last column reaches the right edge.
+        float x = map_x(map, column == columns - 1 ? map->count - 1 : begin);
+        out[n++] = (ChartPoint){x, map_y(map, high)};
+        out[n++] = (ChartPoint){x, map_y(map, low)};
+    }
+    return n;
+}
@@ -0,0 +1,34 @@
+#ifndef FORECAST_CHART_H
+#define FORECAST_CHART_H
+
+// Screen-space chart geometry, decimated to the pixel width so its size
+// and drawing cost depend on the chart, not on the horizon. Built once per
+// result; front-ends cache it and redraw only when the result changes.
+typedef struct {
+    float x;
+    float y;
+} ChartPoint;   // same layout as raylib's Vector2
+
+// Maps series index 0..count-1 across [x, x + width] and values from min
+// (bottom edge) to max (top edge) of [y, y + height].
+typedef struct {
+    float x, y, width, height;
+    int count;
+    double min, max;
+} ChartMapping;
+
+// Widens [*min, *max] to cover the finite values.
+void chart_range(const double *values, int count, double *min, double *max);
+
+// Polyline through values. Past one value per pixel column, each column
+// keeps only its minimum and maximum, in series order, so spikes survive.
+// Writes at most 2 * width points; returns how many.
+int chart_polyline(const double *values, const ChartMapping *map, ChartPoint *out, int capacity);
+
+// Triangle strip filling the band between lower and upper, two vertices per
+// pixel column (the column's highest upper, then its lowest lower), in the
+// counter-clockwise order raylib's DrawTriangleStrip() expects. Writes at
+// most 2 * width points; returns how many.
+int chart_band(const double *lower, const double *upper, const ChartMapping *map, ChartPoint *out, int capacity);
+
+#endif
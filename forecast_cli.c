@@ -0,0 +1,527 @@
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "forecast_core.h"
+#include "forecast_rules.h"
+#include "forecast_store.h"
+#include "forecast_sweep.h"
+#include "forecast_trace.h"
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-p preset] [-n iterations] [-m steps] [-u month|week|day|days] [-t threads] [-s seed]\n"
+                    "       [-S random|antithetic|sobol] [-e profit_error] [-k risk_error] [-R model.rules] [-P path] [-q]\n"
+                    "       [-a field=start:stop:count | -a field=v1,v2,...]... [-o sweep.bin] [-T trace.json]\n"
+                    "       [-c field=value|preset=N[,...]]... [-w run.fcr [-W]] [-r run.fcr [-r other.fcr]]\n", prog);
+    for (int i = 0; i < parameter_set_count; i++) {
+        fprintf(stderr, "  preset %d: %s\n", i, parameter_set_names[i]);
+    }
+}
+
+// Starts a line labelled with a step, e.g. "Month 3" or "Day 120".
+static void print_step(const char *unit, int step) {
+    printf("%c%s %d", toupper((unsigned char)unit[0]), unit + 1, step);
+}
+
+// Regenerates a single path of the run, e.g. to audit an outlier.
+static int print_path(const ParameterSet *params, uint64_t seed, const ForecastRules *rules, int path) {
+    double *users = malloc(params->months * sizeof(double));
+    double *profit = malloc(params->months * sizeof(double));
+    int break_even_month;
+    if (!users || !profit || forecast_trace_path(params, seed, rules, path, users, profit, &break_even_month) != 0) {
+        fprintf(stderr, "cannot trace path %d\n", path);
+        free(users);
+        free(profit);
+        return 1;
+    }
+
+    const char *unit = parameter_step_unit(params);
+    printf("Path %d (seed %llu):\n", path, (unsigned long long)seed);
+    for (int month = 0; month < params->months; month++) {
+        print_step(unit, month + 1);
+        printf(": %.0f users, cumulative profit $%.2f\n", users[month], profit[month]);
+    }
+    if (break_even_month != -1) {
+        printf("Break-even at %s %d\n", unit, break_even_month + 1);
+    } else {
+        printf("No break-even point within the given timeframe.\n");
+    }
+    free(users);
+    free(profit);
+    return 0;
+}
+
+static void print_result(const ParameterSet *params, const ForecastResult *result, int quiet) {
+    const char *unit = parameter_step_unit(params);
+    printf("-----------------------------------\n");
+    if (!quiet) {
+        printf("Company and User Growth Metrics (Averaged):\n");
+        for (int month = 0; month < result->months; month++) {
+            print_step(unit, month + 1);
+            printf(": %.0f companies, %.0f users, cumulative profit $%.2f (std %.2f, P5 %.2f, P95 %.2f)\n",
+                   result->company_growth[month], result->avg_user_growth[month],
+                   result->avg_cumulative_profit[month], result->std_cumulative_profit[month],
+                   result->p5_cumulative_profit[month], result->p95_cumulative_profit[month]);
+        }
+        printf("-----------------------------------\n");
+        printf("Break-even %c%s Distribution:\n", toupper((unsigned char)unit[0]), unit + 1);
+        for (int month = 0; month < result->months; month++) {
+            if (result->break_even_histogram[month] > 0) {
+                print_step(unit, month + 1);
+                printf(": %.2f%%\n", result->break_even_histogram[month] / (double)result->iterations * 100);
+            }
+        }
+        printf("-----------------------------------\n");
+    }
+    printf("Price per GB: $%.2f\n", params->price_per_gb);
+    printf("Average GB per user: %.2f GB\n", params->avg_gb_per_user);
+    printf("Total Net Profit after %d %ss: $%.2f\n", result->months, unit, result->total_net_profit);
+    if (!isnan(result->profit_std_error)) printf("Standard Error of Total Net Profit: $%.2f\n", result->profit_std_error);
+    printf("ROI after %d %ss: %.2f%%\n", result->months, unit, result->roi);
+    printf("Risk of No Return: %.2f%%\n", result->risk_of_no_return);
+    if (!isnan(result->risk_std_error)) printf("Standard Error of Risk of No Return: %.2f points\n", result->risk_std_error);
+    printf("Standard Deviation of Cumulative Profit: %.2f\n", result->std_cumulative_profit[result->months - 1]);
+    printf("Cumulative Profit P5 / P50 / P95: $%.2f / $%.2f / $%.2f\n", result->p5_cumulative_profit[result->months - 1],
+           result->p50_cumulative_profit[result->months - 1], result->p95_cumulative_profit[result->months - 1]);
+    printf("Standard Deviation of Monthly Storage Usage: %.2f GB\n", result->std_monthly_storage_usage[result->months - 1]);
+    if (result->avg_break_even_month != -1) {
+        printf("Average Break-even at %s %.0f\n", unit, result->avg_break_even_month + 1);
+    } else {
+        printf("No break-even point within the given timeframe.\n");
+    }
+}
+
+// Prints path `path` of a stored run; from the file when it holds the raw
+// paths, else regenerated from the stored parameters and seed.
+static int print_stored_path(const ForecastStore *store, int path) {
+    if (!forecast_store_has_paths(store)) {
+        return print_path(&store->params, store->seed, NULL, path);
+    }
+    int months = store->result.months;
+    double *users = malloc(months * sizeof(double));
+    double *profit = malloc(months * sizeof(double));
+    int break_even_month;
+    int status = !users || !profit || forecast_store_path(store, path, users, profit, &break_even_month) != 0;
+    if (status) {
+        fprintf(stderr, "no stored path %d\n", path);
+    } else {
+        const char *unit = parameter_step_unit(&store->params);
+        printf("Path %d (stored, seed %llu):\n", path, (unsigned long long)store->seed);
+        for (int month = 0; month < months; month++) {
+            print_step(unit, month + 1);
+            printf(": %.0f users, cumulative profit $%.2f\n", users[month], profit[month]);
+        }
+        if (break_even_month != -1) {
+            printf("Break-even at %s %d\n", unit, break_even_month + 1);
+        } else {
+            printf("No break-even point within the given timeframe.\n");
+        }
+    }
+    free(users);
+    free(profit);
+    return status;
+}
+
+// Step by step difference of two stored runs, over the steps both have,
+// labelled in the first run's unit.
+static void print_comparison(const ForecastResult *a, const ForecastResult *b, const char *unit, int quiet) {
+    int months = a->months < b->months ? a->months : b->months;
+    printf("-----------------------------------\n");
+    if (!quiet) {
+        for (int month = 0; month < months; month++) {
+            print_step(unit, month + 1);
+            printf(": cumulative profit $%.2f -> $%.2f (%+.2f), P5 %.2f -> %.2f, P95 %.2f -> %.2f\n",
+                   a->avg_cumulative_profit[month], b->avg_cumulative_profit[month],
+                   b->avg_cumulative_profit[month] - a->avg_cumulative_profit[month],
+                   a->p5_cumulative_profit[month], b->p5_cumulative_profit[month],
+                   a->p95_cumulative_profit[month], b->p95_cumulative_profit[month]);
+        }
+        printf("-----------------------------------\n");
+    }
+    printf("Total Net Profit: $%.2f -> $%.2f (%+.2f)\n", a->total_net_profit, b->total_net_profit,
+           b->total_net_profit - a->total_net_profit);
+    printf("Risk of No Return: %.2f%% -> %.2f%%\n", a->risk_of_no_return, b->risk_of_no_return);
+    printf("Average Break-even %c%s: %.1f -> %.1f\n", toupper((unsigned char)unit[0]), unit + 1,
+           a->avg_break_even_month + 1, b->avg_break_even_month + 1);
+}
+
+// Reopens stored runs instead of recomputing them: one is printed like a
+// fresh run, two are compared.
+static int print_stored(const char *const *paths, int count, int trace_path, int quiet) {
+    ForecastStore stores[2];
+    for (int i = 0; i < count; i++) {
+        if (forecast_store_open(&stores[i], paths[i]) != 0) {
+            fprintf(stderr, "cannot open %s: not a forecast store\n", paths[i]);
+            while (i-- > 0) forecast_store_close(&stores[i]);
+            return 1;
+        }
+    }
+
+    int status = 0;
+    if (trace_path >= 0) {
+        status = print_stored_path(&stores[0], trace_path);
+    } else if (count == 1) {
+        printf("Stored Forecast: %s (%d iterations, seed %llu)\n", paths[0], stores[0].result.iterations,
+               (unsigned long long)stores[0].seed);
+        print_result(&stores[0].params, &stores[0].result, quiet);
+    } else {
+        printf("Comparison: %s (%d iterations) -> %s (%d iterations)\n", paths[0], stores[0].result.iterations,
+               paths[1], stores[1].result.iterations);
+        for (int i = 0; i < parameter_field_count; i++) {
+            double a = parameter_get(&stores[0].params, &parameter_fields[i]);
+            double b = parameter_get(&stores[1].params, &parameter_fields[i]);
+            if (a != b) printf("%s: %g -> %g\n", parameter_fields[i].name, a, b);
+        }
+        print_comparison(&stores[0].result, &stores[1].result, parameter_step_unit(&stores[0].params), quiet);
+    }
+    for (int i = 0; i < count; i++) {
+        forecast_store_close(&stores[i]);
+    }
+    return status;
+}
+
+// Writes the Chrome trace of the run and prints thread time per stage.
+static int write_trace(const char *path) {
+    TraceTotals totals;
+    trace_totals(&totals);
+    fprintf(stderr, "Stage time (all threads):");
+    for (int stage = 0; stage < TRACE_STAGE_COUNT; stage++) {
+        if (totals.ns[stage]) fprintf(stderr, " %s %.1f ms", trace_stage_names[stage], totals.ns[stage] * 1e-6);
+    }
+    fprintf(stderr, "\n");
+    if (trace_write_chrome(path) != 0) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+// Runs the grid of the -a axes and writes it to `output`, or prints it as a
+// table without one.
+static int run_sweep(const SweepSpec *spec, const ForecastOptions *options, const char *output) {
+    SweepResult result;
+    if (sweep_run(spec, options, &result) != 0) {
+        fprintf(stderr, "sweep failed: invalid parameters or out of memory\n");
+        return 1;
+    }
+
+    int status = 0;
+    if (output) {
+        if (sweep_write(&result, spec, options->seed, output) != 0) {
+            fprintf(stderr, "cannot write %s\n", output);
+            status = 1;
+        } else {
+            printf("Wrote %lld scenarios x %d columns to %s\n", result.rows, result.column_count, output);
+        }
+    } else {
+        for (int i = 0; i < result.column_count; i++) {
+            printf("%s%s", i ? "\t" : "", result.names[i]);
+        }
+        printf("\n");
+        for (long long row = 0; row < result.rows; row++) {
+            for (int i = 0; i < result.column_count; i++) {
+                printf("%s%.6g", i ? "\t" : "", result.columns[i][row]);
+            }
+            printf("\n");
+        }
+    }
+    sweep_result_free(&result);
+    return status;
+}
+
+// Maximum number of -c variants compared with the baseline.
+#define MAX_VARIANTS 8
+
+// Preset index or name for -c preset=...; -1 if unknown.
+static int find_preset(const char *arg) {
+    char *end;
+    long index = strtol(arg, &end, 10);
+    if (*arg && *end == '\0') return index >= 0 && index < parameter_set_count ? (int)index : -1;
+    for (int i = 0; i < parameter_set_count; i++) {
+        if (strcmp(parameter_set_names[i], arg) == 0) return i;
+    }
+    return -1;
+}
+
+// Applies a -c list of field=value assignments to a variant of preset
+// `base`. preset=N (or a preset name) takes the storage and finance fields
+// of another preset with the same growth. -1 if an item is bad, 1 if the
+// preset grows differently.
+static int apply_variant(ParameterSet *params, int base, const char *arg) {
+    char *copy = strdup(arg);
+    if (!copy) return -1;
+    int status = 0;
+    for (char *save = NULL, *item = strtok_r(copy, ",", &save); item && status == 0;
+         item = strtok_r(NULL, ",", &save)) {
+        char *equals = strchr(item, '=');
+        char *end = NULL;
+        if (equals) *equals = '\0';
+        if (equals && strcmp(item, "preset") == 0) {
+            int preset = find_preset(equals + 1);
+            if (preset < 0) {
+                status = -1;
+            } else if (!parameter_sets_share_growth(&parameter_sets[base], &parameter_sets[preset])) {
+                status = 1;
+            } else {
+                for (int i = 0; i < parameter_field_count; i++) {
+                    const ParameterField *field = &parameter_fields[i];
+                    if (field->stage == PARAM_STORAGE || field->stage == PARAM_FINANCE) {
+                        parameter_set(params, field, parameter_get(&parameter_sets[preset], field));
+                    }
+                }
+            }
+            continue;
+        }
+        const ParameterField *field = equals ? parameter_field_find(item) : NULL;
+        double value = field ? strtod(equals + 1, &end) : 0;
+        if (!field || field->stage == PARAM_RUN || end == equals + 1 || *end != '\0') {
+            status = -1;
+        } else {
+            parameter_set(params, field, value);
+        }
+    }
+    free(copy);
+    return status;
+}
+
+// Runs preset `preset` as given by params and every -c variant on the same
+// paths and prints each variant's difference from the baseline.
+static int run_compare(int preset, const ParameterSet *params, const char *const *variants, int count,
+                       const ForecastOptions *options) {
+    ParameterSet scenarios[MAX_VARIANTS + 1];
+    ScenarioSummary summaries[MAX_VARIANTS + 1];
+    ScenarioDelta deltas[MAX_VARIANTS + 1];
+    scenarios[0] = *params;
+    for (int i = 0; i < count; i++) {
+        scenarios[i + 1] = *params;
+        int applied = apply_variant(&scenarios[i + 1], preset, variants[i]);
+        if (applied < 0) {
+            fprintf(stderr, "bad variant: %s\n", variants[i]);
+            return 2;
+        }
+        if (applied > 0 || !parameter_sets_share_growth(params, &scenarios[i + 1])) {
+            fprintf(stderr, "variant %s changes user growth; only pricing and cost fields can differ\n",
+                    variants[i]);
+            return 2;
+        }
+    }
+    if (forecast_compare_scenarios(scenarios, count + 1, options, summaries, deltas) != 0) {
+        fprintf(stderr, "comparison failed: invalid parameters or out of memory\n");
+        return 1;
+    }
+
+    printf("Paired Comparison: %s (%d iterations, %d threads)\n", parameter_set_names[preset], params->iterations,
+           forecast_pool_threads(options->pool));
+    const char *unit = parameter_step_unit(params);
+    const ScenarioSummary *base = &summaries[0];
+    for (int i = 1; i <= count; i++) {
+        const ScenarioSummary *summary = &summaries[i];
+        const ScenarioDelta *delta = &deltas[i];
+        printf("-----------------------------------\n");
+        printf("Variant: %s\n", variants[i - 1]);
+        printf("Total Net Profit: $%.2f -> $%.2f (%+.2f)\n", base->mean_final_profit, summary->mean_final_profit,
+               delta->mean_profit_delta);
+        printf("Standard Error of Difference: $%.2f paired, $%.2f from independent runs\n",
+               delta->profit_delta_std_error, delta->unpaired_std_error);
+        printf("Difference Std/P5/P50/P95: $%.2f / $%.2f / $%.2f / $%.2f\n", delta->std_profit_delta,
+               delta->p5_profit_delta, delta->p50_profit_delta, delta->p95_profit_delta);
+        printf("Ahead of Baseline: %.2f%% of paths\n", delta->win_probability);
+        printf("Risk of No Return: %.2f%% -> %.2f%%\n", base->risk_of_no_return, summary->risk_of_no_return);
+        printf("Breaks Even Earlier: %.2f%% of paths\n", delta->earlier_break_even);
+        if (delta->both_break_even > 0) {
+            printf("Break-even %c%s Difference: %+.2f (%d paths where both break even)\n",
+                   toupper((unsigned char)unit[0]), unit + 1, delta->mean_break_even_delta, delta->both_break_even);
+        }
+    }
+    return 0;
+}
+
+// Step length in days for -u: a unit name or a number of days; -1 if bad.
+static int parse_step(const char *arg) {
+    if (strcmp(arg, "month") == 0) return 0;
+    if (strcmp(arg, "week") == 0) return 7;
+    if (strcmp(arg, "day") == 0) return 1;
+    char *end;
+    long days = strtol(arg, &end, 10);
+    return *arg && *end == '\0' && days > 0 && days <= 366 ? (int)days : -1;
+}
+
+// FORECAST_SAMPLING_* mode for -S; -1 if bad.
+static int parse_sampling(const char *arg) {
+    if (strcmp(arg, "random") == 0) return FORECAST_SAMPLING_RANDOM;
+    if (strcmp(arg, "antithetic") == 0) return FORECAST_SAMPLING_ANTITHETIC;
+    if (strcmp(arg, "sobol") == 0) return FORECAST_SAMPLING_SOBOL;
+    return -1;
+}
+
+int main(int argc, char **argv) {
+    int preset = 0;
+    int iterations = -1;
+    int months = -1;
+    int step_days = -1;
+    int sampling = -1;
+    double profit_tolerance = -1;
+    double risk_tolerance = -1;
+    int threads = 0;
+    int quiet = 0;
+    int trace_path = -1;
+    unsigned long long seed = 0;
+    const char *output = NULL;
+    const char *trace_output = NULL;
+    const char *store_output = NULL;
+    int store_paths = 0;
+    const char *rules_path = NULL;
+    const char *stored[2];
+    int stored_count = 0;
+    const char *axes[SWEEP_MAX_AXES];
+    int axis_count = 0;
+    const char *variants[MAX_VARIANTS];
+    int variant_count = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:n:m:u:t:s:S:e:k:R:P:a:o:c:T:w:Wr:qh")) != -1) {
+        switch (opt) {
+        case 'p': preset = atoi(optarg); break;
+        case 'n': iterations = atoi(optarg); break;
+        case 'm': months = atoi(optarg); break;
+        case 'u':
+            if ((step_days = parse_step(optarg)) < 0) {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 't': threads = atoi(optarg); break;
+        case 's': seed = strtoull(optarg, NULL, 0); break;
+        case 'S':
+            if ((sampling = parse_sampling(optarg)) < 0) {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 'e': profit_tolerance = atof(optarg); break;
+        case 'k': risk_tolerance = atof(optarg); break;
+        case 'R': rules_path = optarg; break;
+        case 'P': trace_path = atoi(optarg); break;
+        case 'a':
+            if (axis_count == SWEEP_MAX_AXES) {
+                usage(argv[0]);
+                return 2;
+            }
+            axes[axis_count++] = optarg;
+            break;
+        case 'o': output = optarg; break;
+        case 'c':
+            if (variant_count == MAX_VARIANTS) {
+                usage(argv[0]);
+                return 2;
+            }
+            variants[variant_count++] = optarg;
+            break;
+        case 'T': trace_output = optarg; break;
+        case 'w': store_output = optarg; break;
+        case 'W': store_paths = 1; break;
+        case 'r':
+            if (stored_count == 2) {
+                usage(argv[0]);
+                return 2;
+            }
+            stored[stored_count++] = optarg;
+            break;
+        case 'q': quiet = 1; break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (preset < 0 || preset >= parameter_set_count) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    ParameterSet params = parameter_sets[preset];
+    if (iterations > 0) params.iterations = iterations;
+    if (months > 0) params.months = months;
+    if (step_days >= 0) params.step_days = step_days;
+    if (sampling >= 0) params.sampling = sampling;
+    if (profit_tolerance >= 0) params.profit_tolerance = profit_tolerance;
+    if (risk_tolerance >= 0) params.risk_tolerance = risk_tolerance;
+
+    // Sweeps and comparisons run every path.
+    if ((axis_count > 0 || variant_count > 0) && (profit_tolerance > 0 || risk_tolerance > 0)) {
+        fprintf(stderr, "-e and -k apply to single runs, not -a or -c\n");
+        return 2;
+    }
+
+    if (stored_count > 0) {
+        return print_stored(stored, stored_count, trace_path, quiet);
+    }
+
+    ForecastRules *rules = NULL;
+    if (rules_path) {
+        char error[256];
+        if (!(rules = forecast_rules_load(rules_path, error, sizeof(error)))) {
+            fprintf(stderr, "%s: %s\n", rules_path, error);
+            return 2;
+        }
+        // A store does not record the rules, so it keeps the paths themselves.
+        store_paths = 1;
+    }
+    if (trace_path >= 0) {
+        int status = print_path(&params, seed, rules, trace_path);
+        forecast_rules_free(rules);
+        return status;
+    }
+
+    if (trace_output) trace_enable(1);
+    ForecastPool *pool = forecast_pool_create(threads);
+    ForecastOptions options = {pool, seed};
+    options.rules = rules;
+
+    if (axis_count > 0) {
+        SweepSpec spec;
+        sweep_init(&spec, &params);
+        int status = 0;
+        for (int i = 0; i < axis_count && status == 0; i++) {
+            if (sweep_add_axis(&spec, axes[i]) != 0) {
+                fprintf(stderr, "bad sweep axis: %s\n", axes[i]);
+                status = 2;
+            }
+        }
+        if (status == 0) status = run_sweep(&spec, &options, output);
+        if (status == 0 && trace_output) status = write_trace(trace_output);
+        sweep_free(&spec);
+        forecast_pool_destroy(pool);
+        forecast_rules_free(rules);
+        return status;
+    }
+    if (variant_count > 0) {
+        int status = run_compare(preset, &params, variants, variant_count, &options);
+        if (status == 0 && trace_output) status = write_trace(trace_output);
+        forecast_pool_destroy(pool);
+        forecast_rules_free(rules);
+        return status;
+    }
+    int status = 0;
+    ForecastResult result;
+    if (forecast_run(&params, &options, &result) != 0) {
+        fprintf(stderr, "forecast failed: invalid parameters or out of memory\n");
+        forecast_pool_destroy(pool);
+        forecast_rules_free(rules);
+        return 1;
+    }
+
+    printf("Forecast Results: %s (%d iterations, %d threads)\n", parameter_set_names[preset],
+           result.iterations, forecast_pool_threads(pool));
+    print_result(&params, &result, quiet);
+    if (store_output && forecast_store_write(store_output, &params, &options, &result, store_paths) != 0) {
+        fprintf(stderr, "cannot write %s\n", store_output);
+        status = 1;
+    }
+
+    forecast_result_free(&result);
+    forecast_pool_destroy(pool);
+    forecast_rules_free(rules);
+    if (status == 0 && trace_output) status = write_trace(trace_output);
+    return status;
+}
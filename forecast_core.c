@@ -0,0 +1,1393 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "forecast_core.h"
+#include "forecast_kernel.h"
+#include "forecast_rng.h"
+#include "forecast_rules.h"
+#include "forecast_sampler.h"
+#include "forecast_sketch.h"
+#include "forecast_stats.h"
+#include "forecast_trace.h"
+
+const ParameterSet parameter_sets[] = {
+    {2770, 100, 50, 36, 0.12, 5, 0, 1, 5, 200, 20, 0.5, 8000, 0.08, 100},
+    {0, 200, 50, 36, 0.12, 5, 0, 1, 5, 200, 20, 0.5, 200, 0.02, 100}
+};
+
+const char *parameter_set_names[] = {
+    "Physical Server/Co-location",
+    "Cloud Server/S3"
+};
+
+const int parameter_set_count = sizeof(parameter_sets) / sizeof(parameter_sets[0]);
+
+#define FIELD(name, is_int, stage) {#name, offsetof(ParameterSet, name), is_int, stage}
+
+const ParameterField parameter_fields[] = {
+    FIELD(initial_investment, 0, PARAM_FINANCE),
+    FIELD(colocation_expense, 0, PARAM_FINANCE),
+    FIELD(marketing_expense, 0, PARAM_FINANCE),
+    FIELD(months, 1, PARAM_GROWTH),
+    FIELD(price_per_gb, 0, PARAM_FINANCE),
+    FIELD(avg_gb_per_user, 0, PARAM_STORAGE),
+    FIELD(initial_users, 1, PARAM_GROWTH),
+    FIELD(initial_companies, 1, PARAM_GROWTH),
+    FIELD(min_employees_per_company, 1, PARAM_GROWTH),
+    FIELD(max_employees_per_company, 1, PARAM_GROWTH),
+    FIELD(mean_company_size, 0, PARAM_GROWTH),
+    FIELD(acquisition_rate, 0, PARAM_GROWTH),
+    FIELD(initial_storage, 0, PARAM_STORAGE),
+    FIELD(cost_per_gb, 0, PARAM_FINANCE),
+    FIELD(iterations, 1, PARAM_GROWTH),
+    FIELD(step_days, 1, PARAM_GROWTH),
+    FIELD(sampling, 1, PARAM_GROWTH),
+    FIELD(profit_tolerance, 0, PARAM_RUN),
+    FIELD(risk_tolerance, 0, PARAM_RUN)
+};
+
+#undef FIELD
+
+const int parameter_field_count = sizeof(parameter_fields) / sizeof(parameter_fields[0]);
+
+const ParameterField *parameter_field_find(const char *name) {
+    for (int i = 0; i < parameter_field_count; i++) {
+        if (strcmp(parameter_fields[i].name, name) == 0) {
+            return &parameter_fields[i];
+        }
+    }
+    return NULL;
+}
+
+double parameter_get(const ParameterSet *params, const ParameterField *field) {
+    const char *base = (const char *)params + field->offset;
+    return field->is_int ? *(const int *)base : *(const float *)base;
+}
+
+void parameter_set(ParameterSet *params, const ParameterField *field, double value) {
+    char *base = (char *)params + field->offset;
+    if (field->is_int) {
+        *(int *)base = (int)lround(value);
+    } else {
+        *(float *)base = (float)value;
+    }
+}
+
+double parameter_step_months(const ParameterSet *params) {
+    return params->step_days > 0 ? params->step_days / FORECAST_DAYS_PER_MONTH : 1;
+}
+
+const char *parameter_step_unit(const ParameterSet *params) {
+    switch (params->step_days) {
+    case 0: return "month";
+    case 7: return "week";
+    case 1: return "day";
+    default: return "step";
+    }
+}
+
+int parameter_sets_share_growth(const ParameterSet *a, const ParameterSet *b) {
+    for (int i = 0; i < parameter_field_count; i++) {
+        const ParameterField *field = &parameter_fields[i];
+        if (field->stage == PARAM_GROWTH && parameter_get(a, field) != parameter_get(b, field)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Paths handed out per task; small enough to balance, large enough that
+// queue locking never shows up in a profile.
+#define PATHS_PER_TASK 256
+
+// Tasks per aggregation round. Per-task partial results of a round are merged
+// in task order, which keeps the merged moments bit-identical for any pool
+// size while bounding memory by the round rather than the iteration count.
+#define TASKS_PER_ROUND 64
+
+// Progress reports a run aims for when it has a progress callback.
+#define PROGRESS_REPORTS 16
+
+// Adaptive runs test their tolerances after this many tasks, then at
+// intervals of an eighth of the tasks done, in whole multiples of it; Sobol
+// runs instead check whenever every replicate has done a power of two
+// blocks, where each replicate's points are balanced. The checkpoints
+// depend on nothing but the task count, so where a run stops does not
+// depend on the pool size.
+#define ADAPTIVE_CHECK_TASKS 16
+
+// A Sobol task is one block of one replicate.
+#if PATHS_PER_TASK != RNG_SOBOL_BLOCK
+#error "PATHS_PER_TASK must equal RNG_SOBOL_BLOCK"
+#endif
+
+// A task's batched paths are evaluated by the rules as one row.
+#if RULES_WIDTH < PATHS_PER_TASK
+#error "RULES_WIDTH must cover a task"
+#endif
+
+// Contiguous range of task indices owned by one worker. The owner pops from
+// the front, thieves split off the back half.
+typedef struct {
+    pthread_mutex_t lock;
+    int next;
+    int end;
+} TaskQueue;
+
+typedef struct {
+    ForecastPool *pool;
+    int index;
+} WorkerArg;
+
+struct ForecastPool {
+    int threads;
+    pthread_t *workers;
+    WorkerArg *args;
+    TaskQueue *queues;
+    pthread_mutex_t run_lock;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned generation;
+    int active;
+    int shutdown;
+    ForecastTaskFn fn;
+    void *ctx;
+};
+
+static int take_task(ForecastPool *pool, int worker) {
+    TaskQueue *own = &pool->queues[worker];
+
+    pthread_mutex_lock(&own->lock);
+    if (own->next < own->end) {
+        int task = own->next++;
+        pthread_mutex_unlock(&own->lock);
+        return task;
+    }
+    pthread_mutex_unlock(&own->lock);
+
+    for (int i = 1; i < pool->threads; i++) {
+        TaskQueue *victim = &pool->queues[(worker + i) % pool->threads];
+        pthread_mutex_lock(&victim->lock);
+        int remaining = victim->end - victim->next;
+        if (remaining > 0) {
+            int mid = victim->next + remaining / 2;
+            int end = victim->end;
+            victim->end = mid;
+            pthread_mutex_unlock(&victim->lock);
+
+            pthread_mutex_lock(&own->lock);
+            own->next = mid + 1;
+            own->end = end;
+            pthread_mutex_unlock(&own->lock);
+            return mid;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    return -1;
+}
+
+static void drain_tasks(ForecastPool *pool, int worker) {
+    int task;
+    while ((task = take_task(pool, worker)) >= 0) {
+        pool->fn(pool->ctx, task, worker);
+    }
+}
+
+static void *worker_main(void *arg) {
+    WorkerArg *self = arg;
+    ForecastPool *pool = self->pool;
+    unsigned seen = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->generation == seen && !pool->shutdown) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->shutdown) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        drain_tasks(pool, self->index);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+ForecastPool *forecast_pool_create(int threads) {
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+
+    ForecastPool *pool = calloc(1, sizeof(ForecastPool));
+    if (!pool) return NULL;
+    pool->threads = threads;
+    pool->workers = calloc(threads, sizeof(pthread_t));
+    pool->args = calloc(threads, sizeof(WorkerArg));
+    pool->queues = calloc(threads, sizeof(TaskQueue));
+    if (!pool->workers || !pool->args || !pool->queues) {
+        free(pool->workers);
+        free(pool->args);
+        free(pool->queues);
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->run_lock, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    for (int i = 0; i < threads; i++) {
+        pthread_mutex_init(&pool->queues[i].lock, NULL);
+    }
+
+    // Worker 0 is whichever thread calls forecast_run().
+    for (int i = 1; i < threads; i++) {
+        pool->args[i].pool = pool;
+        pool->args[i].index = i;
+        if (pthread_create(&pool->workers[i], NULL, worker_main, &pool->args[i]) != 0) {
+            pool->threads = i;
+            break;
+        }
+    }
+    return pool;
+}
+
+void forecast_pool_destroy(ForecastPool *pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 1; i < pool->threads; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+    for (int i = 0; i < pool->threads; i++) {
+        pthread_mutex_destroy(&pool->queues[i].lock);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->run_lock);
+    free(pool->queues);
+    free(pool->args);
+    free(pool->workers);
+    free(pool);
+}
+
+int forecast_pool_threads(const ForecastPool *pool) {
+    return pool ? pool->threads : 1;
+}
+
+void forecast_pool_run(ForecastPool *pool, int tasks, ForecastTaskFn fn, void *ctx) {
+    if (!pool || pool->threads == 1) {
+        for (int task = 0; task < tasks; task++) {
+            fn(ctx, task, 0);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->run_lock);
+    for (int i = 0; i < pool->threads; i++) {
+        pool->queues[i].next = (int)((long long)tasks * i / pool->threads);
+        pool->queues[i].end = (int)((long long)tasks * (i + 1) / pool->threads);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->active = pool->threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    drain_tasks(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool->run_lock);
+}
+
+typedef struct {
+    RunningMoments users;
+    RunningMoments storage;
+    RunningMoments profit;
+} MonthMoments;
+
+// Sketch bins are exact counts, so unlike the moments they can be kept per
+// worker and merged in any order without changing a bit of the result.
+typedef struct {
+    QuantileSketch storage;
+    QuantileSketch profit;
+} MonthSketches;
+
+typedef struct {
+    MonthMoments *months;
+    int *break_even;        // paths first breaking even in each month
+    int no_return_count;
+    long long break_even_sum;
+    // Final profit and no-return indicator (0 or 100) of the task's
+    // independent units, see push_units().
+    RunningMoments unit_profit;
+    RunningMoments unit_risk;
+} PartialResult;
+
+// Where a run's standard error comes from. Random paths and antithetic
+// pairs are independent units; Sobol points are not, as a sequence's points
+// balance each other, so they are pooled per replicate and the error comes
+// from the spread of the replicate means.
+typedef struct {
+    RunningMoments units;
+    RunningMoments replicates[RNG_SOBOL_REPLICATES];
+} UnitError;
+
+// Pushes a task's per-path values as units: one per path, or the mean of
+// each antithetic pair, whose halves are correlated by design.
+static void push_units(RunningMoments *moments, const double *values, int count, int antithetic) {
+    int step = antithetic ? 2 : 1;
+    for (int i = 0; i < count; i += step) {
+        moments_push(moments, step == 2 && i + 1 < count ? (values[i] + values[i + 1]) / 2 : values[i]);
+    }
+}
+
+// Merges the units of global task `task`.
+static void unit_error_add(UnitError *error, int sampling, int task, const RunningMoments *units) {
+    if (sampling == FORECAST_SAMPLING_SOBOL) {
+        moments_merge(&error->replicates[task % RNG_SOBOL_REPLICATES], units);
+    } else {
+        moments_merge(&error->units, units);
+    }
+}
+
+typedef struct {
+    const ParameterSet *params;
+    uint64_t seed;
+    const double *company_growth;
+    const double *new_companies;
+    CompanySizeSampler sizes;
+    KernelParams kernel;
+    const ForecastRules *rules;     // NULL for the kernel's built-in finance
+    RulesScratch **rules_scratch;   // one per worker with rules
+    int first_task;
+    double *scratch;            // per worker, laid out by run_task()
+    int *break_even_paths;      // per worker: [PATHS_PER_TASK]
+    KernelMonthMoments *lane_moments;   // one per worker
+    MonthSketches *sketches;    // [worker * months + month]
+    PartialResult partials[TASKS_PER_ROUND];
+} ForecastJob;
+
+// The first `need` uniforms of a path's month (rounded up to a pair) under
+// the run's sampling mode; box_muller marks a month opening with the
+// normal approximation's pair. Scalar twin of the kernel's draws.
+static void month_uniforms(const KernelParams *kp, uint64_t path, int month, int need, int box_muller, double *u) {
+    int antithetic = kp->sampling == FORECAST_SAMPLING_ANTITHETIC;
+    uint64_t odd = antithetic && (path & 1) ? ~0ull : 0;
+    for (int block = 0; 2 * block < need; block++) {
+        uint64_t x[2] = {antithetic ? path & ~1ull : path, ((uint64_t)month << 32) | block};
+        threefry2x64(x, kp->seed, 0);
+        if (antithetic) {
+            int pair = box_muller && block == 0;
+            x[0] ^= odd & (pair ? 0 : RNG_MIRROR);
+            x[1] ^= odd & (pair ? RNG_HALF_TURN : RNG_MIRROR);
+        } else if (kp->sampling == FORECAST_SAMPLING_SOBOL) {
+            uint64_t dimension[2];
+            uint64_t index = RNG_SOBOL_INDEX(path);
+            rng_sobol_seeds(kp->seed, RNG_SOBOL_REPLICATE(path), month, block, dimension);
+            x[0] = (RNG_SOBOL(index, dimension[0]) << 32) | (x[0] & 0xFFFFFFFFull);
+            x[1] = (RNG_SOBOL(index, dimension[1]) << 32) | (x[1] & 0xFFFFFFFFull);
+        }
+        u[2 * block] = rng_bits_to_uniform(x[0]);
+        u[2 * block + 1] = rng_bits_to_uniform(x[1]);
+    }
+}
+
+// Every whole new company draws its own headcount; a fractional company
+// contributes the same fraction of one draw, so the expectation matches
+// new_companies * mean size. Large cohorts draw their total in one go.
+static double sample_new_users(const ForecastJob *job, int path, int month) {
+    double new_companies = job->new_companies[month];
+    int whole = (int)new_companies;
+    double fraction = new_companies - whole;
+    int normal = whole > SAMPLER_NORMAL_APPROX_COMPANIES;
+    double u[SAMPLER_NORMAL_APPROX_COMPANIES + 2];
+    month_uniforms(&job->kernel, path, month, (normal ? 2 : whole) + (fraction > 0), normal, u);
+
+    int inverse = job->kernel.sampling != FORECAST_SAMPLING_RANDOM;
+    double users = 0;
+    int next = 0;
+    if (normal) {
+        users = company_size_total(&job->sizes, whole, u[0], u[1]);
+        next = 2;
+    } else {
+        for (; next < whole; next++) {
+            users += inverse ? company_size_quantile(&job->sizes, u[next]) : company_size_draw(&job->sizes, u[next]);
+        }
+    }
+    if (fraction > 0) {
+        users += fraction * (inverse ? company_size_quantile(&job->sizes, u[next])
+                                     : company_size_draw(&job->sizes, u[next]));
+    }
+    return users;
+}
+
+// Draws one path's user counts into users[month * stride]; the scalar twin
+// of kernel_simulate_batch().
+static void simulate_users(const ForecastJob *job, int path, double *users_out, int stride) {
+    double users = job->params->initial_users;
+    users_out[0] = users;
+    for (int month = 1; month < job->params->months; month++) {
+        users += sample_new_users(job, path, month);
+        users_out[(size_t)month * stride] = users;
+    }
+}
+
+// Scalar twin of kernel_open_balance() and kernel_fold_month(): cumulative
+// profit of one path into profit_row, returning its break-even month or -1.
+static int path_profits(const KernelParams *kp, const double *users_row, double *profit_row) {
+    // The one-time extra usage cost is booked against the first month.
+    double one_time_extra_usage_cost = 0;
+    for (int month = 0; month < kp->months; month++) {
+        double storage = users_row[month] * kp->avg_gb_per_user;
+        if (storage > kp->initial_storage) {
+            one_time_extra_usage_cost = (storage - kp->initial_storage) * kp->cost_per_gb;
+            break;
+        }
+    }
+
+    double cumulative = -kp->initial_investment - one_time_extra_usage_cost;
+    int break_even_month = -1;
+    for (int month = 0; month < kp->months; month++) {
+        cumulative += users_row[month] * kp->avg_gb_per_user * kp->price_per_gb - kp->expenses;
+        profit_row[month] = cumulative;
+        if (break_even_month == -1 && cumulative >= 0) {
+            break_even_month = month;
+        }
+    }
+    return break_even_month;
+}
+
+// Rules twin of path_profits() over count paths (at most RULES_WIDTH) laid
+// out users[month * stride + i], a step at a time across the paths:
+// cumulative profit into profit (same layout), the last step's into final
+// and break-even months into break_even. profit and final may be NULL.
+static void rules_profits(const ForecastJob *job, RulesScratch *scratch, const ParameterSet *params,
+                          const double *users, int stride, int count, double *profit, double *final,
+                          int *break_even) {
+    double cumulative[RULES_WIDTH];
+    double net[RULES_WIDTH];
+    RulesRow row = {params, 0, job->company_growth[0], users, NULL, NULL, count};
+    forecast_rules_open(job->rules, scratch, &row, cumulative);
+    for (int i = 0; i < count; i++) break_even[i] = -1;
+
+    for (int month = 0; month < job->params->months; month++) {
+        row.step = month;
+        row.companies = job->company_growth[month];
+        row.users = users + (size_t)month * stride;
+        row.previous_users = month > 0 ? row.users - stride : NULL;
+        row.cumulative = cumulative;
+        forecast_rules_step(job->rules, scratch, &row, net);
+        for (int i = 0; i < count; i++) {
+            cumulative[i] += net[i];
+            if (break_even[i] == -1 && cumulative[i] >= 0) break_even[i] = month;
+        }
+        if (profit) memcpy(profit + (size_t)month * stride, cumulative, count * sizeof(double));
+    }
+    if (final) memcpy(final, cumulative, count * sizeof(double));
+}
+
+// Cumulative profit of one path under the job's rules if it has any, else
+// under the built-in finance of kp; returns the break-even month or -1.
+static int finance_path(const ForecastJob *job, int worker, const KernelParams *kp, const ParameterSet *params,
+                        const double *users_row, double *profit_row) {
+    if (!job->rules) return path_profits(kp, users_row, profit_row);
+    int break_even;
+    rules_profits(job, job->rules_scratch[worker], params, users_row, 1, 1, profit_row, NULL, &break_even);
+    return break_even;
+}
+
+// Per-worker rules state for the options' rules, if any. 0 on success.
+static int job_set_rules(ForecastJob *job, const ForecastOptions *options, int threads) {
+    job->rules = options ? options->rules : NULL;
+    if (!job->rules) return 0;
+    job->rules_scratch = calloc(threads, sizeof(RulesScratch *));
+    if (!job->rules_scratch) return -1;
+    for (int worker = 0; worker < threads; worker++) {
+        job->rules_scratch[worker] = forecast_rules_scratch_create(job->rules);
+        if (!job->rules_scratch[worker]) return -1;
+    }
+    return 0;
+}
+
+static void job_free_rules(ForecastJob *job, int threads) {
+    if (!job->rules_scratch) return;
+    for (int worker = 0; worker < threads; worker++) {
+        forecast_rules_scratch_free(job->rules_scratch[worker]);
+    }
+    free(job->rules_scratch);
+}
+
+static void count_break_even(PartialResult *partial, int break_even_month) {
+    if (break_even_month == -1) {
+        partial->no_return_count++;
+    } else {
+        partial->break_even_sum += break_even_month;
+        partial->break_even[break_even_month]++;
+    }
+}
+
+// Folds a path into the task's partial result and sketches, for the paths
+// left over after the last full batch of a task. Returns its break-even
+// month.
+static int fold_path(const ForecastJob *job, int worker, const double *users_row, double *profit_row,
+                     MonthSketches *sketches, PartialResult *partial) {
+    const KernelParams *kp = &job->kernel;
+    int break_even_month = finance_path(job, worker, kp, job->params, users_row, profit_row);
+    for (int month = 0; month < kp->months; month++) {
+        MonthMoments *acc = &partial->months[month];
+        double storage = users_row[month] * kp->avg_gb_per_user;
+        moments_push(&acc->users, users_row[month]);
+        moments_push(&acc->storage, storage);
+        moments_push(&acc->profit, profit_row[month]);
+        sketch_push(&sketches[month].storage, storage);
+        sketch_push(&sketches[month].profit, profit_row[month]);
+    }
+    count_break_even(partial, break_even_month);
+    return break_even_month;
+}
+
+static void merge_lane(RunningMoments *into, const LaneMoments *lanes, int lane, double count) {
+    RunningMoments m = {count, lanes->mean[lane], lanes->m2[lane]};
+    moments_merge(into, &m);
+}
+
+// Worker scratch of run_task(): the users tile, then balance, storage,
+// profit and rules net cash flow of each path of the tile, then a users and
+// a profit row.
+static size_t run_scratch_size(int months) {
+    return (size_t)(PATHS_PER_TASK + 2) * months + 4 * PATHS_PER_TASK;
+}
+
+// A task first draws the user paths of all its batches into a month-major
+// tile, then folds the tile a month at a time: the vector kernel updates
+// every path's profit and the month's per-lane moments, and the month's
+// storage and profit values of the whole task go to its sketches in one
+// run. Each month's accumulators are touched once per task, so the working
+// set stays a few tiles' rows deep however long the horizon; only the tile
+// itself grows with it. Nothing per path outlives its task but its final
+// profit and break-even month, which give the task's units.
+static void run_task(void *ctx, int task, int worker) {
+    ForecastJob *job = ctx;
+    int months = job->params->months;
+    PartialResult *partial = &job->partials[task];
+    double *tile = job->scratch + (size_t)worker * run_scratch_size(months);
+    double *balance = tile + (size_t)PATHS_PER_TASK * months;
+    double *storage_values = balance + PATHS_PER_TASK;
+    double *profit_values = storage_values + PATHS_PER_TASK;
+    double *net = profit_values + PATHS_PER_TASK;
+    double *users_row = net + PATHS_PER_TASK;
+    double *profit_row = users_row + months;
+    int *break_even = job->break_even_paths + (size_t)worker * PATHS_PER_TASK;
+    KernelMonthMoments *lanes = &job->lane_moments[worker];
+    MonthSketches *sketches = job->sketches + (size_t)worker * months;
+
+    int begin = (job->first_task + task) * PATHS_PER_TASK;
+    int end = begin + PATHS_PER_TASK;
+    if (end > job->params->iterations) end = job->params->iterations;
+    int batched = (end - begin) / KERNEL_LANES * KERNEL_LANES;
+
+    memset(partial->months, 0, months * sizeof(MonthMoments));
+    memset(partial->break_even, 0, months * sizeof(int));
+    partial->no_return_count = 0;
+    partial->break_even_sum = 0;
+    partial->unit_profit = partial->unit_risk = (RunningMoments){0};
+
+    // Stages alternate every month, so they are lapped into one span.
+    uint64_t stage_ns[TRACE_STAGE_COUNT] = {0};
+    TRACE_BEGIN(task_start);
+    uint64_t mark = task_start;
+
+    for (int path = 0; path < batched; path += KERNEL_LANES) {
+        kernel_simulate_batch(&job->kernel, begin + path, tile + path, PATHS_PER_TASK);
+        if (!job->rules) kernel_open_balance(&job->kernel, tile + path, PATHS_PER_TASK, balance + path);
+        for (int lane = 0; lane < KERNEL_LANES; lane++) break_even[path + lane] = -1;
+    }
+    trace_lap(&mark, &stage_ns[TRACE_GROWTH]);
+
+    if (batched > 0) {
+        double batches = batched / KERNEL_LANES;
+        RulesRow row = {job->params, 0, job->company_growth[0], tile, NULL, NULL, batched};
+        if (job->rules) forecast_rules_open(job->rules, job->rules_scratch[worker], &row, balance);
+        for (int month = 0; month < months; month++) {
+            const double *users = tile + (size_t)month * PATHS_PER_TASK;
+            if (job->rules) {
+                row.step = month;
+                row.companies = job->company_growth[month];
+                row.users = users;
+                row.previous_users = month > 0 ? users - PATHS_PER_TASK : NULL;
+                row.cumulative = balance;
+                forecast_rules_step(job->rules, job->rules_scratch[worker], &row, net);
+            }
+            memset(lanes, 0, sizeof(*lanes));
+            kernel_fold_month(&job->kernel, month, users, job->rules ? net : NULL, batched, lanes, balance,
+                              break_even, storage_values, profit_values);
+            trace_lap(&mark, &stage_ns[TRACE_FINANCE]);
+            for (int lane = 0; lane < KERNEL_LANES; lane++) {
+                merge_lane(&partial->months[month].users, &lanes->users, lane, batches);
+                merge_lane(&partial->months[month].storage, &lanes->storage, lane, batches);
+                merge_lane(&partial->months[month].profit, &lanes->profit, lane, batches);
+            }
+            sketch_add(&sketches[month].storage, storage_values, batched);
+            sketch_add(&sketches[month].profit, profit_values, batched);
+            trace_lap(&mark, &stage_ns[TRACE_AGGREGATE]);
+        }
+        for (int path = 0; path < batched; path++) {
+            count_break_even(partial, break_even[path]);
+        }
+    }
+
+    // The last month's profit values are the batched paths' finals.
+    for (int path = batched; path < end - begin; path++) {
+        simulate_users(job, begin + path, users_row, 1);
+        trace_lap(&mark, &stage_ns[TRACE_GROWTH]);
+        break_even[path] = fold_path(job, worker, users_row, profit_row, sketches, partial);
+        profit_values[path] = profit_row[months - 1];
+        trace_lap(&mark, &stage_ns[TRACE_FINANCE]);
+    }
+    int antithetic = job->params->sampling == FORECAST_SAMPLING_ANTITHETIC;
+    for (int path = 0; path < end - begin; path++) {
+        storage_values[path] = break_even[path] == -1 ? 100 : 0;
+    }
+    push_units(&partial->unit_profit, profit_values, end - begin, antithetic);
+    push_units(&partial->unit_risk, storage_values, end - begin, antithetic);
+    if (task_start) trace_span("paths", task_start, mark, stage_ns, end - begin);
+}
+
+// Finance fields of the kernel parameters; everything but the growth.
+// Revenue and running costs accrue per step; the investment and the extra
+// usage cost are one-off.
+static void kernel_set_finance(KernelParams *kp, const ParameterSet *params) {
+    double step = parameter_step_months(params);
+    kp->avg_gb_per_user = params->avg_gb_per_user;
+    kp->price_per_gb = params->price_per_gb * step;
+    kp->expenses = (params->colocation_expense + params->marketing_expense) * step;
+    kp->initial_investment = params->initial_investment;
+    kp->initial_storage = params->initial_storage;
+    kp->cost_per_gb = params->cost_per_gb;
+}
+
+// Shared set-up of a run: the company growth curve, which carries no
+// randomness and is common to every path, the size sampler and the kernel
+// parameters. company_growth and new_companies hold params->months values.
+static int job_prepare(ForecastJob *job, const ParameterSet *params, uint64_t seed,
+                       double *company_growth, double *new_companies) {
+    int months = params->months;
+    if (company_size_sampler_init(&job->sizes, params->min_employees_per_company,
+                                  params->max_employees_per_company, params->mean_company_size) != 0) {
+        return -1;
+    }
+
+    // The monthly acquisition rate compounds to the same growth over a month
+    // of shorter steps.
+    double rate = params->acquisition_rate;
+    if (params->step_days > 0) rate = pow(1 + rate, parameter_step_months(params)) - 1;
+
+    company_growth[0] = params->initial_companies;
+    new_companies[0] = 0;
+    for (int month = 1; month < months; month++) {
+        double companies = company_growth[month - 1];
+        new_companies[month] = companies * rate * exp(-companies / 10);
+        company_growth[month] = companies + new_companies[month];
+    }
+
+    job->params = params;
+    job->seed = seed;
+    job->company_growth = company_growth;
+    job->new_companies = new_companies;
+    job->kernel.months = months;
+    job->kernel.seed = seed;
+    job->kernel.sampling = params->sampling;
+    job->kernel.initial_users = params->initial_users;
+    job->kernel.new_companies = new_companies;
+    job->kernel.sizes = &job->sizes;
+    kernel_set_finance(&job->kernel, params);
+    return 0;
+}
+
+static int params_valid(const ParameterSet *params) {
+    return params->months >= 1 && params->iterations >= 1 && params->step_days >= 0 && params->mean_company_size > 0 &&
+           params->min_employees_per_company <= params->max_employees_per_company &&
+           params->sampling >= FORECAST_SAMPLING_RANDOM && params->sampling <= FORECAST_SAMPLING_SOBOL &&
+           params->profit_tolerance >= 0 && params->risk_tolerance >= 0;
+}
+
+void forecast_result_free(ForecastResult *result) {
+#define FREE_SERIES(name) free(result->name);
+    FORECAST_RESULT_SERIES(FREE_SERIES)
+#undef FREE_SERIES
+    free(result->break_even_histogram);
+    memset(result, 0, sizeof(*result));
+}
+
+int forecast_result_alloc(ForecastResult *result, int months, int iterations) {
+    memset(result, 0, sizeof(*result));
+    result->months = months;
+    result->iterations = iterations;
+    result->profit_std_error = NAN;
+    result->risk_std_error = NAN;
+    result->break_even_histogram = calloc(months, sizeof(int));
+    int ok = result->break_even_histogram != NULL;
+#define ALLOC_SERIES(name) result->name = calloc(months, sizeof(double)); ok = ok && result->name;
+    FORECAST_RESULT_SERIES(ALLOC_SERIES)
+#undef ALLOC_SERIES
+    if (!ok) {
+        forecast_result_free(result);
+        return -1;
+    }
+    return 0;
+}
+
+int forecast_result_copy(ForecastResult *dst, const ForecastResult *src) {
+    ForecastResult copy;
+    if (forecast_result_alloc(&copy, src->months, src->iterations) != 0) {
+        return -1;
+    }
+#define COPY_SERIES(name) memcpy(copy.name, src->name, src->months * sizeof(double));
+    FORECAST_RESULT_SERIES(COPY_SERIES)
+#undef COPY_SERIES
+    memcpy(copy.break_even_histogram, src->break_even_histogram, src->months * sizeof(int));
+    copy.total_net_profit = src->total_net_profit;
+    copy.roi = src->roi;
+    copy.risk_of_no_return = src->risk_of_no_return;
+    copy.avg_break_even_month = src->avg_break_even_month;
+    copy.profit_std_error = src->profit_std_error;
+    copy.risk_std_error = src->risk_std_error;
+
+    forecast_result_free(dst);
+    *dst = copy;
+    return 0;
+}
+
+// Standard error of a mean of independent values from their spread; NAN
+// below two values.
+static double mean_std_error(const RunningMoments *values) {
+    return values->count > 1 ? sqrt(values->m2 / (values->count - 1) / values->count) : NAN;
+}
+
+// Standard error of the mean of a run's units; for Sobol, from the means of
+// the replicates started so far.
+static double unit_std_error(const UnitError *error, int sampling) {
+    if (sampling != FORECAST_SAMPLING_SOBOL) return mean_std_error(&error->units);
+    RunningMoments means = {0};
+    for (int r = 0; r < RNG_SOBOL_REPLICATES; r++) {
+        if (error->replicates[r].count > 0) moments_push(&means, error->replicates[r].mean);
+    }
+    return mean_std_error(&means);
+}
+
+// Writes the statistics over the `paths` paths merged into totals so far.
+static void fill_result(ForecastResult *result, const ParameterSet *params, const PartialResult *totals,
+                        const UnitError *profit_error, const UnitError *risk_error,
+                        const MonthSketches *sketches, int paths) {
+    int months = params->months;
+    for (int month = 0; month < months; month++) {
+        const MonthMoments *moments = &totals->months[month];
+        const MonthSketches *sketch = &sketches[month];
+        result->avg_user_growth[month] = moments->users.mean;
+        result->avg_monthly_storage_usage[month] = moments->storage.mean;
+        result->std_monthly_storage_usage[month] = moments_std(&moments->storage);
+        result->avg_cumulative_profit[month] = moments->profit.mean;
+        result->std_cumulative_profit[month] = moments_std(&moments->profit);
+        result->p5_monthly_storage_usage[month] = sketch_quantile(&sketch->storage, 0.05);
+        result->p50_monthly_storage_usage[month] = sketch_quantile(&sketch->storage, 0.50);
+        result->p95_monthly_storage_usage[month] = sketch_quantile(&sketch->storage, 0.95);
+        result->p5_cumulative_profit[month] = sketch_quantile(&sketch->profit, 0.05);
+        result->p50_cumulative_profit[month] = sketch_quantile(&sketch->profit, 0.50);
+        result->p95_cumulative_profit[month] = sketch_quantile(&sketch->profit, 0.95);
+    }
+    memcpy(result->break_even_histogram, totals->break_even, months * sizeof(int));
+    int count_break_even_months = paths - totals->no_return_count;
+
+    result->iterations = paths;
+    result->total_net_profit = result->avg_cumulative_profit[months - 1];
+    result->roi = params->initial_investment > 0 ? result->total_net_profit / params->initial_investment * 100 : NAN;
+    result->risk_of_no_return = totals->no_return_count / (double)paths * 100;
+    result->avg_break_even_month = count_break_even_months > 0 ? totals->break_even_sum / (double)count_break_even_months : -1;
+    result->profit_std_error = unit_std_error(profit_error, params->sampling);
+    result->risk_std_error = unit_std_error(risk_error, params->sampling);
+}
+
+// Whether an adaptive run has reached its tolerances.
+static int within_tolerance(const ParameterSet *params, const ForecastResult *result) {
+    return (params->profit_tolerance <= 0 || result->profit_std_error <= params->profit_tolerance) &&
+           (params->risk_tolerance <= 0 || result->risk_std_error <= params->risk_tolerance);
+}
+
+// The task count of an adaptive run's next checkpoint after `checkpoint`,
+// or its first when that is 0.
+static int next_checkpoint(const ParameterSet *params, int checkpoint) {
+    if (params->sampling == FORECAST_SAMPLING_SOBOL) {
+        return checkpoint > 0 ? 2 * checkpoint : RNG_SOBOL_REPLICATES;
+    }
+    int interval = checkpoint / 8 / ADAPTIVE_CHECK_TASKS * ADAPTIVE_CHECK_TASKS;
+    return checkpoint + (interval > ADAPTIVE_CHECK_TASKS ? interval : ADAPTIVE_CHECK_TASKS);
+}
+
+int forecast_run(const ParameterSet *params, const ForecastOptions *options, ForecastResult *result) {
+    int months = params->months;
+    int iterations = params->iterations;
+    memset(result, 0, sizeof(*result));
+    if (!params_valid(params)) {
+        return -1;
+    }
+
+    ForecastPool *pool = options ? options->pool : NULL;
+    if (forecast_result_alloc(result, months, iterations) != 0) {
+        return -1;
+    }
+
+    // One slot per task of a round plus the running totals; the sketches
+    // are per worker plus the totals, so memory is bounded whatever the
+    // iteration count.
+    ForecastJob job = {0};
+    double *new_companies = calloc(months, sizeof(double));
+    int threads = forecast_pool_threads(pool);
+    size_t slot_months = (size_t)(TASKS_PER_ROUND + 1) * months;
+    size_t sketch_months = (size_t)(threads + 1) * months;
+    job.scratch = malloc((size_t)threads * run_scratch_size(months) * sizeof(double));
+    job.break_even_paths = malloc((size_t)threads * PATHS_PER_TASK * sizeof(int));
+    job.lane_moments = malloc((size_t)threads * sizeof(KernelMonthMoments));
+    job.sketches = malloc(sketch_months * sizeof(MonthSketches));
+    MonthMoments *moment_slots = calloc(slot_months, sizeof(MonthMoments));
+    int *break_even_slots = calloc(slot_months, sizeof(int));
+    PartialResult totals = {0};
+    UnitError profit_error = {0}, risk_error = {0};
+
+    int status = -1;
+    TRACE_BEGIN(setup);
+    if (!new_companies || !job.scratch || !job.break_even_paths || !job.lane_moments || !job.sketches ||
+        !moment_slots || !break_even_slots || job_set_rules(&job, options, threads) != 0 ||
+        job_prepare(&job, params, options ? options->seed : 0, result->company_growth, new_companies) != 0) {
+        goto done;
+    }
+    for (int i = 0; i <= TASKS_PER_ROUND; i++) {
+        PartialResult *partial = i < TASKS_PER_ROUND ? &job.partials[i] : &totals;
+        partial->months = moment_slots + (size_t)i * months;
+        partial->break_even = break_even_slots + (size_t)i * months;
+    }
+    MonthSketches *total_sketches = job.sketches + (size_t)threads * months;
+    for (size_t i = 0; i < sketch_months; i++) {
+        sketch_reset(&job.sketches[i].storage);
+        sketch_reset(&job.sketches[i].profit);
+    }
+    TRACE_END(TRACE_SETUP, setup);
+
+    // Rounds only bound memory and the merge order is per task, so shorter
+    // rounds for finer progress reports leave the result unchanged. An
+    // adaptive run also ends a round at each checkpoint.
+    int tasks = (iterations + PATHS_PER_TASK - 1) / PATHS_PER_TASK;
+    int round_size = TASKS_PER_ROUND;
+    if (options && options->progress) {
+        round_size = (tasks + PROGRESS_REPORTS - 1) / PROGRESS_REPORTS;
+        if (round_size < threads) round_size = threads;
+        if (round_size > TASKS_PER_ROUND) round_size = TASKS_PER_ROUND;
+    }
+    int adaptive = params->profit_tolerance > 0 || params->risk_tolerance > 0;
+    int checkpoint = next_checkpoint(params, 0);
+
+    for (int round_tasks; job.first_task < tasks; job.first_task += round_tasks) {
+        round_tasks = tasks - job.first_task;
+        if (round_tasks > round_size) round_tasks = round_size;
+        if (adaptive && round_tasks > checkpoint - job.first_task) round_tasks = checkpoint - job.first_task;
+        forecast_pool_run(pool, round_tasks, run_task, &job);
+
+        TRACE_BEGIN(merge);
+        for (int i = 0; i < round_tasks; i++) {
+            const PartialResult *partial = &job.partials[i];
+            for (int month = 0; month < months; month++) {
+                moments_merge(&totals.months[month].users, &partial->months[month].users);
+                moments_merge(&totals.months[month].storage, &partial->months[month].storage);
+                moments_merge(&totals.months[month].profit, &partial->months[month].profit);
+                totals.break_even[month] += partial->break_even[month];
+            }
+            totals.no_return_count += partial->no_return_count;
+            totals.break_even_sum += partial->break_even_sum;
+            unit_error_add(&profit_error, params->sampling, job.first_task + i, &partial->unit_profit);
+            unit_error_add(&risk_error, params->sampling, job.first_task + i, &partial->unit_risk);
+        }
+
+        // Worker sketches keep growing across rounds so their bins settle;
+        // the totals are rebuilt from them for every report.
+        for (int month = 0; month < months; month++) {
+            sketch_reset(&total_sketches[month].storage);
+            sketch_reset(&total_sketches[month].profit);
+            for (int worker = 0; worker < threads; worker++) {
+                const MonthSketches *sketch = &job.sketches[(size_t)worker * months + month];
+                sketch_merge(&total_sketches[month].storage, &sketch->storage);
+                sketch_merge(&total_sketches[month].profit, &sketch->profit);
+            }
+        }
+
+        int paths = (job.first_task + round_tasks) * PATHS_PER_TASK;
+        if (paths > iterations) paths = iterations;
+        fill_result(result, params, &totals, &profit_error, &risk_error, total_sketches, paths);
+        TRACE_END(TRACE_AGGREGATE, merge);
+        if (adaptive && job.first_task + round_tasks == checkpoint) {
+            if (within_tolerance(params, result)) break;
+            checkpoint = next_checkpoint(params, checkpoint);
+        }
+        if (options && options->progress && paths < iterations && options->progress(options->progress_ctx, result)) {
+            status = FORECAST_CANCELLED;
+            goto done;
+        }
+    }
+    status = 0;
+
+done:
+    free(new_companies);
+    company_size_sampler_free(&job.sizes);
+    job_free_rules(&job, threads);
+    free(job.scratch);
+    free(job.break_even_paths);
+    free(job.lane_moments);
+    free(job.sketches);
+    free(moment_slots);
+    free(break_even_slots);
+    if (status != 0) forecast_result_free(result);
+    return status;
+}
+
+// Paths [first, first + count) into month-major arrays with stride count;
+// profit and break_even may be NULL.
+typedef struct {
+    ForecastJob job;
+    int first;
+    int count;
+    double *users;
+    double *profit;
+    int *break_even;
+} SimulateJob;
+
+// Cumulative profit and break-even month of path i of the job from its
+// users, which are already in place.
+static void simulate_profits(SimulateJob *sim, int i, double *users_row, double *profit_row) {
+    int months = sim->job.params->months;
+    for (int month = 0; month < months; month++) {
+        users_row[month] = sim->users[(size_t)month * sim->count + i];
+    }
+    int break_even = path_profits(&sim->job.kernel, users_row, profit_row);
+    if (sim->profit) {
+        for (int month = 0; month < months; month++) {
+            sim->profit[(size_t)month * sim->count + i] = profit_row[month];
+        }
+    }
+    if (sim->break_even) sim->break_even[i] = break_even;
+}
+
+static void run_simulate_task(void *ctx, int task, int worker) {
+    SimulateJob *sim = ctx;
+    int months = sim->job.params->months;
+    int stride = sim->count;
+    double *users_row = sim->job.scratch + (size_t)worker * 2 * months;
+    double *profit_row = users_row + months;
+
+    int begin = task * PATHS_PER_TASK;
+    int end = begin + PATHS_PER_TASK;
+    if (end > sim->count) end = sim->count;
+
+    TRACE_BEGIN(task_start);
+    int i = begin;
+    for (; i + KERNEL_LANES <= end; i += KERNEL_LANES) {
+        kernel_simulate_batch(&sim->job.kernel, sim->first + i, sim->users + i, stride);
+    }
+    for (; i < end; i++) {
+        simulate_users(&sim->job, sim->first + i, sim->users + i, stride);
+    }
+    uint64_t stage_ns[TRACE_STAGE_COUNT] = {0};
+    uint64_t mark = task_start;
+    trace_lap(&mark, &stage_ns[TRACE_GROWTH]);
+
+    if (sim->job.rules && (sim->profit || sim->break_even)) {
+        // The task's paths are already month-major at stride count.
+        int break_even[PATHS_PER_TASK];
+        rules_profits(&sim->job, sim->job.rules_scratch[worker], sim->job.params, sim->users + begin, stride,
+                      end - begin, sim->profit ? sim->profit + begin : NULL, NULL, break_even);
+        if (sim->break_even) memcpy(sim->break_even + begin, break_even, (end - begin) * sizeof(int));
+        trace_lap(&mark, &stage_ns[TRACE_FINANCE]);
+    } else if (sim->profit || sim->break_even) {
+        for (i = begin; i < end; i++) {
+            simulate_profits(sim, i, users_row, profit_row);
+        }
+        trace_lap(&mark, &stage_ns[TRACE_FINANCE]);
+    }
+    if (task_start) trace_span("paths", task_start, mark, stage_ns, end - begin);
+}
+
+static int simulate_paths(const ParameterSet *params, const ForecastOptions *options, int first, int count,
+                          double *company_growth, double *users, double *profit, int *break_even) {
+    int months = params->months;
+    ForecastPool *pool = options ? options->pool : NULL;
+    int threads = forecast_pool_threads(pool);
+    SimulateJob sim = {{0}, first, count, users, profit, break_even};
+    double *new_companies = calloc(months, sizeof(double));
+    double *growth = company_growth ? company_growth : calloc(months, sizeof(double));
+    sim.job.scratch = malloc((size_t)threads * 2 * months * sizeof(double));
+
+    int status = -1;
+    if (new_companies && growth && sim.job.scratch && job_set_rules(&sim.job, options, threads) == 0 &&
+        job_prepare(&sim.job, params, options ? options->seed : 0, growth, new_companies) == 0) {
+        int tasks = (count + PATHS_PER_TASK - 1) / PATHS_PER_TASK;
+        forecast_pool_run(pool, tasks, run_simulate_task, &sim);
+        status = 0;
+    }
+
+    company_size_sampler_free(&sim.job.sizes);
+    job_free_rules(&sim.job, threads);
+    free(new_companies);
+    if (growth != company_growth) free(growth);
+    free(sim.job.scratch);
+    return status;
+}
+
+int forecast_simulate_users(const ParameterSet *params, const ForecastOptions *options,
+                            double *company_growth, double *users) {
+    if (!params_valid(params)) {
+        return -1;
+    }
+
+    return simulate_paths(params, options, 0, params->iterations, company_growth, users, NULL, NULL);
+}
+
+int forecast_simulate_paths(const ParameterSet *params, const ForecastOptions *options, int first, int count,
+                            double *users, double *cumulative_profit, int *break_even_month) {
+    if (!params_valid(params) || !users || first < 0 || count < 1 || first > params->iterations - count) {
+        return -1;
+    }
+    return simulate_paths(params, options, first, count, NULL, users, cumulative_profit, break_even_month);
+}
+
+typedef struct {
+    RunningMoments final_profit;
+    int no_return_count;
+    long long break_even_sum;
+    // Against scenario 0 on the same paths, when comparing, with the
+    // task's units of the final profit and its delta for the standard
+    // errors.
+    RunningMoments profit_delta;
+    RunningMoments break_even_delta;
+    int wins;
+    int earlier;
+    RunningMoments unit_profit;
+    RunningMoments unit_delta;
+} ScenarioPartial;
+
+// Percentile sketches of one scenario, shared by the workers. Bins are
+// exact counts, so the order tasks add to them in changes nothing.
+typedef struct {
+    pthread_mutex_t lock;
+    QuantileSketch final_profit;
+    QuantileSketch profit_delta;    // when comparing
+} ScenarioSketches;
+
+// One growth simulation fanned out to `count` finance variants. partials
+// holds TASKS_PER_ROUND rows of `count` slots. A task folds its paths into
+// them and the sketches once every scenario has been evaluated on them, so
+// nothing per path outlives the task.
+typedef struct {
+    ForecastJob growth;
+    int count;
+    int compare;
+    const ParameterSet *scenarios;
+    KernelParams *kernels;
+    ScenarioPartial *partials;
+    ScenarioSketches *sketches;
+} ScenarioJob;
+
+static void scenario_push(ScenarioPartial *partial, double final_profit, int break_even_month) {
+    moments_push(&partial->final_profit, final_profit);
+    if (break_even_month == -1) {
+        partial->no_return_count++;
+    } else {
+        partial->break_even_sum += break_even_month;
+    }
+}
+
+// One path of a scenario against the same path of scenario 0. A path that
+// never breaks even counts as breaking even last.
+static void scenario_compare(ScenarioPartial *partial, double final_profit, int break_even_month,
+                             double base_profit, int base_break_even) {
+    moments_push(&partial->profit_delta, final_profit - base_profit);
+    partial->wins += final_profit > base_profit;
+    if (break_even_month != -1 && base_break_even != -1) {
+        moments_push(&partial->break_even_delta, break_even_month - base_break_even);
+    }
+    partial->earlier += break_even_month != -1 && (base_break_even == -1 || break_even_month < base_break_even);
+}
+
+// Worker scratch of run_scenario_task(): a batch of user paths, a users and
+// a profit row, then the final profit of each of the task's paths under
+// every scenario and their deltas against scenario 0.
+static size_t scenario_scratch_size(int months, int count) {
+    return (size_t)(KERNEL_LANES + 2) * months + (size_t)(count + 1) * PATHS_PER_TASK;
+}
+
+static void run_scenario_task(void *ctx, int task, int worker) {
+    ScenarioJob *job = ctx;
+    int months = job->growth.params->months;
+    int iterations = job->growth.params->iterations;
+    ScenarioPartial *partials = job->partials + (size_t)task * job->count;
+    double *batch = job->growth.scratch + (size_t)worker * scenario_scratch_size(months, job->count);
+    double *users_row = batch + (size_t)KERNEL_LANES * months;
+    double *profit_row = users_row + months;
+    double *finals = profit_row + months;   // [scenario * PATHS_PER_TASK + path]
+    double *deltas = finals + (size_t)job->count * PATHS_PER_TASK;
+    int *break_even = job->growth.break_even_paths + (size_t)worker * job->count * PATHS_PER_TASK;
+
+    int begin = (job->growth.first_task + task) * PATHS_PER_TASK;
+    int end = begin + PATHS_PER_TASK;
+    if (end > iterations) end = iterations;
+    int paths = end - begin;
+    memset(partials, 0, job->count * sizeof(ScenarioPartial));
+
+    uint64_t stage_ns[TRACE_STAGE_COUNT] = {0};
+    TRACE_BEGIN(task_start);
+    uint64_t mark = task_start;
+
+    int path = 0;
+    for (; path + KERNEL_LANES <= paths; path += KERNEL_LANES) {
+        kernel_simulate_batch(&job->growth.kernel, begin + path, batch, KERNEL_LANES);
+        trace_lap(&mark, &stage_ns[TRACE_GROWTH]);
+        for (int s = 0; s < job->count; s++) {
+            double *final_profit = finals + (size_t)s * PATHS_PER_TASK + path;
+            int *break_even_month = break_even + (size_t)s * PATHS_PER_TASK + path;
+            if (job->growth.rules) {
+                rules_profits(&job->growth, job->growth.rules_scratch[worker], &job->scenarios[s], batch,
+                              KERNEL_LANES, KERNEL_LANES, NULL, final_profit, break_even_month);
+            } else {
+                kernel_profit_batch(&job->kernels[s], batch, final_profit, break_even_month);
+            }
+        }
+        trace_lap(&mark, &stage_ns[TRACE_FINANCE]);
+    }
+    for (; path < paths; path++) {
+        simulate_users(&job->growth, begin + path, users_row, 1);
+        trace_lap(&mark, &stage_ns[TRACE_GROWTH]);
+        for (int s = 0; s < job->count; s++) {
+            break_even[(size_t)s * PATHS_PER_TASK + path] =
+                finance_path(&job->growth, worker, &job->kernels[s], &job->scenarios[s], users_row, profit_row);
+            finals[(size_t)s * PATHS_PER_TASK + path] = profit_row[months - 1];
+        }
+        trace_lap(&mark, &stage_ns[TRACE_FINANCE]);
+    }
+
+    for (int s = 0; s < job->count; s++) {
+        const double *final_profit = finals + (size_t)s * PATHS_PER_TASK;
+        const int *break_even_month = break_even + (size_t)s * PATHS_PER_TASK;
+        int compare = job->compare && s > 0;
+        for (path = 0; path < paths; path++) {
+            scenario_push(&partials[s], final_profit[path], break_even_month[path]);
+        }
+        for (path = 0; compare && path < paths; path++) {
+            deltas[path] = final_profit[path] - finals[path];
+            scenario_compare(&partials[s], final_profit[path], break_even_month[path], finals[path],
+                             break_even[path]);
+        }
+        if (job->compare) {
+            int antithetic = job->growth.params->sampling == FORECAST_SAMPLING_ANTITHETIC;
+            push_units(&partials[s].unit_profit, final_profit, paths, antithetic);
+            if (compare) push_units(&partials[s].unit_delta, deltas, paths, antithetic);
+        }
+        ScenarioSketches *sketches = &job->sketches[s];
+        pthread_mutex_lock(&sketches->lock);
+        sketch_add(&sketches->final_profit, final_profit, paths);
+        if (compare) sketch_add(&sketches->profit_delta, deltas, paths);
+        pthread_mutex_unlock(&sketches->lock);
+    }
+    trace_lap(&mark, &stage_ns[TRACE_AGGREGATE]);
+    if (task_start) trace_span("scenarios", task_start, mark, stage_ns, paths);
+}
+
+// forecast_run_scenarios(), comparing every scenario with the first when
+// deltas is not NULL.
+static int run_scenarios(const ParameterSet *scenarios, int count, const ForecastOptions *options,
+                         ScenarioSummary *summaries, ScenarioDelta *deltas) {
+    if (count < 1 || !params_valid(&scenarios[0])) {
+        return -1;
+    }
+    for (int s = 1; s < count; s++) {
+        if (!parameter_sets_share_growth(&scenarios[0], &scenarios[s])) {
+            return -1;
+        }
+    }
+
+    const ParameterSet *params = &scenarios[0];
+    int months = params->months;
+    int iterations = params->iterations;
+    ForecastPool *pool = options ? options->pool : NULL;
+    int threads = forecast_pool_threads(pool);
+
+    // Memory grows with the scenarios and threads, not the iterations.
+    ScenarioJob job = {0};
+    job.count = count;
+    job.compare = deltas != NULL;
+    job.scenarios = scenarios;
+    double *growth = calloc(2 * (size_t)months, sizeof(double));
+    job.growth.scratch = malloc((size_t)threads * scenario_scratch_size(months, count) * sizeof(double));
+    job.growth.break_even_paths = malloc((size_t)threads * count * PATHS_PER_TASK * sizeof(int));
+    job.kernels = calloc(count, sizeof(KernelParams));
+    job.partials = malloc((size_t)TASKS_PER_ROUND * count * sizeof(ScenarioPartial));
+    job.sketches = malloc(count * sizeof(ScenarioSketches));
+    ScenarioPartial *totals = calloc(count, sizeof(ScenarioPartial));
+    // Per scenario, the units of its final profit and of its delta.
+    UnitError *errors = calloc(2 * (size_t)count, sizeof(UnitError));
+    for (int s = 0; job.sketches && s < count; s++) {
+        pthread_mutex_init(&job.sketches[s].lock, NULL);
+        sketch_reset(&job.sketches[s].final_profit);
+        sketch_reset(&job.sketches[s].profit_delta);
+    }
+
+    int status = -1;
+    if (!growth || !job.growth.scratch || !job.growth.break_even_paths || !job.kernels || !job.partials ||
+        !job.sketches || !totals || !errors || job_set_rules(&job.growth, options, threads) != 0 ||
+        job_prepare(&job.growth, params, options ? options->seed : 0, growth, growth + months) != 0) {
+        goto done;
+    }
+    for (int s = 0; s < count; s++) {
+        job.kernels[s] = job.growth.kernel;
+        kernel_set_finance(&job.kernels[s], &scenarios[s]);
+    }
+
+    int tasks = (iterations + PATHS_PER_TASK - 1) / PATHS_PER_TASK;
+    for (job.growth.first_task = 0; job.growth.first_task < tasks; job.growth.first_task += TASKS_PER_ROUND) {
+        int round_tasks = tasks - job.growth.first_task;
+        if (round_tasks > TASKS_PER_ROUND) round_tasks = TASKS_PER_ROUND;
+        forecast_pool_run(pool, round_tasks, run_scenario_task, &job);
+
+        for (int i = 0; i < round_tasks; i++) {
+            const ScenarioPartial *partials = job.partials + (size_t)i * count;
+            for (int s = 0; s < count; s++) {
+                moments_merge(&totals[s].final_profit, &partials[s].final_profit);
+                totals[s].no_return_count += partials[s].no_return_count;
+                totals[s].break_even_sum += partials[s].break_even_sum;
+                if (job.compare) {
+                    moments_merge(&totals[s].profit_delta, &partials[s].profit_delta);
+                    moments_merge(&totals[s].break_even_delta, &partials[s].break_even_delta);
+                    totals[s].wins += partials[s].wins;
+                    totals[s].earlier += partials[s].earlier;
+                    int task = job.growth.first_task + i;
+                    unit_error_add(&errors[2 * s], params->sampling, task, &partials[s].unit_profit);
+                    unit_error_add(&errors[2 * s + 1], params->sampling, task, &partials[s].unit_delta);
+                }
+            }
+        }
+    }
+
+    for (int s = 0; deltas && s < count; s++) {
+        const QuantileSketch *sketch = &job.sketches[s].profit_delta;
+        ScenarioDelta *delta = &deltas[s];
+        delta->mean_profit_delta = totals[s].profit_delta.mean;
+        delta->std_profit_delta = moments_std(&totals[s].profit_delta);
+        delta->p5_profit_delta = s > 0 ? sketch_quantile(sketch, 0.05) : 0;
+        delta->p50_profit_delta = s > 0 ? sketch_quantile(sketch, 0.50) : 0;
+        delta->p95_profit_delta = s > 0 ? sketch_quantile(sketch, 0.95) : 0;
+        delta->profit_delta_std_error = s > 0 ? unit_std_error(&errors[2 * s + 1], params->sampling) : 0;
+        double base_error = unit_std_error(&errors[0], params->sampling);
+        double error = unit_std_error(&errors[2 * s], params->sampling);
+        delta->unpaired_std_error = s > 0 ? sqrt(base_error * base_error + error * error) : 0;
+        delta->win_probability = totals[s].wins / (double)iterations * 100;
+        delta->earlier_break_even = totals[s].earlier / (double)iterations * 100;
+        delta->both_break_even = (int)totals[s].break_even_delta.count;
+        delta->mean_break_even_delta = s == 0 ? 0 : delta->both_break_even > 0 ? totals[s].break_even_delta.mean : NAN;
+    }
+
+    for (int s = 0; s < count; s++) {
+        const QuantileSketch *sketch = &job.sketches[s].final_profit;
+        int count_break_even_months = iterations - totals[s].no_return_count;
+
+        ScenarioSummary *summary = &summaries[s];
+        summary->mean_final_profit = totals[s].final_profit.mean;
+        summary->std_final_profit = moments_std(&totals[s].final_profit);
+        summary->p5_final_profit = sketch_quantile(sketch, 0.05);
+        summary->p50_final_profit = sketch_quantile(sketch, 0.50);
+        summary->p95_final_profit = sketch_quantile(sketch, 0.95);
+        summary->risk_of_no_return = totals[s].no_return_count / (double)iterations * 100;
+        summary->avg_break_even_month = count_break_even_months > 0
+            ? totals[s].break_even_sum / (double)count_break_even_months : -1;
+    }
+    status = 0;
+
+done:
+    company_size_sampler_free(&job.growth.sizes);
+    job_free_rules(&job.growth, threads);
+    for (int s = 0; job.sketches && s < count; s++) {
+        pthread_mutex_destroy(&job.sketches[s].lock);
+    }
+    free(growth);
+    free(job.growth.scratch);
+    free(job.growth.break_even_paths);
+    free(job.kernels);
+    free(job.partials);
+    free(job.sketches);
+    free(totals);
+    free(errors);
+    return status;
+}
+
+int forecast_run_scenarios(const ParameterSet *scenarios, int count, const ForecastOptions *options,
+                           ScenarioSummary *summaries) {
+    return run_scenarios(scenarios, count, options, summaries, NULL);
+}
+
+int forecast_compare_scenarios(const ParameterSet *scenarios, int count, const ForecastOptions *options,
+                               ScenarioSummary *summaries, ScenarioDelta *deltas) {
+    return run_scenarios(scenarios, count, options, summaries, deltas);
+}
+
+int forecast_trace_path(const ParameterSet *params, uint64_t seed, const ForecastRules *rules, int path,
+                        double *user_growth, double *cumulative_profit, int *break_even_month) {
+    if (!params_valid(params) || path < 0) {
+        return -1;
+    }
+
+    int months = params->months;
+    ForecastJob job = {0};
+    double *buffer = malloc((size_t)4 * months * sizeof(double));
+    if (!buffer) return -1;
+    double *company_growth = buffer;
+    double *new_companies = buffer + months;
+    double *users_row = buffer + 2 * (size_t)months;
+    double *profit_row = buffer + 3 * (size_t)months;
+
+    ForecastOptions options = {NULL, seed};
+    options.rules = rules;
+    int status = -1;
+    if (job_set_rules(&job, &options, 1) == 0 && job_prepare(&job, params, seed, company_growth, new_companies) == 0) {
+        simulate_users(&job, path, users_row, 1);
+        int break_even = finance_path(&job, 0, &job.kernel, params, users_row, profit_row);
+        if (user_growth) memcpy(user_growth, users_row, months * sizeof(double));
+        if (cumulative_profit) memcpy(cumulative_profit, profit_row, months * sizeof(double));
+        if (break_even_month) *break_even_month = break_even;
+        status = 0;
+    }
+
+    company_size_sampler_free(&job.sizes);
+    job_free_rules(&job, 1);
+    free(buffer);
+    return status;
+}
@@ -0,0 +1,232 @@
+#ifndef FORECAST_CORE_H
+#define FORECAST_CORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Rates, expenses and prices are per month whatever the step; `months` is
+// the number of steps simulated and step_days their length, 0 for calendar
+// months. sampling is a FORECAST_SAMPLING_* mode. With a nonzero
+// profit_tolerance or risk_tolerance, forecast_run() stops once the
+// standard error of the final mean cumulative profit ($) and of the risk of
+// no return (percentage points) are within them, iterations being the
+// most paths it may run. Positional initializers leave the fields after
+// iterations 0.
+typedef struct {
+    float initial_investment;
+    float colocation_expense;
+    float marketing_expense;
+    int months;
+    float price_per_gb;
+    float avg_gb_per_user;
+    int initial_users;
+    int initial_companies;
+    int min_employees_per_company;
+    int max_employees_per_company;
+    float mean_company_size;
+    float acquisition_rate;
+    float initial_storage;
+    float cost_per_gb;
+    int iterations;
+    int step_days;
+    int sampling;
+    float profit_tolerance;
+    float risk_tolerance;
+} ParameterSet;
+
+// How the company-size draws of a run are sampled.
+enum {
+    FORECAST_SAMPLING_RANDOM,       // independent pseudo-random draws
+    FORECAST_SAMPLING_ANTITHETIC,   // each odd path mirrors the path before it
+    FORECAST_SAMPLING_SOBOL         // padded Owen-scrambled Sobol points
+};
+
+// Average calendar month, the length of a step when step_days is 0.
+#define FORECAST_DAYS_PER_MONTH 30.4375
+
+// Predefined parameter sets
+extern const ParameterSet parameter_sets[];
+extern const char *parameter_set_names[];
+extern const int parameter_set_count;
+
+// Which stage of the pipeline a field feeds: growth fields shape the
+// simulated user paths, storage fields turn users into GB and finance
+// fields turn GB into money. Run fields feed no stage; they only say when
+// forecast_run() may stop.
+typedef enum {
+    PARAM_GROWTH,
+    PARAM_STORAGE,
+    PARAM_FINANCE,
+    PARAM_RUN
+} ParameterStage;
+
+typedef struct {
+    const char *name;
+    size_t offset;
+    int is_int;
+    ParameterStage stage;
+} ParameterField;
+
+extern const ParameterField parameter_fields[];
+extern const int parameter_field_count;
+
+const ParameterField *parameter_field_find(const char *name);
+double parameter_get(const ParameterSet *params, const ParameterField *field);
+void parameter_set(ParameterSet *params, const ParameterField *field, double value);
+// Months one step covers, which monthly rates are rescaled by.
+double parameter_step_months(const ParameterSet *params);
+// "month", "week", "day", or "step" for any other step length.
+const char *parameter_step_unit(const ParameterSet *params);
+// Nonzero when a and b only differ in storage or finance fields.
+int parameter_sets_share_growth(const ParameterSet *a, const ParameterSet *b);
+
+// Fixed pool of worker threads shared by every run. threads <= 0 uses one
+// thread per online CPU. The calling thread of forecast_run() counts as one.
+typedef struct ForecastPool ForecastPool;
+
+ForecastPool *forecast_pool_create(int threads);
+void forecast_pool_destroy(ForecastPool *pool);
+int forecast_pool_threads(const ForecastPool *pool);
+
+// Runs fn(ctx, task, worker) for every task in [0, tasks) on the pool and
+// returns once all are done; worker is in [0, forecast_pool_threads()).
+typedef void (*ForecastTaskFn)(void *ctx, int task, int worker);
+void forecast_pool_run(ForecastPool *pool, int tasks, ForecastTaskFn fn, void *ctx);
+
+typedef struct ForecastResult ForecastResult;
+
+// Called on the thread running forecast_run() after each round of paths with
+// the result over the paths done so far (partial->iterations of them).
+// Returning nonzero cancels the run.
+typedef int (*ForecastProgressFn)(void *ctx, const ForecastResult *partial);
+
+struct ForecastRules;
+
+typedef struct {
+    ForecastPool *pool;     // NULL runs every path on the calling thread
+    uint64_t seed;
+    ForecastProgressFn progress;    // optional
+    void *progress_ctx;
+    // Optional finance model of forecast_rules.h replacing the built-in
+    // price and expenses; growth and storage are unchanged.
+    const struct ForecastRules *rules;
+} ForecastOptions;
+
+// forecast_run() status when the progress callback cancelled the run.
+#define FORECAST_CANCELLED 1
+
+// Per-month arrays hold `months` entries and are owned by the result.
+struct ForecastResult {
+    int months;
+    int iterations;
+    double *company_growth;
+    double *avg_user_growth;
+    double *avg_monthly_storage_usage;
+    double *std_monthly_storage_usage;
+    double *avg_cumulative_profit;
+    double *std_cumulative_profit;
+    // Percentiles from streaming quantile sketches (forecast_sketch.h), off
+    // by at most 2 (max - min) / SKETCH_BINS of the month's values.
+    double *p5_monthly_storage_usage;
+    double *p50_monthly_storage_usage;
+    double *p95_monthly_storage_usage;
+    double *p5_cumulative_profit;
+    double *p50_cumulative_profit;
+    double *p95_cumulative_profit;
+    int *break_even_histogram;      // paths first breaking even in each month
+    double total_net_profit;
+    double roi;                     // NAN without an initial investment
+    double risk_of_no_return;
+    double avg_break_even_month;    // -1 when no path breaks even
+    // Standard errors of total_net_profit and risk_of_no_return, from the
+    // spread between paths, antithetic pairs or Sobol replicates; NAN where
+    // not estimated.
+    double profit_std_error;
+    double risk_std_error;
+};
+
+// Every per-month double array of a ForecastResult.
+#define FORECAST_RESULT_SERIES(X)                                                                   \
+    X(company_growth) X(avg_user_growth)                                                            \
+    X(avg_monthly_storage_usage) X(std_monthly_storage_usage)                                       \
+    X(avg_cumulative_profit) X(std_cumulative_profit)                                               \
+    X(p5_monthly_storage_usage) X(p50_monthly_storage_usage) X(p95_monthly_storage_usage)           \
+    X(p5_cumulative_profit) X(p50_cumulative_profit) X(p95_cumulative_profit)
+
+// Runs params->iterations Monte Carlo paths. Every random number is a pure
+// function of (seed, path, month, draw), so the result is bit-identical for
+// any pool size. Returns 0 on success, -1 on invalid parameters or OOM and
+// FORECAST_CANCELLED if the progress callback asked to stop.
+int forecast_run(const ParameterSet *params, const ForecastOptions *options, ForecastResult *result);
+// Allocates zeroed per-month arrays. 0 on success; frees them on OOM.
+int forecast_result_alloc(ForecastResult *result, int months, int iterations);
+void forecast_result_free(ForecastResult *result);
+// Deep copy into dst, replacing whatever dst held. 0 on success.
+int forecast_result_copy(ForecastResult *dst, const ForecastResult *src);
+
+// Simulates every path's user counts into users[month * iterations + path]
+// and the shared company curve into company_growth, the same paths
+// forecast_run() aggregates. Month-major, so per-month passes over all
+// paths read contiguously.
+int forecast_simulate_users(const ParameterSet *params, const ForecastOptions *options,
+                            double *company_growth, double *users);
+
+// Regenerates paths [first, first + count) of a run on the pool, exactly as
+// forecast_run() simulated them, into month-major arrays of count doubles
+// per month (users[month * count + i]), so a run's paths can be stored in
+// chunks without holding all of them. Any output but users may be NULL.
+int forecast_simulate_paths(const ParameterSet *params, const ForecastOptions *options, int first, int count,
+                            double *users, double *cumulative_profit, int *break_even_month);
+
+// Final-month statistics of one scenario of forecast_run_scenarios(). The
+// percentiles come from quantile sketches like ForecastResult's.
+typedef struct {
+    double mean_final_profit;
+    double std_final_profit;
+    double p5_final_profit;
+    double p50_final_profit;
+    double p95_final_profit;
+    double risk_of_no_return;
+    double avg_break_even_month;    // -1 when no path breaks even
+} ScenarioSummary;
+
+// Evaluates `count` parameter sets that share every growth field on one
+// shared set of simulated user paths, so the growth simulation runs once
+// for all of them. Memory grows with count and the pool size, not the
+// iterations. Every path is run; the tolerances are ignored. Returns -1 if
+// the scenarios do not share growth.
+int forecast_run_scenarios(const ParameterSet *scenarios, int count, const ForecastOptions *options,
+                           ScenarioSummary *summaries);
+
+// One scenario against scenarios[0] on the same simulated paths: every
+// statistic is of per-path differences (scenario minus baseline), so the
+// growth noise both share cancels. A path that never breaks even counts as
+// breaking even last.
+typedef struct {
+    double mean_profit_delta;       // final cumulative profit
+    double std_profit_delta;
+    double p5_profit_delta;
+    double p50_profit_delta;
+    double p95_profit_delta;
+    double profit_delta_std_error;  // of the mean delta
+    double unpaired_std_error;      // the same from two independent runs
+    double win_probability;         // % of paths ending ahead of the baseline
+    double earlier_break_even;      // % of paths breaking even before it
+    double mean_break_even_delta;   // over paths where both break even; NAN if none
+    int both_break_even;            // paths in mean_break_even_delta
+} ScenarioDelta;
+
+// forecast_run_scenarios() that also compares every scenario with
+// scenarios[0] path by path in the same pass; deltas[0] compares the
+// baseline with itself.
+int forecast_compare_scenarios(const ParameterSet *scenarios, int count, const ForecastOptions *options,
+                               ScenarioSummary *summaries, ScenarioDelta *deltas);
+
+// Regenerates path `path` of a run with this seed and rules (NULL for the
+// built-in finance) on the calling thread, exactly as forecast_run()
+// simulated it. Arrays receive params->months values; any output may be
+// NULL.
+int forecast_trace_path(const ParameterSet *params, uint64_t seed, const struct ForecastRules *rules, int path,
+                        double *user_growth, double *cumulative_profit, int *break_even_month);
+
+#endif
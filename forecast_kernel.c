@@ -0,0 +1,251 @@
+#include "forecast_core.h"
+#include "forecast_kernel.h"
+#include "forecast_rng.h"
+
+// Lane-wise vectors; GCC lowers them to ymm on AVX2 and to xmm pairs on
+// baseline SSE2. Lanes never interact, so every ISA yields identical bits.
+typedef double v4d __attribute__((vector_size(KERNEL_LANES * sizeof(double))));
+typedef long long v4l __attribute__((vector_size(KERNEL_LANES * sizeof(long long))));
+typedef int v4i __attribute__((vector_size(KERNEL_LANES * sizeof(int))));
+typedef uint64_t v4u __attribute__((vector_size(KERNEL_LANES * sizeof(uint64_t))));
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNEL_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define KERNEL_CLONES
+#endif
+
+#define LOAD(ptr) ({ v4d v_; __builtin_memcpy(&v_, (ptr), sizeof(v_)); v_; })
+#define STORE(ptr, v) do { v4d v_ = (v); __builtin_memcpy((ptr), &v_, sizeof(v_)); } while (0)
+#define SELECT(mask, a, b) ((v4d)(((v4l)(a) & (mask)) | ((v4l)(b) & ~(mask))))
+
+#define PUSH(lm, x, inv_count) do {                         \
+        v4d mean_ = LOAD((lm)->mean);                       \
+        v4d delta_ = (x) - mean_;                           \
+        mean_ += delta_ * (inv_count);                      \
+        STORE((lm)->mean, mean_);                           \
+        STORE((lm)->m2, LOAD((lm)->m2) + delta_ * ((x) - mean_)); \
+    } while (0)
+
+#define ROTL(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+// The random bits of rng_block() for every lane. Fully unrolled so every
+// rotation count is an immediate.
+#define RNG_BITS(path, month, block, seed, out0, out1) do { \
+        uint64_t ks_[3] = {(seed), 0, THREEFRY_PARITY ^ (seed)}; \
+        v4u x0_ = (path) + ks_[0];                          \
+        v4u x1_ = (v4u){0} + ((((uint64_t)(month) << 32) | (uint32_t)(block)) + ks_[1]); \
+        _Pragma("GCC unroll 20")                            \
+        for (int r_ = 0; r_ < THREEFRY_ROUNDS; r_++) {      \
+            x0_ += x1_;                                     \
+            x1_ = ROTL(x1_, threefry_rotations[r_ % 8]);    \
+            x1_ ^= x0_;                                     \
+            if (r_ % 4 == 3) {                              \
+                int i_ = (r_ + 1) / 4;                      \
+                x0_ += ks_[i_ % 3];                         \
+                x1_ += ks_[(i_ + 1) % 3] + i_;              \
+            }                                               \
+        }                                                   \
+        (out0) = x0_;                                       \
+        (out1) = x1_;                                       \
+    } while (0)
+
+#define BITS_TO_UNIFORM(bits) ((v4d)(((bits) >> 12) | PATH_RNG_ONE) - 1.0)
+
+// company_size_draw() for every lane. Columns are 32-bit so the conversions
+// stay packed; only the two table loads per lane are scalar.
+#define DRAW(sizes, u) ({                                   \
+        v4d x_ = (u) * (double)(sizes)->count;              \
+        v4i column_ = __builtin_convertvector(x_, v4i);     \
+        v4i last_ = (v4i){0} + ((sizes)->count - 1);        \
+        column_ = (column_ & (column_ <= last_)) | (last_ & (column_ > last_)); \
+        v4d frac_ = x_ - __builtin_convertvector(column_, v4d); \
+        const double *p_ = (sizes)->prob;                   \
+        const int *a_ = (sizes)->alias;                     \
+        v4d prob_ = {0};                                    \
+        v4i alias_ = {0};                                   \
+        for (int lane_ = 0; lane_ < KERNEL_LANES; lane_++) { \
+            prob_[lane_] = p_[column_[lane_]];              \
+            alias_[lane_] = a_[column_[lane_]];             \
+        }                                                   \
+        v4i keep_ = __builtin_convertvector(frac_ < prob_, v4i); \
+        __builtin_convertvector((column_ & keep_) | (alias_ & ~keep_), v4d) + (double)(sizes)->min_size; })
+
+// company_size_quantile() for every lane.
+#define QUANTILE(sizes, u) ({                                \
+        v4d q_ = {0};                                       \
+        for (int lane_ = 0; lane_ < KERNEL_LANES; lane_++) { \
+            q_[lane_] = company_size_quantile((sizes), (u)[lane_]); \
+        }                                                   \
+        q_; })
+
+KERNEL_CLONES
+void kernel_simulate_batch(const KernelParams *kp, int first_path, double *users, int stride) {
+    const CompanySizeSampler *sizes = kp->sizes;
+    v4u path;
+    for (int lane = 0; lane < KERNEL_LANES; lane++) {
+        path[lane] = (uint64_t)(first_path + lane);
+    }
+    // Antithetic lanes draw from their even partner's counters. Both
+    // variance-reduction modes draw by inverse transform, which keeps a
+    // mirrored or stratified uniform mirrored or stratified in headcount.
+    int antithetic = kp->sampling == FORECAST_SAMPLING_ANTITHETIC;
+    int inverse = kp->sampling != FORECAST_SAMPLING_RANDOM;
+    v4u counter = antithetic ? path & ~1ull : path;
+    v4u odd = (v4u){0} - (path & 1);
+    v4u replicate = RNG_SOBOL_REPLICATE(path);
+    v4u index = RNG_SOBOL_INDEX(path);
+
+    // A month needs at most one uniform per company plus one for the
+    // fractional company, or two for the normal approximation.
+    v4d u[SAMPLER_NORMAL_APPROX_COMPANIES + 2];
+    v4d zero = {0};
+    v4d lane_users = zero + kp->initial_users;
+    STORE(users, lane_users);
+    for (int month = 1; month < kp->months; month++) {
+        double new_companies = kp->new_companies[month];
+        int whole = (int)new_companies;
+        double fraction = new_companies - whole;
+        int normal = whole > SAMPLER_NORMAL_APPROX_COMPANIES;
+        int need = (normal ? 2 : whole) + (fraction > 0);
+        for (int block = 0; 2 * block < need; block++) {
+            v4u x0, x1;
+            RNG_BITS(counter, month, block, kp->seed, x0, x1);
+            if (antithetic) {
+                int box_muller = normal && block == 0;
+                x0 ^= odd & (box_muller ? 0 : RNG_MIRROR);
+                x1 ^= odd & (box_muller ? RNG_HALF_TURN : RNG_MIRROR);
+            } else if (kp->sampling == FORECAST_SAMPLING_SOBOL) {
+                // Sobol points in the high bits, random bits below them.
+                // Lanes only straddle replicates where a batch crosses a
+                // block, so the seeds are rarely derived more than once.
+                uint64_t dimension[2];
+                v4u dimension0, dimension1;
+                for (int lane = 0; lane < KERNEL_LANES; lane++) {
+                    if (lane == 0 || replicate[lane] != replicate[lane - 1]) {
+                        rng_sobol_seeds(kp->seed, replicate[lane], month, block, dimension);
+                    }
+                    dimension0[lane] = dimension[0];
+                    dimension1[lane] = dimension[1];
+                }
+                x0 = (RNG_SOBOL(index, dimension0) << 32) | (x0 & 0xFFFFFFFFull);
+                x1 = (RNG_SOBOL(index, dimension1) << 32) | (x1 & 0xFFFFFFFFull);
+            }
+            u[2 * block] = BITS_TO_UNIFORM(x0);
+            u[2 * block + 1] = BITS_TO_UNIFORM(x1);
+        }
+
+        v4d new_users = zero;
+        int next = 0;
+        if (normal) {
+            for (int lane = 0; lane < KERNEL_LANES; lane++) {
+                new_users[lane] = company_size_total(sizes, whole, u[0][lane], u[1][lane]);
+            }
+            next = 2;
+        } else {
+            for (; next < whole; next++) {
+                new_users += inverse ? QUANTILE(sizes, u[next]) : DRAW(sizes, u[next]);
+            }
+        }
+        if (fraction > 0) {
+            new_users += fraction * (inverse ? QUANTILE(sizes, u[next]) : DRAW(sizes, u[next]));
+        }
+        lane_users += new_users;
+        STORE(users + (size_t)month * stride, lane_users);
+    }
+}
+
+KERNEL_CLONES
+void kernel_open_balance(const KernelParams *kp, const double *users, int stride, double *balance) {
+    v4d zero = {0};
+    v4d gb = zero + kp->avg_gb_per_user;
+    v4d initial_storage = zero + kp->initial_storage;
+    v4d cost_per_gb = zero + kp->cost_per_gb;
+
+    // The one-time extra usage cost at each lane's first month over the
+    // initial storage.
+    v4d extra_cost = zero;
+    v4l applied = {0};
+    for (int month = 0; month < kp->months; month++) {
+        v4d storage = LOAD(users + (size_t)month * stride) * gb;
+        v4l crossed = (storage > initial_storage) & ~applied;
+        extra_cost = SELECT(crossed, (storage - initial_storage) * cost_per_gb, extra_cost);
+        applied |= crossed;
+    }
+    STORE(balance, zero - kp->initial_investment - extra_cost);
+}
+
+KERNEL_CLONES
+void kernel_fold_month(const KernelParams *kp, int month, const double *users, const double *net, int count,
+                       KernelMonthMoments *acc, double *balance, int *break_even_month, double *storage_out,
+                       double *profit_out) {
+    v4d zero = {0};
+    v4d gb = zero + kp->avg_gb_per_user;
+    v4d price = zero + kp->price_per_gb;
+    v4d expenses = zero + kp->expenses;
+    v4i this_month = (v4i){0} + month;
+
+    for (int path = 0, batch = 1; path < count; path += KERNEL_LANES, batch++) {
+        v4d inv_count = zero + 1.0 / batch;
+        v4d lane_users = LOAD(users + path);
+        v4d storage = lane_users * gb;
+        v4d cumulative = LOAD(balance + path);
+        cumulative += net ? LOAD(net + path) : storage * price - expenses;
+
+        PUSH(&acc->users, lane_users, inv_count);
+        PUSH(&acc->storage, storage, inv_count);
+        PUSH(&acc->profit, cumulative, inv_count);
+        STORE(balance + path, cumulative);
+        STORE(storage_out + path, storage);
+        STORE(profit_out + path, cumulative);
+
+        v4i break_even;
+        __builtin_memcpy(&break_even, break_even_month + path, sizeof(break_even));
+        v4i hit = __builtin_convertvector(cumulative >= zero, v4i) & (break_even < 0);
+        break_even = (break_even & ~hit) | (this_month & hit);
+        __builtin_memcpy(break_even_month + path, &break_even, sizeof(break_even));
+    }
+}
+
+KERNEL_CLONES
+void kernel_profit_batch(const KernelParams *kp, const double *users,
+                         double *final_profit, int *break_even_month) {
+    v4d zero = {0};
+    v4d gb = zero + kp->avg_gb_per_user;
+    v4d price = zero + kp->price_per_gb;
+    v4d expenses = zero + kp->expenses;
+    v4d initial_storage = zero + kp->initial_storage;
+    v4d cost_per_gb = zero + kp->cost_per_gb;
+
+    v4d extra_cost = zero;
+    v4l applied = {0};
+    for (int month = 0; month < kp->months; month++) {
+        v4d storage = LOAD(users + month * KERNEL_LANES) * gb;
+        v4l crossed = (storage > initial_storage) & ~applied;
+        extra_cost = SELECT(crossed, (storage - initial_storage) * cost_per_gb, extra_cost);
+        applied |= crossed;
+    }
+
+    v4d cumulative = zero - kp->initial_investment - extra_cost;
+    v4l break_even = (v4l){0} - 1;
+    for (int month = 0; month < kp->months; month++) {
+        cumulative += LOAD(users + month * KERNEL_LANES) * gb * price - expenses;
+        v4l hit = (cumulative >= zero) & (break_even < 0);
+        break_even = (break_even & ~hit) | (((v4l){0} + month) & hit);
+    }
+
+    STORE(final_profit, cumulative);
+    for (int lane = 0; lane < KERNEL_LANES; lane++) {
+        break_even_month[lane] = (int)break_even[lane];
+    }
+}
+
+const char *kernel_isa(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return "avx2";
+    return "sse2";
+#else
+    return "generic";
+#endif
+}
@@ -0,0 +1,72 @@
+#ifndef FORECAST_KERNEL_H
+#define FORECAST_KERNEL_H
+
+#include <stdint.h>
+
+#include "forecast_sampler.h"
+
+// Paths advanced together by the vector kernel, one per lane.
+#define KERNEL_LANES 4
+
+typedef struct {
+    int months;
+    uint64_t seed;
+    int sampling;           // FORECAST_SAMPLING_*
+    double initial_users;
+    const double *new_companies;
+    const CompanySizeSampler *sizes;
+    double avg_gb_per_user;
+    double price_per_gb;
+    double expenses;
+    double initial_investment;
+    double initial_storage;
+    double cost_per_gb;
+} KernelParams;
+
+// Welford state of one month for every lane. All lanes of a task have seen
+// the same number of batches, so the count lives outside.
+typedef struct {
+    double mean[KERNEL_LANES];
+    double m2[KERNEL_LANES];
+} LaneMoments;
+
+typedef struct {
+    LaneMoments users;
+    LaneMoments storage;
+    LaneMoments profit;
+} KernelMonthMoments;
+
+// Draws the user paths of paths first_path .. first_path + KERNEL_LANES - 1
+// into users[month * stride + lane]. Each lane generates its month's
+// uniforms in bulk from the same (seed, path, month) counters the scalar
+// sampler uses, so results match bit for bit.
+void kernel_simulate_batch(const KernelParams *kp, int first_path, double *users, int stride);
+
+// Opening cumulative profit of a batch laid out users[month * stride + lane]:
+// minus the initial investment and the one-time extra usage cost, which
+// depends on the whole path and is booked against month one.
+void kernel_open_balance(const KernelParams *kp, const double *users, int stride, double *balance);
+
+// Advances count paths (a multiple of KERNEL_LANES) by one month, so a
+// long horizon is folded a month at a time over a tile of paths rather than
+// a path at a time over every month. users holds the month's value of each
+// path and net, unless NULL, its cash flow in place of the built-in
+// storage * price - expenses. balance, the running cumulative profit, is
+// updated in place and break_even_month (-1 until reached) set to month
+// where it first turns non-negative. Batch b of the tile is folded into the
+// lane moments acc as its (b + 1)th sample, and storage and profit are
+// written to storage_out/profit_out[path]. Dispatches to the widest ISA the
+// CPU supports.
+void kernel_fold_month(const KernelParams *kp, int month, const double *users, const double *net, int count,
+                       KernelMonthMoments *acc, double *balance, int *break_even_month, double *storage_out,
+                       double *profit_out);
+
+// Final cumulative profit and break-even month (-1 if none) of each lane of
+// a batch laid out users[month * KERNEL_LANES + lane], without moments.
+void kernel_profit_batch(const KernelParams *kp, const double *users,
+                         double *final_profit, int *break_even_month);
+
+// Name of the ISA kernel_fold_month() dispatches to on this CPU.
+const char *kernel_isa(void);
+
+#endif
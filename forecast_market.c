@@ -0,0 +1,329 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "forecast_market.h"
+#include "forecast_rng.h"
+
+// Consumers advanced together, one per lane.
+#define MARKET_LANES 4
+
+// Consumers per task, a multiple of MARKET_LANES.
+#define MARKET_CONSUMERS_PER_TASK 4096
+
+// RNG streams of market_generate(), in the month slot of the counter.
+enum {
+    MARKET_STREAM_CONSUMERS,
+    MARKET_STREAM_PRODUCTS
+};
+
+typedef double v4d __attribute__((vector_size(MARKET_LANES * sizeof(double))));
+typedef long long v4l __attribute__((vector_size(MARKET_LANES * sizeof(long long))));
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MARKET_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define MARKET_CLONES
+#endif
+
+int market_alloc(Market *market, int consumers, int products) {
+    memset(market, 0, sizeof(*market));
+    if (consumers < 0 || products < 0 || consumers > MARKET_MAX_SIZE || products > MARKET_MAX_SIZE) return -1;
+    market->consumers = consumers;
+    market->products = products;
+    market->budget = malloc(((size_t)consumers + 1) * sizeof(double));
+    market->preference = malloc(((size_t)consumers + 1) * sizeof(double));
+    market->price = malloc(((size_t)products + 1) * sizeof(double));
+    market->quality = malloc(((size_t)products + 1) * sizeof(double));
+    if (!market->budget || !market->preference || !market->price || !market->quality) {
+        market_free(market);
+        return -1;
+    }
+    return 0;
+}
+
+void market_free(Market *market) {
+    free(market->budget);
+    free(market->preference);
+    free(market->price);
+    free(market->quality);
+    memset(market, 0, sizeof(*market));
+}
+
+void market_generate(Market *market, uint64_t seed) {
+    for (int i = 0; i < market->consumers; i++) {
+        double u[2];
+        rng_block(seed, i, MARKET_STREAM_CONSUMERS, 0, u);
+        market->budget[i] = 100 + 400 * u[0];
+        market->preference[i] = u[1];
+    }
+    for (int j = 0; j < market->products; j++) {
+        double u[2];
+        rng_block(seed, j, MARKET_STREAM_PRODUCTS, 0, u);
+        market->price[j] = 10 + 40 * u[0];
+        market->quality[j] = u[1];
+    }
+}
+
+int market_write(const Market *market, const char *path) {
+    FILE *out = fopen(path, "w");
+    if (!out) return -1;
+    fprintf(out, "%d %d\n", market->consumers, market->products);
+    for (int i = 0; i < market->consumers; i++) {
+        fprintf(out, "%.17g %.17g\n", market->budget[i], market->preference[i]);
+    }
+    for (int j = 0; j < market->products; j++) {
+        fprintf(out, "%.17g %.17g\n", market->price[j], market->quality[j]);
+    }
+    int failed = ferror(out);
+    return fclose(out) != 0 || failed ? -1 : 0;
+}
+
+// Two finite numbers from in.
+static int market_read_pair(FILE *in, double *a, double *b) {
+    return fscanf(in, "%lf %lf", a, b) == 2 && isfinite(*a) && isfinite(*b) ? 0 : -1;
+}
+
+int market_read(Market *market, const char *path) {
+    memset(market, 0, sizeof(*market));
+    FILE *in = fopen(path, "r");
+    if (!in) return -1;
+    // Read wide so sizes past int are refused rather than wrapped.
+    long long consumers, products;
+    int status = fscanf(in, "%lld %lld", &consumers, &products) == 2 && consumers >= 0 && products >= 0 &&
+                 consumers <= MARKET_MAX_SIZE && products <= MARKET_MAX_SIZE
+                 ? market_alloc(market, (int)consumers, (int)products) : -1;
+    for (int i = 0; status == 0 && i < consumers; i++) {
+        status = market_read_pair(in, &market->budget[i], &market->preference[i]);
+    }
+    for (int j = 0; status == 0 && j < products; j++) {
+        status = market_read_pair(in, &market->price[j], &market->quality[j]);
+    }
+    char extra;
+    if (status == 0 && fscanf(in, " %c", &extra) == 1) status = -1;
+    fclose(in);
+    if (status != 0) market_free(market);
+    return status;
+}
+
+void market_result_free(MarketResult *result) {
+    free(result->sales);
+    free(result->monthly_sales);
+    memset(result, 0, sizeof(*result));
+}
+
+// Products ranked by quality: a consumer's candidates are exactly the
+// products ranked below its reach, the number of products whose quality
+// does not exceed its preference. Consumers are sorted by reach, so a task
+// walks few distinct candidate lists, and consumers that cannot afford the
+// cheapest product within reach are given reach 0 and never simulated.
+typedef struct {
+    const Market *market;
+    int months;
+    int tasks;
+    int *rank;                  // [product]: position by quality
+    double *cheapest;           // [reach]: lowest price among the candidates
+    double *budget;             // by reach, padded to whole batches
+    int *reach;
+    int *candidates;            // per worker: [products]
+    long long *monthly;         // per worker: [month * products + product]
+    long long *buyers;          // [task]
+    double *remaining;          // [task]
+} MarketJob;
+
+typedef struct {
+    double quality;
+    int id;
+} RankedProduct;
+
+static int compare_quality(const void *a, const void *b) {
+    const RankedProduct *x = a;
+    const RankedProduct *y = b;
+    if (x->quality != y->quality) return x->quality < y->quality ? -1 : 1;
+    return x->id - y->id;
+}
+
+// Candidates of a given reach in id order, the order Market.simulate walks
+// them in.
+static int list_candidates(const MarketJob *job, int reach, int *candidates) {
+    int count = 0;
+    for (int j = 0; j < job->market->products; j++) {
+        if (job->rank[j] < reach) candidates[count++] = j;
+    }
+    return count;
+}
+
+// One batch of consumers over every month, with the budgets in a vector.
+// A lane buys when the product is within its reach and affordable, which
+// is Consumer.decide_purchase(); the budget is reduced by the same
+// subtraction Python does. Once no lane can afford its cheapest candidate,
+// the remaining months cannot sell anything and are skipped. Updates
+// budgets in place and returns how many lanes bought anything.
+MARKET_CLONES
+static int simulate_batch(const MarketJob *job, const int *candidates, int count, double *budgets,
+                          const int *reach_in, long long *monthly) {
+    const Market *market = job->market;
+    int products = market->products;
+    v4d budget;
+    __builtin_memcpy(&budget, budgets, sizeof(budget));
+    v4l reach = {reach_in[0], reach_in[1], reach_in[2], reach_in[3]};
+    v4d floor = {job->cheapest[reach_in[0]], job->cheapest[reach_in[1]],
+                 job->cheapest[reach_in[2]], job->cheapest[reach_in[3]]};
+    v4l bought = {0};
+
+    for (int month = 0; month < job->months; month++) {
+        v4l active = budget >= floor;
+        if (!(active[0] | active[1] | active[2] | active[3])) break;
+        long long *sales = monthly + (size_t)month * products;
+        for (int c = 0; c < count; c++) {
+            int j = candidates[c];
+            double price = market->price[j];
+            v4l buy = ((v4l){0} + job->rank[j] < reach) & (budget >= price);
+            budget = (v4d)(((v4l)(budget - price) & buy) | ((v4l)budget & ~buy));
+            sales[j] -= buy[0] + buy[1] + buy[2] + buy[3];
+            bought |= buy;
+        }
+    }
+    __builtin_memcpy(budgets, &budget, sizeof(budget));
+    return (int)-(bought[0] + bought[1] + bought[2] + bought[3]);
+}
+
+static void run_market_task(void *ctx, int task, int worker) {
+    MarketJob *job = ctx;
+    int products = job->market->products;
+    int *candidates = job->candidates + (size_t)worker * products;
+    long long *monthly = job->monthly + (size_t)worker * job->months * products;
+    int begin = task * MARKET_CONSUMERS_PER_TASK;
+    int end = begin + MARKET_CONSUMERS_PER_TASK;
+    int padded = (job->market->consumers + MARKET_LANES - 1) / MARKET_LANES * MARKET_LANES;
+    if (end > padded) end = padded;
+
+    int listed = -1;
+    int count = 0;
+    long long buyers = 0;
+    double remaining = 0;
+    for (int i = begin; i < end; i += MARKET_LANES) {
+        double budget[MARKET_LANES];
+        memcpy(budget, job->budget + i, sizeof(budget));
+        int reach = 0;
+        for (int lane = 0; lane < MARKET_LANES; lane++) {
+            if (job->reach[i + lane] > reach) reach = job->reach[i + lane];
+        }
+        if (reach > 0) {
+            if (reach != listed) {
+                count = list_candidates(job, reach, candidates);
+                listed = reach;
+            }
+            buyers += simulate_batch(job, candidates, count, budget, job->reach + i, monthly);
+        }
+        for (int lane = 0; lane < MARKET_LANES; lane++) {
+            remaining += budget[lane];
+        }
+    }
+    job->buyers[task] = buyers;
+    job->remaining[task] = remaining;
+}
+
+int market_simulate(const Market *market, int months, ForecastPool *pool, MarketResult *result) {
+    memset(result, 0, sizeof(*result));
+    if (months < 0 || market->consumers < 0 || market->products < 0 || market->consumers > MARKET_MAX_SIZE ||
+        market->products > MARKET_MAX_SIZE) {
+        return -1;
+    }
+
+    int products = market->products;
+    int consumers = market->consumers;
+    int padded = (consumers + MARKET_LANES - 1) / MARKET_LANES * MARKET_LANES;
+    int threads = forecast_pool_threads(pool);
+    MarketJob job = {market, months};
+    job.tasks = (padded + MARKET_CONSUMERS_PER_TASK - 1) / MARKET_CONSUMERS_PER_TASK;
+
+    RankedProduct *order = malloc(((size_t)products + 1) * sizeof(RankedProduct));
+    double *sorted_quality = malloc(((size_t)products + 1) * sizeof(double));
+    int *consumer_reach = malloc(((size_t)consumers + 1) * sizeof(int));
+    int *bucket = calloc((size_t)products + 2, sizeof(int));
+    job.rank = malloc(((size_t)products + 1) * sizeof(int));
+    job.cheapest = malloc(((size_t)products + 1) * sizeof(double));
+    job.budget = calloc((size_t)padded + 1, sizeof(double));
+    job.reach = calloc((size_t)padded + 1, sizeof(int));
+    job.candidates = malloc((size_t)threads * ((size_t)products + 1) * sizeof(int));
+    job.monthly = calloc((size_t)threads * months * products + 1, sizeof(long long));
+    job.buyers = malloc(((size_t)job.tasks + 1) * sizeof(long long));
+    job.remaining = malloc(((size_t)job.tasks + 1) * sizeof(double));
+    result->months = months;
+    result->products = products;
+    result->sales = calloc((size_t)products + 1, sizeof(long long));
+    result->monthly_sales = calloc((size_t)months * products + 1, sizeof(long long));
+
+    int status = -1;
+    if (!order || !sorted_quality || !consumer_reach || !bucket || !job.rank || !job.cheapest || !job.budget ||
+        !job.reach || !job.candidates || !job.monthly || !job.buyers || !job.remaining || !result->sales ||
+        !result->monthly_sales) {
+        goto done;
+    }
+
+    for (int j = 0; j < products; j++) order[j] = (RankedProduct){market->quality[j], j};
+    qsort(order, products, sizeof(RankedProduct), compare_quality);
+    job.cheapest[0] = INFINITY;
+    for (int r = 0; r < products; r++) {
+        int j = order[r].id;
+        job.rank[j] = r;
+        sorted_quality[r] = market->quality[j];
+        job.cheapest[r + 1] = fmin(job.cheapest[r], market->price[j]);
+    }
+
+    // Reach by binary search, then a counting sort of the consumers by it.
+    for (int i = 0; i < consumers; i++) {
+        int low = 0;
+        int high = products;
+        while (low < high) {
+            int mid = (low + high) / 2;
+            if (sorted_quality[mid] <= market->preference[i]) low = mid + 1; else high = mid;
+        }
+        consumer_reach[i] = market->budget[i] >= job.cheapest[low] ? low : 0;
+        bucket[consumer_reach[i] + 1]++;
+    }
+    for (int k = 0; k < products; k++) bucket[k + 1] += bucket[k];
+    for (int i = 0; i < consumers; i++) {
+        int slot = bucket[consumer_reach[i]]++;
+        job.budget[slot] = market->budget[i];
+        job.reach[slot] = consumer_reach[i];
+    }
+    // Padding lanes past the last consumer keep reach 0 and budget 0.
+
+    forecast_pool_run(pool, job.tasks, run_market_task, &job);
+
+    for (int worker = 0; worker < threads; worker++) {
+        const long long *monthly = job.monthly + (size_t)worker * months * products;
+        for (size_t i = 0; i < (size_t)months * products; i++) {
+            result->monthly_sales[i] += monthly[i];
+        }
+    }
+    for (int month = 0; month < months; month++) {
+        for (int j = 0; j < products; j++) {
+            result->sales[j] += result->monthly_sales[(size_t)month * products + j];
+        }
+    }
+    for (int task = 0; task < job.tasks; task++) {
+        result->buyers += job.buyers[task];
+        result->remaining_budget += job.remaining[task];
+    }
+    status = 0;
+
+done:
+    free(order);
+    free(sorted_quality);
+    free(consumer_reach);
+    free(bucket);
+    free(job.rank);
+    free(job.cheapest);
+    free(job.budget);
+    free(job.reach);
+    free(job.candidates);
+    free(job.monthly);
+    free(job.buyers);
+    free(job.remaining);
+    if (status != 0) market_result_free(result);
+    return status;
+}
@@ -0,0 +1,59 @@
+#ifndef FORECAST_MARKET_H
+#define FORECAST_MARKET_H
+
+#include <stdint.h>
+
+#include "forecast_core.h"
+
+// Native twin of mksim.py's Market, sized for millions of consumers.
+// Every month each consumer walks the products in id order and buys each
+// one it can still afford whose quality does not exceed its preference,
+// paying from a budget that is never refilled. Consumers and products are
+// kept as structure-of-arrays.
+typedef struct {
+    int consumers;
+    double *budget;
+    double *preference;
+    int products;
+    double *price;
+    double *quality;
+} Market;
+
+// Most consumers or products a market may have, so counts padded to whole
+// lanes and tasks stay well inside int.
+#define MARKET_MAX_SIZE (1 << 30)
+
+// Returns 0 on success, -1 on a bad size (negative or above
+// MARKET_MAX_SIZE) or OOM.
+int market_alloc(Market *market, int consumers, int products);
+void market_free(Market *market);
+
+// Draws the market the way mksim.py's example does: budgets U(100, 500),
+// preferences U(0, 1), prices U(10, 50) and qualities U(0, 1), each a pure
+// function of (seed, consumer or product).
+void market_generate(Market *market, uint64_t seed);
+
+// A market as text: a line "consumers products", then "budget preference"
+// per consumer and "price quality" per product, in id order. Numbers are
+// written to 17 significant digits, so they read back exactly, here or with
+// Python's float(). Both return 0, or -1 on an I/O error or a bad file.
+int market_write(const Market *market, const char *path);
+int market_read(Market *market, const char *path);
+
+typedef struct {
+    int months;
+    int products;
+    long long *sales;           // per product over all months
+    long long *monthly_sales;   // [month * products + product]
+    long long buyers;           // consumers buying at least once
+    double remaining_budget;    // summed over consumers after the last month
+} MarketResult;
+
+// Simulates months months on pool (NULL runs on the calling thread). The
+// market is left untouched. Sales match Market.simulate bit for bit on the
+// same inputs: each consumer's budget sees the same subtractions in the same
+// order, and counts are exact whatever the thread count. 0 on success.
+int market_simulate(const Market *market, int months, ForecastPool *pool, MarketResult *result);
+void market_result_free(MarketResult *result);
+
+#endif
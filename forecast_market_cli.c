@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "forecast_core.h"
+#include "forecast_market.h"
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-c consumers] [-k products] [-m months] [-t threads] [-s seed] [-i market.txt] [-o market.txt] [-M]\n",
+            prog);
+}
+
+static double seconds_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+// Native run of mksim.py's example market at any size, or of a market read
+// with -i; prints the same per-product report as Market.report. -o writes
+// the market simulated, before it runs.
+int main(int argc, char **argv) {
+    int consumers = 100;
+    int products = 5;
+    int months = 12;
+    int threads = 0;
+    int monthly = 0;
+    unsigned long long seed = 0;
+    const char *input = NULL;
+    const char *output = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:k:m:t:s:i:o:Mh")) != -1) {
+        switch (opt) {
+        case 'c': consumers = atoi(optarg); break;
+        case 'k': products = atoi(optarg); break;
+        case 'm': months = atoi(optarg); break;
+        case 't': threads = atoi(optarg); break;
+        case 's': seed = strtoull(optarg, NULL, 0); break;
+        case 'i': input = optarg; break;
+        case 'o': output = optarg; break;
+        case 'M': monthly = 1; break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (consumers < 0 || products < 0 || months < 0 || consumers > MARKET_MAX_SIZE || products > MARKET_MAX_SIZE) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    Market market;
+    if (input) {
+        if (market_read(&market, input) != 0) {
+            fprintf(stderr, "cannot read a market from %s\n", input);
+            return 1;
+        }
+        consumers = market.consumers;
+        products = market.products;
+    } else if (market_alloc(&market, consumers, products) != 0) {
+        fprintf(stderr, "cannot allocate a market of %d consumers\n", consumers);
+        return 1;
+    } else {
+        market_generate(&market, seed);
+    }
+    if (output && market_write(&market, output) != 0) {
+        fprintf(stderr, "cannot write %s\n", output);
+        market_free(&market);
+        return 1;
+    }
+
+    ForecastPool *pool = forecast_pool_create(threads);
+    MarketResult result;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int status = market_simulate(&market, months, pool, &result);
+    double elapsed = seconds_since(&start);
+    if (status != 0) {
+        fprintf(stderr, "market simulation failed: out of memory\n");
+        market_free(&market);
+        forecast_pool_destroy(pool);
+        return 1;
+    }
+
+    for (int j = 0; j < products; j++) {
+        printf("Product %d sold %lld units\n", j, result.sales[j]);
+    }
+    if (monthly) {
+        for (int month = 0; month < months; month++) {
+            printf("Month %d:", month + 1);
+            for (int j = 0; j < products; j++) {
+                printf(" %lld", result.monthly_sales[(size_t)month * products + j]);
+            }
+            printf("\n");
+        }
+    }
+    fprintf(stderr, "%lld of %d consumers bought, $%.2f budget left; %d months in %.3f s on %d threads\n",
+            result.buyers, consumers, result.remaining_budget, months, elapsed, forecast_pool_threads(pool));
+
+    market_result_free(&result);
+    market_free(&market);
+    forecast_pool_destroy(pool);
+    return 0;
+}
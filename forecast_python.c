@@ -0,0 +1,374 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "forecast_core.h"
+#include "forecast_rules.h"
+
+// CPython extension `fcforecast` exposing the native engine to forecast.py.
+// Result arrays stay in the memory the engine filled: each is a small
+// buffer-protocol view of a Run that owns it, and numpy.asarray() wraps the
+// view without copying, so the Run lives as long as any array over it.
+
+// Owner of one run's memory.
+typedef struct {
+    PyObject_HEAD
+    ForecastResult result;
+    double *users;          // [month * iterations + path] with paths=True
+    double *profit;
+    int *break_even;
+} RunObject;
+
+static void run_dealloc(PyObject *self) {
+    RunObject *run = (RunObject *)self;
+    forecast_result_free(&run->result);
+    free(run->users);
+    free(run->profit);
+    free(run->break_even);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static PyTypeObject RunType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "fcforecast._Run",
+    .tp_basicsize = sizeof(RunObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = run_dealloc,
+    .tp_doc = "Memory of one forecast run.",
+};
+
+// One C-contiguous array of a Run.
+typedef struct {
+    PyObject_HEAD
+    PyObject *owner;
+    void *data;
+    char *format;
+    Py_ssize_t itemsize;
+    int ndim;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+} ArrayObject;
+
+static int array_getbuffer(PyObject *self, Py_buffer *view, int flags) {
+    ArrayObject *array = (ArrayObject *)self;
+    Py_ssize_t len = array->itemsize;
+    for (int i = 0; i < array->ndim; i++) {
+        len *= array->shape[i];
+    }
+    view->obj = self;
+    Py_INCREF(self);
+    view->buf = array->data;
+    view->len = len;
+    view->readonly = 0;
+    view->itemsize = array->itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? array->format : NULL;
+    view->ndim = array->ndim;
+    view->shape = (flags & PyBUF_ND) ? array->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? array->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static void array_dealloc(PyObject *self) {
+    Py_XDECREF(((ArrayObject *)self)->owner);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static PyBufferProcs array_buffer = {array_getbuffer, NULL};
+
+static PyTypeObject ArrayType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "fcforecast._Array",
+    .tp_basicsize = sizeof(ArrayObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = array_dealloc,
+    .tp_as_buffer = &array_buffer,
+    .tp_doc = "Buffer over one array of a forecast run.",
+};
+
+// dict[name] = numpy.asarray() over data, rows x columns (rows 0 for 1-D).
+static int put_array(PyObject *dict, PyObject *asarray, PyObject *owner, const char *name, void *data,
+                     char *format, Py_ssize_t itemsize, Py_ssize_t rows, Py_ssize_t columns) {
+    ArrayObject *array = PyObject_New(ArrayObject, &ArrayType);
+    if (!array) return -1;
+    Py_INCREF(owner);
+    array->owner = owner;
+    array->data = data;
+    array->format = format;
+    array->itemsize = itemsize;
+    array->ndim = rows > 0 ? 2 : 1;
+    array->shape[0] = rows > 0 ? rows : columns;
+    array->shape[1] = columns;
+    array->strides[0] = rows > 0 ? columns * itemsize : itemsize;
+    array->strides[1] = itemsize;
+    PyObject *value = PyObject_CallOneArg(asarray, (PyObject *)array);
+    Py_DECREF(array);
+    if (!value) return -1;
+    int status = PyDict_SetItemString(dict, name, value);
+    Py_DECREF(value);
+    return status;
+}
+
+static int put_double(PyObject *dict, const char *name, double value) {
+    PyObject *object = PyFloat_FromDouble(value);
+    if (!object) return -1;
+    int status = PyDict_SetItemString(dict, name, object);
+    Py_DECREF(object);
+    return status;
+}
+
+static int put_int(PyObject *dict, const char *name, long value) {
+    PyObject *object = PyLong_FromLong(value);
+    if (!object) return -1;
+    int status = PyDict_SetItemString(dict, name, object);
+    Py_DECREF(object);
+    return status;
+}
+
+// Pool shared by every call, rebuilt when another thread count is asked
+// for. The engine lock makes runs exclusive. It is only tried, never waited
+// for: a progress callback that starts another run (e.g. a GUI handling a
+// click while it redraws) would otherwise deadlock on it.
+static pthread_mutex_t engine_lock = PTHREAD_MUTEX_INITIALIZER;
+static ForecastPool *engine_pool;
+static int engine_threads = -1;
+
+// Called with engine_lock held.
+static ForecastPool *engine_pool_for(int threads) {
+    if (engine_threads != threads) {
+        forecast_pool_destroy(engine_pool);
+        engine_pool = forecast_pool_create(threads);
+        engine_threads = engine_pool ? threads : -1;
+    }
+    return engine_pool;
+}
+
+typedef struct {
+    PyObject *progress;
+    int iterations;
+    int failed;             // the callback raised
+} RunProgress;
+
+// Runs on the thread inside forecast_run(), which released the GIL.
+static int report_progress(void *ctx, const ForecastResult *partial) {
+    RunProgress *progress = ctx;
+    PyGILState_STATE gil = PyGILState_Ensure();
+    PyObject *reply = PyObject_CallFunction(progress->progress, "d", partial->iterations / (double)progress->iterations);
+    int cancel = reply ? PyObject_IsTrue(reply) : -1;
+    Py_XDECREF(reply);
+    if (cancel < 0) progress->failed = 1;
+    PyGILState_Release(gil);
+    return cancel != 0;
+}
+
+// Applies params, a mapping of ParameterSet field names to numbers.
+static int apply_params(ParameterSet *params, PyObject *mapping) {
+    PyObject *items = PyMapping_Items(mapping);
+    if (!items) return -1;
+    int status = 0;
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(items) && status == 0; i++) {
+        PyObject *item = PyList_GET_ITEM(items, i);
+        const char *name = PyUnicode_AsUTF8(PyTuple_GET_ITEM(item, 0));
+        const ParameterField *field = name ? parameter_field_find(name) : NULL;
+        if (!field) {
+            if (name) PyErr_Format(PyExc_KeyError, "unknown parameter '%s'", name);
+            status = -1;
+            break;
+        }
+        double value = PyFloat_AsDouble(PyTuple_GET_ITEM(item, 1));
+        if (value == -1.0 && PyErr_Occurred()) {
+            status = -1;
+            break;
+        }
+        parameter_set(params, field, value);
+    }
+    Py_DECREF(items);
+    return status;
+}
+
+static PyObject *build_result(RunObject *run, const ParameterSet *params, int threads) {
+    const ForecastResult *result = &run->result;
+    PyObject *numpy = PyImport_ImportModule("numpy");
+    if (!numpy) return NULL;
+    PyObject *asarray = PyObject_GetAttrString(numpy, "asarray");
+    Py_DECREF(numpy);
+    PyObject *dict = asarray ? PyDict_New() : NULL;
+    if (!dict) {
+        Py_XDECREF(asarray);
+        return NULL;
+    }
+
+    PyObject *owner = (PyObject *)run;
+    Py_ssize_t months = result->months;
+    Py_ssize_t iterations = result->iterations;
+    int status = put_int(dict, "months", result->months);
+    if (status == 0) status = put_int(dict, "iterations", result->iterations);
+    if (status == 0) status = put_int(dict, "threads", threads);
+    if (status == 0) status = put_double(dict, "step_months", parameter_step_months(params));
+#define PUT_SERIES(name) \
+    if (status == 0) status = put_array(dict, asarray, owner, #name, result->name, "d", sizeof(double), 0, months);
+    FORECAST_RESULT_SERIES(PUT_SERIES)
+#undef PUT_SERIES
+    if (status == 0) {
+        status = put_array(dict, asarray, owner, "break_even_histogram", result->break_even_histogram, "i",
+                           sizeof(int), 0, months);
+    }
+    if (status == 0) status = put_double(dict, "total_net_profit", result->total_net_profit);
+    if (status == 0) status = put_double(dict, "roi", result->roi);
+    if (status == 0) status = put_double(dict, "risk_of_no_return", result->risk_of_no_return);
+    if (status == 0) status = put_double(dict, "avg_break_even_month", result->avg_break_even_month);
+    if (status == 0) status = put_double(dict, "profit_std_error", result->profit_std_error);
+    if (status == 0) status = put_double(dict, "risk_std_error", result->risk_std_error);
+    if (status == 0 && run->users) {
+        status = put_array(dict, asarray, owner, "users", run->users, "d", sizeof(double), months, iterations);
+        if (status == 0) {
+            status = put_array(dict, asarray, owner, "cumulative_profit", run->profit, "d", sizeof(double), months,
+                               iterations);
+        }
+        if (status == 0) {
+            status = put_array(dict, asarray, owner, "break_even_month", run->break_even, "i", sizeof(int), 0,
+                               iterations);
+        }
+    }
+    Py_DECREF(asarray);
+    if (status != 0) {
+        Py_DECREF(dict);
+        return NULL;
+    }
+    return dict;
+}
+
+PyDoc_STRVAR(run_doc,
+"run(params=None, *, preset=0, seed=0, threads=0, paths=False, rules=None, progress=None)\n"
+"--\n\n"
+"Runs the native Monte Carlo forecast. params maps ParameterSet field names\n"
+"to values overriding the preset; rules is the text of a finance rules model\n"
+"(see forecast_rules.h). progress(fraction) is called between rounds of\n"
+"paths and cancels the run by returning true. threads <= 0 uses every CPU.\n"
+"Raises RuntimeError if another run is in progress, including from progress.\n\n"
+"Returns None if cancelled, else a dict of scalars and NumPy arrays over the\n"
+"engine's own memory: the per-month series of ForecastResult, the\n"
+"break_even_histogram and, with paths=True, users and cumulative_profit of\n"
+"shape (months, iterations) and each path's break_even_month (-1 if never).");
+
+static PyObject *fcforecast_run(PyObject *module, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"params", "preset", "seed", "threads", "paths", "rules", "progress", NULL};
+    PyObject *mapping = Py_None, *progress_fn = Py_None;
+    int preset = 0, threads = 0, want_paths = 0;
+    unsigned long long seed = 0;
+    const char *rules_text = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O$iKipzO", keywords, &mapping, &preset, &seed, &threads,
+                                     &want_paths, &rules_text, &progress_fn)) {
+        return NULL;
+    }
+    if (preset < 0 || preset >= parameter_set_count) {
+        return PyErr_Format(PyExc_ValueError, "preset must be in [0, %d)", parameter_set_count);
+    }
+    if (progress_fn != Py_None && !PyCallable_Check(progress_fn)) {
+        return PyErr_Format(PyExc_TypeError, "progress must be callable");
+    }
+    ParameterSet params = parameter_sets[preset];
+    if (mapping != Py_None && apply_params(&params, mapping) != 0) {
+        return NULL;
+    }
+
+    ForecastRules *rules = NULL;
+    if (rules_text) {
+        char error[256];
+        if (!(rules = forecast_rules_compile(rules_text, error, sizeof(error)))) {
+            return PyErr_Format(PyExc_ValueError, "rules: %s", error);
+        }
+    }
+    if (pthread_mutex_trylock(&engine_lock) != 0) {
+        forecast_rules_free(rules);
+        PyErr_SetString(PyExc_RuntimeError, "engine busy");
+        return NULL;
+    }
+    RunObject *run = PyObject_New(RunObject, &RunType);
+    if (!run) {
+        pthread_mutex_unlock(&engine_lock);
+        forecast_rules_free(rules);
+        return NULL;
+    }
+    memset(&run->result, 0, sizeof(run->result));
+    run->users = run->profit = NULL;
+    run->break_even = NULL;
+
+    RunProgress progress = {progress_fn, params.iterations, 0};
+    int status, pool_threads = 0;
+    Py_BEGIN_ALLOW_THREADS
+    ForecastPool *pool = engine_pool_for(threads);
+    ForecastOptions options = {pool, seed};
+    if (progress_fn != Py_None) {
+        options.progress = report_progress;
+        options.progress_ctx = &progress;
+    }
+    options.rules = rules;
+    status = pool ? forecast_run(&params, &options, &run->result) : -1;
+    if (status == 0 && want_paths) {
+        // The paths the run used, which adaptive runs may stop short of
+        // params.iterations.
+        size_t cells = (size_t)run->result.months * run->result.iterations;
+        run->users = malloc(cells * sizeof(double));
+        run->profit = malloc(cells * sizeof(double));
+        run->break_even = malloc((size_t)run->result.iterations * sizeof(int));
+        status = run->users && run->profit && run->break_even
+                     ? forecast_simulate_paths(&params, &options, 0, run->result.iterations, run->users,
+                                               run->profit, run->break_even)
+                     : -1;
+    }
+    pool_threads = forecast_pool_threads(pool);
+    pthread_mutex_unlock(&engine_lock);
+    Py_END_ALLOW_THREADS
+    forecast_rules_free(rules);
+
+    PyObject *value = NULL;
+    if (progress.failed) {
+        // The callback's exception is already set.
+    } else if (status == FORECAST_CANCELLED) {
+        value = Py_None;
+        Py_INCREF(value);
+    } else if (status != 0) {
+        PyErr_SetString(PyExc_ValueError, "forecast failed: invalid parameters or out of memory");
+    } else {
+        value = build_result(run, &params, pool_threads);
+    }
+    Py_DECREF(run);
+    return value;
+}
+
+static PyMethodDef fcforecast_methods[] = {
+    {"run", (PyCFunction)(void (*)(void))fcforecast_run, METH_VARARGS | METH_KEYWORDS, run_doc},
+    {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef fcforecast_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "fcforecast",
+    .m_doc = "Native Monte Carlo forecast engine.",
+    .m_size = -1,
+    .m_methods = fcforecast_methods,
+};
+
+PyMODINIT_FUNC PyInit_fcforecast(void) {
+    if (PyType_Ready(&RunType) < 0 || PyType_Ready(&ArrayType) < 0) {
+        return NULL;
+    }
+    PyObject *module = PyModule_Create(&fcforecast_module);
+    if (!module) return NULL;
+
+    // Preset names, indexable by run()'s preset argument.
+    PyObject *names = PyTuple_New(parameter_set_count);
+    for (int i = 0; names && i < parameter_set_count; i++) {
+        PyTuple_SET_ITEM(names, i, PyUnicode_FromString(parameter_set_names[i]));
+    }
+    if (!names || PyModule_AddObject(module, "presets", names) < 0) {
+        Py_XDECREF(names);
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
+}
@@ -1,164 +1,307 @@
 #include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "raylib.h"
 
 #define RAYGUI_IMPLEMENTATION
 #include "raygui.h"
 
-#define MAX_MONTHS 36
+#include "forecast_async.h"
+#include "forecast_cache.h"
+#include "forecast_chart.h"
+#include "forecast_core.h"
+#include "forecast_store.h"
+#include "forecast_trace.h"
+
+// Ten years of daily steps; the chart decimates whatever the horizon.
+#define MAX_STEPS 3650
 #define MAX_ITERATIONS 100
+// Paths of a "Run Forecast" refinement; the sliders' iterations only drive
+// the live preview.
+#define RUN_ITERATIONS 100000
+#define TRACE_FILE "forecast_trace.json"
+#define STORE_FILE "forecast.fcr"
+
+#define CHART_X 300
+#define CHART_Y 50
+#define CHART_WIDTH 800
+#define CHART_HEIGHT 400
 
-typedef struct {
-    float initial_investment;
-    float colocation_expense;
-    float marketing_expense;
-    int months;
-    float price_per_gb;
-    float avg_gb_per_user;
-    int initial_users;
-    int initial_companies;
-    int min_employees_per_company;
-    int max_employees_per_company;
-    float mean_company_size;
-    float acquisition_rate;
-    float initial_storage;
-    float cost_per_gb;
-    int iterations;
-} Parameters;
-
-Parameters parameter_sets[] = {
-    {2770, 100, 50, 36, 0.12, 5, 0, 1, 5, 200, 20, 0.5, 8000, 0.08, 100},
-    {0, 200, 50, 36, 0.12, 5, 0, 1, 5, 200, 20, 0.5, 200, 0.02, 100}
-};
-
-const char *parameter_set_names[] = {"Physical Server/Co-location", "Cloud Server/S3"};
 int selected_set = 0;
-Parameters params;
+ParameterSet params;
+ForecastPool *forecast_pool;
+ForecastCache *forecast_cache;
+ForecastAsync *forecast_async;
 
 void UpdateParameters() {
     params = parameter_sets[selected_set];
 }
 
-float company_growth[MAX_MONTHS];
-float user_growth[MAX_MONTHS];
-float monthly_storage_usage[MAX_MONTHS];
-float monthly_revenue[MAX_MONTHS];
-float monthly_net_profit[MAX_MONTHS];
-float cumulative_profit[MAX_MONTHS];
-
-void RunForecast() {
-    float company_growth[MAX_MONTHS] = {params.initial_companies};
-    float user_growth[MAX_MONTHS] = {params.initial_users};
-    float monthly_storage_usage[MAX_MONTHS];
-    float monthly_revenue[MAX_MONTHS];
-    float monthly_net_profit[MAX_MONTHS];
-    float cumulative_profit[MAX_MONTHS];
-    float total_monthly_expense = params.colocation_expense + params.marketing_expense;
-    float one_time_extra_usage_cost = 0;
-    bool extra_usage_applied = false;
-
-    for (int month = 1; month < params.months; month++) {
-        float new_companies = company_growth[month - 1] * params.acquisition_rate * exp(-company_growth[month - 1] / 10);
-        company_growth[month] = company_growth[month - 1] + new_companies;
-
-        float weights[params.max_employees_per_company - params.min_employees_per_company + 1];
-        float sum_weights = 0;
-        for (int i = 0; i < params.max_employees_per_company - params.min_employees_per_company + 1; i++) {
-            weights[i] = exp(-(params.min_employees_per_company + i) / params.mean_company_size);
-            sum_weights += weights[i];
-        }
+// Step units of the toggle group and their step_days.
+const char *step_unit_labels = "Month;Week;Day";
+const int step_unit_days[] = {0, 7, 1};
+int step_unit = 0;
+
+// Per-step series of the shown result, grown with the horizon.
+float *company_growth;
+float *user_growth;
+float *monthly_storage_usage;
+float *monthly_revenue;
+float *monthly_net_profit;
+float *cumulative_profit;
+int series_capacity = 0;
+int series_steps = 0;   // steps filled by the last ShowResult()
+
+// Chart geometry in texture coordinates, decimated to the chart width and
+// rebuilt only by ShowResult(); the texture is redrawn from it when
+// chart_version moves, and every other frame just blits it.
+ChartPoint profit_line[2 * CHART_WIDTH];
+ChartPoint profit_band[2 * CHART_WIDTH];
+ChartPoint storage_line[2 * CHART_WIDTH];
+ChartPoint users_line[2 * CHART_WIDTH];
+int profit_line_count, profit_band_count, storage_line_count, users_line_count;
+unsigned chart_version = 1;
+unsigned drawn_version = 0;
+RenderTexture2D chart_texture;
+
+// Set while a background run refines the chart for the current parameters;
+// cleared by Cancel. Any slider edit meanwhile supersedes the run.
+int refining = 0;
+ParameterSet refined_params;
+ForecastResult refined_result;
+ForecastAsyncStatus refine_status;
+
+// A result file dropped on the window is shown straight from its mapping
+// until a slider moves. The sliders clamp the stored parameters to their
+// ranges on the first frame, so that frame's values are the reference.
+ForecastStore store;
+int viewing_store = 0;
+int store_just_opened = 0;
+ParameterSet viewed_params;
+const char *store_message = "";
+
+// Profit is centred on the x-axis, scaled to its largest magnitude
+// including the P5-P95 band; storage and users rise from the bottom.
+static void BuildChart(const ForecastResult *result, int months) {
+    double low = 0, high = 0;
+    chart_range(result->avg_cumulative_profit, months, &low, &high);
+    chart_range(result->p5_cumulative_profit, months, &low, &high);
+    chart_range(result->p95_cumulative_profit, months, &low, &high);
+    double reach = fmax(fabs(low), fabs(high));
+    ChartMapping map = {0, 0, CHART_WIDTH, CHART_HEIGHT, months, -reach, reach};
+    profit_line_count = chart_polyline(result->avg_cumulative_profit, &map, profit_line, 2 * CHART_WIDTH);
+    profit_band_count = chart_band(result->p5_cumulative_profit, result->p95_cumulative_profit, &map, profit_band,
+                                   2 * CHART_WIDTH);
+
+    map.min = 0;
+    map.max = 0;
+    chart_range(result->avg_monthly_storage_usage, months, &map.min, &map.max);
+    storage_line_count = chart_polyline(result->avg_monthly_storage_usage, &map, storage_line, 2 * CHART_WIDTH);
+    map.max = 0;
+    chart_range(result->avg_user_growth, months, &map.min, &map.max);
+    users_line_count = chart_polyline(result->avg_user_growth, &map, users_line, 2 * CHART_WIDTH);
+    chart_version++;
+}
 
-        float new_users = 0;
-        for (int i = 0; i < new_companies; i++) {
-            float rand_val = (float)rand() / RAND_MAX;
-            float cumulative_weight = 0;
-            for (int j = 0; j < params.max_employees_per_company - params.min_employees_per_company + 1; j++) {
-                cumulative_weight += weights[j] / sum_weights;
-                if (rand_val <= cumulative_weight) {
-                    new_users += params.min_employees_per_company + j;
-                    break;
-                }
-            }
-        }
-        user_growth[month] = user_growth[month - 1] + new_users;
+static int ReserveSeries(int months) {
+    if (months <= series_capacity) return 0;
+    float **series[] = {&company_growth, &user_growth, &monthly_storage_usage,
+                        &monthly_revenue, &monthly_net_profit, &cumulative_profit};
+    for (int i = 0; i < 6; i++) {
+        float *grown = realloc(*series[i], months * sizeof(float));
+        if (!grown) return -1;
+        *series[i] = grown;
     }
+    series_capacity = months;
+    return 0;
+}
 
-    for (int month = 0; month < params.months; month++) {
-        monthly_storage_usage[month] = user_growth[month] * params.avg_gb_per_user;
-        monthly_revenue[month] = monthly_storage_usage[month] * params.price_per_gb;
-
-        if (monthly_storage_usage[month] > params.initial_storage && !extra_usage_applied) {
-            float extra_usage = monthly_storage_usage[month] - params.initial_storage;
-            one_time_extra_usage_cost += extra_usage * params.cost_per_gb;
-            extra_usage_applied = true;
-        }
+static void FreeSeries() {
+    free(company_growth);
+    free(user_growth);
+    free(monthly_storage_usage);
+    free(monthly_revenue);
+    free(monthly_net_profit);
+    free(cumulative_profit);
+}
 
+// Revenue and expenses are per step, like the engine's. A result may be
+// shorter than the Steps slider, e.g. a stored one, so the series cover the
+// steps both have; params, which the sliders edit, stay untouched.
+static void ShowResult(const ForecastResult *result) {
+    float step = parameter_step_months(&params);
+    float total_monthly_expense = (params.colocation_expense + params.marketing_expense) * step;
+    int steps = params.months < result->months ? params.months : result->months;
+    if (ReserveSeries(steps) != 0) return;
+
+    for (int month = 0; month < steps; month++) {
+        company_growth[month] = result->company_growth[month];
+        user_growth[month] = result->avg_user_growth[month];
+        monthly_storage_usage[month] = result->avg_monthly_storage_usage[month];
+        monthly_revenue[month] = monthly_storage_usage[month] * params.price_per_gb * step;
         monthly_net_profit[month] = monthly_revenue[month] - total_monthly_expense;
-        cumulative_profit[month] = (month == 0 ? 0 : cumulative_profit[month - 1]) + monthly_net_profit[month];
-        if (month == 0) {
-            cumulative_profit[month] -= params.initial_investment + one_time_extra_usage_cost;
-        }
+        cumulative_profit[month] = result->avg_cumulative_profit[month];
     }
+    series_steps = steps;
+    BuildChart(result, steps);
+}
 
+void PrintForecast() {
     // Display results (placeholder)
-    for (int month = 0; month < params.months; month++) {
-        printf("Month %d: Companies: %.2f, Users: %.2f, Storage Usage: %.2f GB, Revenue: $%.2f, Net Profit: $%.2f, Cumulative Profit: $%.2f\n",
+    for (int month = 0; month < series_steps; month++) {
+        printf("Step %d: Companies: %.2f, Users: %.2f, Storage Usage: %.2f GB, Revenue: $%.2f, Net Profit: $%.2f, Cumulative Profit: $%.2f\n",
                month + 1, company_growth[month], user_growth[month], monthly_storage_usage[month], monthly_revenue[month], monthly_net_profit[month], cumulative_profit[month]);
     }
 }
 
-void DrawChart() {
-    int chartWidth = 800;
-    int chartHeight = 400;
-    int chartX = 300;
-    int chartY = 50;
-    int maxMonths = params.months;
-    float maxProfit = cumulative_profit[0];
-    float minProfit = cumulative_profit[0];
-    float maxStorage = monthly_storage_usage[0];
-    float maxUsers = user_growth[0];
-
-    for (int i = 1; i < maxMonths; i++) {
-        if (cumulative_profit[i] > maxProfit) maxProfit = cumulative_profit[i];
-        if (cumulative_profit[i] < minProfit) minProfit = cumulative_profit[i];
-        if (monthly_storage_usage[i] > maxStorage) maxStorage = monthly_storage_usage[i];
-        if (user_growth[i] > maxUsers) maxUsers = user_growth[i];
+// Called every frame: the cache reruns only the stages the slider edits
+// since the last frame invalidated, and nothing when no slider moved. A
+// background refinement takes over the chart once its first batch is in.
+void UpdateForecast() {
+    if (viewing_store) {
+        if (store_just_opened) {
+            viewed_params = params;
+            store_just_opened = 0;
+        }
+        if (memcmp(&viewed_params, &params, sizeof(params)) == 0) {
+            return;
+        }
+        viewing_store = 0;
+        forecast_store_close(&store);
     }
+    if (refining && memcmp(&refined_params, &params, sizeof(params)) != 0) {
+        ParameterSet run = params;
+        run.iterations = RUN_ITERATIONS;
+        forecast_async_submit(forecast_async, &run, 0);
+        refined_params = params;
+    }
+
+    const ForecastResult *result = forecast_cache_update(forecast_cache, &params, 0);
+    if (result && forecast_cache_last_stages(forecast_cache) != 0) {
+        ShowResult(result);
+    }
+    if (refining && forecast_async_poll(forecast_async, &refined_result, &refine_status)) {
+        ShowResult(&refined_result);
+        if (refine_status.state == FORECAST_ASYNC_DONE) {
+            PrintForecast();
+        }
+    }
+}
 
-    DrawRectangle(chartX, chartY, chartWidth, chartHeight, LIGHTGRAY);
-    DrawLine(chartX, chartY + chartHeight / 2, chartX + chartWidth, chartY + chartHeight / 2, DARKGRAY); // X-axis
+void RunForecast() {
+    refining = 1;
+    memset(&refined_params, 0, sizeof(refined_params));
+}
+
+void CancelForecast() {
+    refining = 0;
+    forecast_async_cancel(forecast_async);
+}
 
-    for (int i = 0; i < maxMonths - 1; i++) {
-        int x1 = chartX + (i * chartWidth / maxMonths);
-        int x2 = chartX + ((i + 1) * chartWidth / maxMonths);
+// Shows the first .fcr file dropped on the window; only the header and the
+// aggregates the chart reads are paged in.
+void OpenDroppedStore() {
+    FilePathList dropped = LoadDroppedFiles();
+    if (dropped.count > 0) {
+        CancelForecast();
+        if (viewing_store) forecast_store_close(&store);
+        viewing_store = forecast_store_open(&store, dropped.paths[0]) == 0 && store.result.months <= MAX_STEPS;
+        if (viewing_store) {
+            params = store.params;
+            for (int i = 0; i < 3; i++) {
+                if (step_unit_days[i] == params.step_days) step_unit = i;
+            }
+            ShowResult(&store.result);
+            store_just_opened = 1;
+            store_message = "";
+        } else {
+            forecast_store_close(&store);
+            store_message = "Not a forecast result file";
+        }
+    }
+    UnloadDroppedFiles(dropped);
+}
 
-        int y1_profit = chartY + chartHeight / 2 - (cumulative_profit[i] * chartHeight / (2 * maxProfit));
-        int y2_profit = chartY + chartHeight / 2 - (cumulative_profit[i + 1] * chartHeight / (2 * maxProfit));
-        DrawLine(x1, y1_profit, x2, y2_profit, BLUE);
+void SaveForecast() {
+    ParameterSet run = refined_params;
+    run.iterations = RUN_ITERATIONS;
+    ForecastOptions options = {forecast_pool, 0};
+    store_message = forecast_store_write(STORE_FILE, &run, &options, &refined_result, 0) == 0
+        ? "Saved " STORE_FILE : "Cannot write " STORE_FILE;
+}
 
-        int y1_storage = chartY + chartHeight - (monthly_storage_usage[i] * chartHeight / maxStorage);
-        int y2_storage = chartY + chartHeight - (monthly_storage_usage[i + 1] * chartHeight / maxStorage);
-        DrawLine(x1, y1_storage, x2, y2_storage, GREEN);
+// F3 toggles stage timing and its overlay; F4 writes the events since the
+// last dump to TRACE_FILE for chrome://tracing.
+int show_trace = 0;
+TraceOverlay trace_overlay;
+const char *trace_message = "";
+
+void UpdateTrace() {
+    if (IsKeyPressed(KEY_F3)) {
+        show_trace = !show_trace;
+        trace_enable(show_trace);
+        memset(&trace_overlay, 0, sizeof(trace_overlay));
+    }
+    if (IsKeyPressed(KEY_F4) && trace_enabled()) {
+        trace_message = trace_write_chrome(TRACE_FILE) == 0 ? "Wrote " TRACE_FILE : "Cannot write " TRACE_FILE;
+    }
+    if (show_trace) {
+        trace_overlay_update(&trace_overlay);
+    }
+}
 
-        int y1_users = chartY + chartHeight - (user_growth[i] * chartHeight / maxUsers);
-        int y2_users = chartY + chartHeight - (user_growth[i + 1] * chartHeight / maxUsers);
-        DrawLine(x1, y1_users, x2, y2_users, RED);
+void DrawTraceOverlay() {
+    int x = 940;
+    int y = 500;
+    DrawRectangle(x - 10, y - 10, 250, 40 + 18 * (TRACE_STAGE_COUNT + 1), Fade(BLACK, 0.7f));
+    DrawText(TextFormat("%.0f fps, %.0f paths/s", trace_overlay.fps, trace_overlay.paths_per_second), x, y, 10, WHITE);
+    for (int stage = 0; stage < TRACE_STAGE_COUNT; stage++) {
+        // render includes the wait for the target frame rate
+        DrawText(TextFormat("%-10s %8.2f ms/frame", trace_stage_names[stage], trace_overlay.ms_per_frame[stage]),
+                 x, y + 18 * (stage + 1), 10, WHITE);
     }
+    DrawText(TextFormat("F4: dump trace  %s", trace_message), x, y + 18 * (TRACE_STAGE_COUNT + 1), 10, LIGHTGRAY);
+}
+
+static void RedrawChartTexture() {
+    BeginTextureMode(chart_texture);
+    ClearBackground(LIGHTGRAY);
+    DrawLine(0, CHART_HEIGHT / 2, CHART_WIDTH, CHART_HEIGHT / 2, DARKGRAY); // X-axis
+    DrawTriangleStrip((Vector2 *)profit_band, profit_band_count, Fade(SKYBLUE, 0.6f));
+    DrawLineStrip((Vector2 *)profit_line, profit_line_count, BLUE);
+    DrawLineStrip((Vector2 *)storage_line, storage_line_count, GREEN);
+    DrawLineStrip((Vector2 *)users_line, users_line_count, RED);
+
+    DrawText("Cumulative Profit", 10, 10, 10, BLUE);
+    DrawText("Monthly Storage Usage", 10, 30, 10, GREEN);
+    DrawText("User Growth", 10, 50, 10, RED);
+    DrawText("Cumulative Profit P5-P95", 10, 70, 10, SKYBLUE);
+    EndTextureMode();
+    drawn_version = chart_version;
+}
 
-    DrawText("Cumulative Profit", chartX + 10, chartY + 10, 10, BLUE);
-    DrawText("Monthly Storage Usage", chartX + 10, chartY + 30, 10, GREEN);
-    DrawText("User Growth", chartX + 10, chartY + 50, 10, RED);
+void DrawChart() {
+    if (drawn_version != chart_version) {
+        RedrawChartTexture();
+    }
+    // Render textures are stored bottom-up, hence the negative height.
+    DrawTextureRec(chart_texture.texture, (Rectangle){0, 0, CHART_WIDTH, -CHART_HEIGHT}, (Vector2){CHART_X, CHART_Y}, WHITE);
 }
 
 int main(void) {
     InitWindow(1200, 800, "Forecast Application");
     SetTargetFPS(60);
+    chart_texture = LoadRenderTexture(CHART_WIDTH, CHART_HEIGHT);
 
     UpdateParameters();
+    forecast_pool = forecast_pool_create(0);
+    forecast_cache = forecast_cache_create(forecast_pool);
+    forecast_async = forecast_async_create(0);
 
     while (!WindowShouldClose()) {
+        TRACE_BEGIN(draw_start);
         BeginDrawing();
         ClearBackground(RAYWHITE);
 
@@ -166,11 +309,13 @@ int main(void) {
         if (GuiDropdownBox((Rectangle){230, 20, 200, 20}, "Physical Server/Co-location;Cloud Server/S3", &selected_set, false)) {
             UpdateParameters();
         }
+        step_unit = GuiToggleGroup((Rectangle){460, 20, 60, 20}, step_unit_labels, step_unit);
+        params.step_days = step_unit_days[step_unit];
 
         params.initial_investment = GuiSlider((Rectangle){20, 60, 200, 20}, "Initial Investment", TextFormat("%.2f", params.initial_investment), params.initial_investment, 0, 10000);
         params.colocation_expense = GuiSlider((Rectangle){20, 100, 200, 20}, "Colocation Expense", TextFormat("%.2f", params.colocation_expense), params.colocation_expense, 0, 1000);
         params.marketing_expense = GuiSlider((Rectangle){20, 140, 200, 20}, "Marketing Expense", TextFormat("%.2f", params.marketing_expense), params.marketing_expense, 0, 1000);
-        params.months = GuiSlider((Rectangle){20, 180, 200, 20}, "Months", TextFormat("%d", params.months), params.months, 1, MAX_MONTHS);
+        params.months = GuiSlider((Rectangle){20, 180, 200, 20}, "Steps", TextFormat("%d", params.months), params.months, 1, MAX_STEPS);
         params.price_per_gb = GuiSlider((Rectangle){20, 220, 200, 20}, "Price per GB", TextFormat("%.2f", params.price_per_gb), params.price_per_gb, 0, 1);
         params.avg_gb_per_user = GuiSlider((Rectangle){20, 260, 200, 20}, "Average GB per User", TextFormat("%.2f", params.avg_gb_per_user), params.avg_gb_per_user, 0, 100);
         params.initial_users = GuiSlider((Rectangle){20, 300, 200, 20}, "Initial Users", TextFormat("%d", params.initial_users), params.initial_users, 0, 1000);
@@ -186,12 +331,45 @@ int main(void) {
         if (GuiButton((Rectangle){20, 660, 200, 30}, "Run Forecast")) {
             RunForecast();
         }
+        if (IsFileDropped()) {
+            OpenDroppedStore();
+        }
+        if (refining && refine_status.state == FORECAST_ASYNC_DONE) {
+            if (GuiButton((Rectangle){20, 700, 200, 30}, "Save Result")) {
+                SaveForecast();
+            }
+        }
+        DrawText(viewing_store ? TextFormat("Showing stored run (%d paths)", store.result.iterations) : store_message,
+                 20, 740, 10, DARKGRAY);
+        if (refining && refine_status.state != FORECAST_ASYNC_DONE) {
+            if (GuiButton((Rectangle){20, 700, 200, 30}, "Cancel")) {
+                CancelForecast();
+            }
+            GuiProgressBar((Rectangle){300, 460, 800, 20}, NULL,
+                           TextFormat("%d / %d paths", refine_status.paths_done, refine_status.paths_total),
+                           refine_status.paths_done, 0, refine_status.paths_total > 0 ? refine_status.paths_total : 1);
+        }
 
+        UpdateForecast();
         DrawChart();
+        UpdateTrace();
+        if (show_trace) {
+            DrawTraceOverlay();
+        }
+        TRACE_END(TRACE_DRAW, draw_start);
 
+        TRACE_BEGIN(render_start);
         EndDrawing();
+        TRACE_END(TRACE_RENDER, render_start);
     }
 
+    forecast_async_destroy(forecast_async);
+    if (viewing_store) forecast_store_close(&store);
+    forecast_result_free(&refined_result);
+    forecast_cache_destroy(forecast_cache);
+    forecast_pool_destroy(forecast_pool);
+    FreeSeries();
+    UnloadRenderTexture(chart_texture);
     CloseWindow();
     return 0;
 }
@@ -0,0 +1,138 @@
+#ifndef FORECAST_RNG_H
+#define FORECAST_RNG_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Threefry-2x64-20 counter-based generator (Salmon et al., SC'11). The key
+// is the run seed and the counter is (path, month << 32 | block), so the
+// k-th uniform of any path in any month is a pure function of
+// (seed, path, month, k): no stream state to split, jump or hand between
+// threads. Threefry is add/rotate/xor only, which lets the vector kernel
+// evaluate the same rounds lane-parallel on any ISA.
+#define THREEFRY_PARITY 0x1BD11BDAA9FC1A22ull
+#define THREEFRY_ROUNDS 20
+#define PATH_RNG_ONE 0x3FF0000000000000ull
+
+static const int threefry_rotations[8] = {16, 42, 12, 31, 16, 32, 24, 21};
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline void threefry2x64(uint64_t x[2], uint64_t k0, uint64_t k1) {
+    uint64_t ks[3] = {k0, k1, THREEFRY_PARITY ^ k0 ^ k1};
+    uint64_t x0 = x[0] + ks[0];
+    uint64_t x1 = x[1] + ks[1];
+#pragma GCC unroll 20
+    for (int round = 0; round < THREEFRY_ROUNDS; round++) {
+        x0 += x1;
+        x1 = rotl64(x1, threefry_rotations[round % 8]);
+        x1 ^= x0;
+        if (round % 4 == 3) {
+            int i = (round + 1) / 4;
+            x0 += ks[i % 3];
+            x1 += ks[(i + 1) % 3] + i;
+        }
+    }
+    x[0] = x0;
+    x[1] = x1;
+}
+
+// Uniform in [0, 1) keeping 52 of 64 random bits, built by exponent
+// stuffing so vector code can reproduce it exactly.
+static inline double rng_bits_to_uniform(uint64_t bits) {
+    uint64_t z = (bits >> 12) | PATH_RNG_ONE;
+    double u;
+    memcpy(&u, &z, sizeof(u));
+    return u - 1.0;
+}
+
+// Uniforms 2 * block and 2 * block + 1 of (seed, path, month).
+static inline void rng_block(uint64_t seed, uint64_t path, uint32_t month, uint32_t block, double out[2]) {
+    uint64_t x[2] = {path, ((uint64_t)month << 32) | block};
+    threefry2x64(x, seed, 0);
+    out[0] = rng_bits_to_uniform(x[0]);
+    out[1] = rng_bits_to_uniform(x[1]);
+}
+
+// Bulk form: the first n uniforms of (seed, path, month).
+static inline void rng_fill(uint64_t seed, uint64_t path, uint32_t month, double *out, int n) {
+    for (int i = 0; i + 1 < n; i += 2) {
+        rng_block(seed, path, month, i / 2, out + i);
+    }
+    if (n & 1) {
+        double pair[2];
+        rng_block(seed, path, month, n / 2, pair);
+        out[n - 1] = pair[0];
+    }
+}
+
+// Antithetic sampling pairs path 2k + 1 with path 2k: it draws from the
+// even path's counters, with its bits XORed by these masks. A per-company
+// draw u becomes 1 - u (to within 2^-52). The Box-Muller pair keeps its
+// radius and turns its angle half a circle, which negates the normal
+// deviate.
+#define RNG_MIRROR (~0ull)
+#define RNG_HALF_TURN (1ull << 63)
+
+// Counter path of the per-dimension Sobol seeds of replicate 0, beyond
+// any real path; replicate r counts down from it.
+#define RNG_SOBOL_PATH (~0ull)
+
+// A Sobol run deals its paths to RNG_SOBOL_REPLICATES independently
+// scrambled copies of the sequence, in blocks of RNG_SOBOL_BLOCK: block b
+// is block b / R of replicate b % R. The first R * 2^k blocks give every
+// replicate an aligned power-of-two run of its own sequence, and the
+// replicate means are independent, so their spread gives the standard
+// error that the correlated points of one sequence cannot. Macros so the
+// vector kernel maps its lanes the same way.
+#define RNG_SOBOL_BLOCK 256
+#define RNG_SOBOL_REPLICATES 16
+#define RNG_SOBOL_REPLICATE(path) ((path) / RNG_SOBOL_BLOCK % RNG_SOBOL_REPLICATES)
+#define RNG_SOBOL_INDEX(path) \
+    ((path) / (RNG_SOBOL_BLOCK * RNG_SOBOL_REPLICATES) * RNG_SOBOL_BLOCK + (path) % RNG_SOBOL_BLOCK)
+
+// Bit reversal of the low 32 bits of x. Macros so the vector kernel
+// applies the same steps lane-wise; only the low 32 bits of a result are
+// meaningful.
+#define RNG_REVERSE32(x) ({                                                 \
+        __typeof__(x) r_ = (x) & 0xFFFFFFFFull;                             \
+        r_ = ((r_ >> 1) & 0x55555555ull) | ((r_ & 0x55555555ull) << 1);     \
+        r_ = ((r_ >> 2) & 0x33333333ull) | ((r_ & 0x33333333ull) << 2);     \
+        r_ = ((r_ >> 4) & 0x0F0F0F0Full) | ((r_ & 0x0F0F0F0Full) << 4);     \
+        r_ = ((r_ >> 8) & 0x00FF00FFull) | ((r_ & 0x00FF00FFull) << 8);     \
+        ((r_ >> 16) & 0xFFFFull) | ((r_ & 0xFFFFull) << 16); })
+
+// Laine-Karras hash with Burley's constants: a random permutation of
+// 32-bit values in which each bit depends only on the bits below it.
+#define RNG_LAINE_KARRAS(x, seed) ({                                        \
+        __typeof__(x) h_ = (x);                                             \
+        h_ ^= h_ * 0x3D20ADEAull;                                           \
+        h_ += (seed) & 0xFFFFFFFFull;                                       \
+        h_ *= (((seed) >> 16) & 0xFFFFull) | 1;                             \
+        h_ ^= h_ * 0x05526C56ull;                                           \
+        h_ ^= h_ * 0x53A22864ull;                                           \
+        h_; })
+
+// Point `index` of one padded dimension of an Owen-scrambled Sobol
+// sequence (Burley, "Practical Hash-based Owen Scrambling", JCGT 2020):
+// the index is shuffled by a nested uniform scramble, mapped through
+// Sobol's first dimension (a bit reversal) and scrambled again.
+// dimension_seed holds the shuffle seed in its low half and the value
+// scramble in its high half. Every aligned power-of-two run of indices
+// stratifies the dimension. Returns 32 bits.
+#define RNG_SOBOL(index, dimension_seed) ({                                 \
+        __typeof__(index) s_ = RNG_LAINE_KARRAS(RNG_REVERSE32(index), (dimension_seed)); \
+        RNG_REVERSE32(RNG_LAINE_KARRAS(RNG_REVERSE32(s_), (dimension_seed) >> 32)); })
+
+// Seeds of the two Sobol dimensions drawn by (month, block) in one
+// replicate, shared by every path of it.
+static inline void rng_sobol_seeds(uint64_t seed, uint64_t replicate, uint32_t month, uint32_t block,
+                                   uint64_t out[2]) {
+    out[0] = RNG_SOBOL_PATH - replicate;
+    out[1] = ((uint64_t)month << 32) | block;
+    threefry2x64(out, seed, 0);
+}
+
+#endif
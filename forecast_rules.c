@@ -0,0 +1,676 @@
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "forecast_rules.h"
+
+#define RULES_STACK 32
+#define RULES_MAX_LETS 32
+#define RULES_MAX_ONCE 32
+#define RULES_NAME 48
+
+typedef enum {
+    OP_CONST,
+    OP_PARAM,
+    OP_VAR,
+    OP_LET,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_MOD,
+    OP_POW,
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_EQ,
+    OP_NE,
+    OP_AND,
+    OP_OR,
+    OP_MIN,
+    OP_MAX,
+    OP_NEG,
+    OP_NOT,
+    OP_FLOOR,
+    OP_EXP,
+    OP_LOG,
+    OP_WHEN,        // condition on top: value if it holds, else 0
+    OP_ONCE,        // like OP_WHEN, at most once per path
+    OP_SET,         // pops into a let
+    OP_COST,        // pops and subtracts from the output
+    OP_INCOME       // pops and adds to the output
+} RuleOpcode;
+
+enum {
+    VAR_STEP,
+    VAR_MONTH,
+    VAR_STEP_MONTHS,
+    VAR_USERS,
+    VAR_NEW_USERS,
+    VAR_STORAGE,
+    VAR_COMPANIES,
+    VAR_CUMULATIVE,
+    VAR_COUNT
+};
+
+static const char *const var_names[VAR_COUNT] = {
+    "step", "month", "step_months", "users", "new_users", "storage", "companies", "cumulative"
+};
+
+typedef struct {
+    int op;
+    int arg;
+    double value;
+} RuleOp;
+
+typedef struct {
+    RuleOp *ops;
+    int count;
+    int capacity;
+} RuleProgram;
+
+struct ForecastRules {
+    RuleProgram open;       // lets and initial rules, run at step 0
+    RuleProgram step;       // lets and recurring rules, run every step
+    int lets;
+    int onces;
+};
+
+// A uniform row holds one value for every path in its first element, so
+// per-step quantities such as month or a parameter cost one evaluation
+// rather than one per path.
+struct RulesScratch {
+    double stack[RULES_STACK][RULES_WIDTH];
+    unsigned char uniform[RULES_STACK];
+    double lets[RULES_MAX_LETS][RULES_WIDTH];
+    unsigned char let_uniform[RULES_MAX_LETS];
+    unsigned char fired[RULES_MAX_ONCE][RULES_WIDTH];
+};
+
+// Python's %: the result takes the sign of the divisor.
+static double floor_mod(double a, double b) {
+    return a - b * floor(a / b);
+}
+
+static double apply_binary(int op, double a, double b) {
+    switch (op) {
+    case OP_ADD: return a + b;
+    case OP_SUB: return a - b;
+    case OP_MUL: return a * b;
+    case OP_DIV: return a / b;
+    case OP_MOD: return floor_mod(a, b);
+    case OP_POW: return pow(a, b);
+    case OP_LT: return a < b;
+    case OP_LE: return a <= b;
+    case OP_GT: return a > b;
+    case OP_GE: return a >= b;
+    case OP_EQ: return a == b;
+    case OP_NE: return a != b;
+    case OP_AND: return a != 0 && b != 0;
+    case OP_OR: return a != 0 || b != 0;
+    case OP_MIN: return fmin(a, b);
+    default: return fmax(a, b);
+    }
+}
+
+static double apply_unary(int op, double a) {
+    switch (op) {
+    case OP_NEG: return -a;
+    case OP_NOT: return a == 0;
+    case OP_FLOOR: return floor(a);
+    case OP_EXP: return exp(a);
+    default: return log(a);
+    }
+}
+
+// Compiler
+
+typedef struct {
+    const char *p;
+    int line;
+    int failed;
+    char *error;
+    size_t error_size;
+    RuleProgram code;       // the statement being compiled
+    int depth;
+    char let_names[RULES_MAX_LETS][RULES_NAME];
+    int lets;
+    int onces;
+} Parser;
+
+static void fail(Parser *ps, const char *message, const char *detail) {
+    if (ps->failed) return;
+    ps->failed = 1;
+    if (ps->error && ps->error_size) {
+        snprintf(ps->error, ps->error_size, "line %d: %s%s", ps->line, message, detail ? detail : "");
+    }
+}
+
+static int program_push(RuleProgram *program, RuleOp op) {
+    if (program->count == program->capacity) {
+        int capacity = program->capacity ? 2 * program->capacity : 64;
+        RuleOp *ops = realloc(program->ops, capacity * sizeof(RuleOp));
+        if (!ops) return -1;
+        program->ops = ops;
+        program->capacity = capacity;
+    }
+    program->ops[program->count++] = op;
+    return 0;
+}
+
+static int program_append(RuleProgram *program, const RuleProgram *code) {
+    for (int i = 0; i < code->count; i++) {
+        if (program_push(program, code->ops[i]) != 0) return -1;
+    }
+    return 0;
+}
+
+// Emits op, tracking the stack depth it leaves; `effect` is pushes minus pops.
+static void emit(Parser *ps, int op, int arg, double value, int effect) {
+    if (ps->failed) return;
+    ps->depth += effect;
+    if (ps->depth > RULES_STACK) {
+        fail(ps, "expression too deep", NULL);
+        return;
+    }
+    if (program_push(&ps->code, (RuleOp){op, arg, value}) != 0) fail(ps, "out of memory", NULL);
+}
+
+// Constant operands are folded at compile time with the same arithmetic
+// the evaluator uses.
+static void emit_binary(Parser *ps, int op) {
+    RuleOp *ops = ps->code.ops;
+    int n = ps->code.count;
+    if (!ps->failed && n >= 2 && ops[n - 2].op == OP_CONST && ops[n - 1].op == OP_CONST) {
+        ops[n - 2].value = apply_binary(op, ops[n - 2].value, ops[n - 1].value);
+        ps->code.count--;
+        ps->depth--;
+        return;
+    }
+    emit(ps, op, 0, 0, -1);
+}
+
+static void emit_unary(Parser *ps, int op) {
+    int n = ps->code.count;
+    if (!ps->failed && n >= 1 && ps->code.ops[n - 1].op == OP_CONST) {
+        ps->code.ops[n - 1].value = apply_unary(op, ps->code.ops[n - 1].value);
+        return;
+    }
+    emit(ps, op, 0, 0, 0);
+}
+
+static void skip_space(Parser *ps) {
+    while (*ps->p == ' ' || *ps->p == '\t' || *ps->p == '\r') ps->p++;
+}
+
+// Reads an identifier into name; 0 if there is none.
+static int read_name(Parser *ps, char *name) {
+    skip_space(ps);
+    if (!isalpha((unsigned char)*ps->p) && *ps->p != '_') return 0;
+    int n = 0;
+    while (isalnum((unsigned char)*ps->p) || *ps->p == '_') {
+        if (n < RULES_NAME - 1) name[n++] = *ps->p;
+        ps->p++;
+    }
+    name[n] = '\0';
+    return 1;
+}
+
+// Consumes token if it comes next; words must not run on into a name.
+static int accept(Parser *ps, const char *token) {
+    skip_space(ps);
+    size_t n = strlen(token);
+    if (strncmp(ps->p, token, n) != 0) return 0;
+    if (isalpha((unsigned char)token[0]) && (isalnum((unsigned char)ps->p[n]) || ps->p[n] == '_')) return 0;
+    ps->p += n;
+    return 1;
+}
+
+static void expect(Parser *ps, const char *token) {
+    if (!accept(ps, token)) fail(ps, "expected ", token);
+}
+
+static void parse_expr(Parser *ps);
+
+static void parse_call(Parser *ps, const char *name) {
+    static const struct {
+        const char *name;
+        int op;
+        int args;
+    } functions[] = {
+        {"min", OP_MIN, 2}, {"max", OP_MAX, 2}, {"floor", OP_FLOOR, 1}, {"exp", OP_EXP, 1}, {"log", OP_LOG, 1}
+    };
+    for (size_t i = 0; i < sizeof(functions) / sizeof(functions[0]); i++) {
+        if (strcmp(functions[i].name, name) != 0) continue;
+        parse_expr(ps);
+        for (int arg = 1; arg < functions[i].args; arg++) {
+            expect(ps, ",");
+            parse_expr(ps);
+        }
+        expect(ps, ")");
+        if (functions[i].args == 2) emit_binary(ps, functions[i].op); else emit_unary(ps, functions[i].op);
+        return;
+    }
+    fail(ps, "unknown function ", name);
+}
+
+static void parse_name(Parser *ps, const char *name) {
+    for (int i = 0; i < ps->lets; i++) {
+        if (strcmp(ps->let_names[i], name) == 0) {
+            emit(ps, OP_LET, i, 0, 1);
+            return;
+        }
+    }
+    for (int i = 0; i < VAR_COUNT; i++) {
+        if (strcmp(var_names[i], name) == 0) {
+            emit(ps, OP_VAR, i, 0, 1);
+            return;
+        }
+    }
+    const ParameterField *field = parameter_field_find(name);
+    if (field) {
+        emit(ps, OP_PARAM, (int)(field - parameter_fields), 0, 1);
+        return;
+    }
+    fail(ps, "unknown name ", name);
+}
+
+static void parse_atom(Parser *ps) {
+    char name[RULES_NAME];
+    skip_space(ps);
+    if (accept(ps, "(")) {
+        parse_expr(ps);
+        expect(ps, ")");
+    } else if (isdigit((unsigned char)*ps->p) || *ps->p == '.') {
+        char *end;
+        double value = strtod(ps->p, &end);
+        ps->p = end;
+        emit(ps, OP_CONST, 0, value, 1);
+    } else if (read_name(ps, name)) {
+        if (accept(ps, "(")) parse_call(ps, name); else parse_name(ps, name);
+    } else {
+        fail(ps, "expected a value", NULL);
+    }
+}
+
+static void parse_unary(Parser *ps);
+
+// ^ binds tighter than unary minus and associates to the right.
+static void parse_power(Parser *ps) {
+    parse_atom(ps);
+    if (accept(ps, "^")) {
+        parse_unary(ps);
+        emit_binary(ps, OP_POW);
+    }
+}
+
+static void parse_unary(Parser *ps) {
+    if (accept(ps, "-")) {
+        parse_unary(ps);
+        emit_unary(ps, OP_NEG);
+    } else {
+        parse_power(ps);
+    }
+}
+
+static void parse_product(Parser *ps) {
+    parse_unary(ps);
+    for (;;) {
+        int op = accept(ps, "*") ? OP_MUL : accept(ps, "/") ? OP_DIV : accept(ps, "%") ? OP_MOD : -1;
+        if (op < 0 || ps->failed) return;
+        parse_unary(ps);
+        emit_binary(ps, op);
+    }
+}
+
+static void parse_sum(Parser *ps) {
+    parse_product(ps);
+    for (;;) {
+        int op = accept(ps, "+") ? OP_ADD : accept(ps, "-") ? OP_SUB : -1;
+        if (op < 0 || ps->failed) return;
+        parse_product(ps);
+        emit_binary(ps, op);
+    }
+}
+
+static void parse_comparison(Parser *ps) {
+    parse_sum(ps);
+    int op = accept(ps, "<=") ? OP_LE : accept(ps, ">=") ? OP_GE : accept(ps, "==") ? OP_EQ
+           : accept(ps, "!=") ? OP_NE : accept(ps, "<") ? OP_LT : accept(ps, ">") ? OP_GT : -1;
+    if (op >= 0) {
+        parse_sum(ps);
+        emit_binary(ps, op);
+    }
+}
+
+static void parse_not(Parser *ps) {
+    if (accept(ps, "not")) {
+        parse_not(ps);
+        emit_unary(ps, OP_NOT);
+    } else {
+        parse_comparison(ps);
+    }
+}
+
+static void parse_and(Parser *ps) {
+    parse_not(ps);
+    while (!ps->failed && accept(ps, "and")) {
+        parse_not(ps);
+        emit_binary(ps, OP_AND);
+    }
+}
+
+static void parse_expr(Parser *ps) {
+    parse_and(ps);
+    while (!ps->failed && accept(ps, "or")) {
+        parse_and(ps);
+        emit_binary(ps, OP_OR);
+    }
+}
+
+static int name_taken(const Parser *ps, const char *name) {
+    for (int i = 0; i < ps->lets; i++) {
+        if (strcmp(ps->let_names[i], name) == 0) return 1;
+    }
+    for (int i = 0; i < VAR_COUNT; i++) {
+        if (strcmp(var_names[i], name) == 0) return 1;
+    }
+    return parameter_field_find(name) != NULL;
+}
+
+// Compiles one statement into ps->code and appends it to the programs it
+// belongs to.
+static void parse_statement(Parser *ps, ForecastRules *rules) {
+    char kind[RULES_NAME];
+    char name[RULES_NAME];
+    ps->code.count = 0;
+    ps->depth = 0;
+    if (!read_name(ps, kind)) {
+        fail(ps, "expected let, initial, monthly, extra or revenue", NULL);
+        return;
+    }
+
+    int is_let = strcmp(kind, "let") == 0;
+    int is_initial = strcmp(kind, "initial") == 0;
+    int is_revenue = strcmp(kind, "revenue") == 0;
+    if (!is_let && !is_initial && !is_revenue && strcmp(kind, "monthly") != 0 && strcmp(kind, "extra") != 0) {
+        fail(ps, "unknown rule kind ", kind);
+        return;
+    }
+    int once = !is_let && accept(ps, "once");
+    if (once && is_initial) {
+        fail(ps, "initial rules are always paid once", NULL);
+        return;
+    }
+    if (!read_name(ps, name)) {
+        fail(ps, "expected a rule name", NULL);
+        return;
+    }
+    expect(ps, "=");
+    parse_expr(ps);
+
+    if (is_let) {
+        if (name_taken(ps, name)) fail(ps, "name already in use: ", name);
+        if (ps->lets == RULES_MAX_LETS) fail(ps, "too many lets", NULL);
+        emit(ps, OP_SET, ps->lets, 0, -1);
+    } else {
+        if (accept(ps, "if")) {
+            parse_expr(ps);
+            if (once && ps->onces == RULES_MAX_ONCE) fail(ps, "too many once rules", NULL);
+            emit(ps, once ? OP_ONCE : OP_WHEN, once ? ps->onces++ : 0, 0, -1);
+        } else if (once) {
+            // Without a condition a once rule is paid at the first step.
+            if (ps->onces == RULES_MAX_ONCE) fail(ps, "too many once rules", NULL);
+            emit(ps, OP_CONST, 0, 1, 1);
+            emit(ps, OP_ONCE, ps->onces++, 0, -1);
+        }
+        emit(ps, is_revenue ? OP_INCOME : OP_COST, 0, 0, -1);
+    }
+    skip_space(ps);
+    if (*ps->p) fail(ps, "unexpected ", ps->p);
+    if (ps->failed) return;
+
+    int ok = 1;
+    if (is_let || is_initial) ok = ok && program_append(&rules->open, &ps->code) == 0;
+    if (!is_initial) ok = ok && program_append(&rules->step, &ps->code) == 0;
+    if (!ok) fail(ps, "out of memory", NULL);
+    if (is_let && !ps->failed) {
+        strcpy(ps->let_names[ps->lets++], name);
+    }
+}
+
+ForecastRules *forecast_rules_compile(const char *text, char *error, size_t error_size) {
+    ForecastRules *rules = calloc(1, sizeof(ForecastRules));
+    Parser ps = {0};
+    ps.error = error;
+    ps.error_size = error_size;
+    if (!rules) return NULL;
+
+    char line[1024];
+    const char *next = text;
+    while (*next && !ps.failed) {
+        const char *end = strchr(next, '\n');
+        size_t length = end ? (size_t)(end - next) : strlen(next);
+        ps.line++;
+        if (length >= sizeof(line)) {
+            fail(&ps, "line too long", NULL);
+            break;
+        }
+        memcpy(line, next, length);
+        line[length] = '\0';
+        char *comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+        next += length + (end != NULL);
+
+        ps.p = line;
+        skip_space(&ps);
+        if (*ps.p) parse_statement(&ps, rules);
+    }
+
+    free(ps.code.ops);
+    rules->lets = ps.lets;
+    rules->onces = ps.onces;
+    if (ps.failed) {
+        forecast_rules_free(rules);
+        return NULL;
+    }
+    return rules;
+}
+
+ForecastRules *forecast_rules_load(const char *path, char *error, size_t error_size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        snprintf(error, error_size, "cannot open %s", path);
+        return NULL;
+    }
+    size_t size = 0;
+    size_t capacity = 4096;
+    char *text = malloc(capacity);
+    size_t n;
+    while (text && (n = fread(text + size, 1, capacity - size - 1, f)) > 0) {
+        size += n;
+        if (size + 1 == capacity) {
+            char *grown = realloc(text, capacity *= 2);
+            if (!grown) free(text);
+            text = grown;
+        }
+    }
+    fclose(f);
+    if (!text) {
+        snprintf(error, error_size, "out of memory");
+        return NULL;
+    }
+    text[size] = '\0';
+    ForecastRules *rules = forecast_rules_compile(text, error, error_size);
+    free(text);
+    return rules;
+}
+
+void forecast_rules_free(ForecastRules *rules) {
+    if (!rules) return;
+    free(rules->open.ops);
+    free(rules->step.ops);
+    free(rules);
+}
+
+RulesScratch *forecast_rules_scratch_create(const ForecastRules *rules) {
+    (void)rules;
+    return calloc(1, sizeof(RulesScratch));
+}
+
+void forecast_rules_scratch_free(RulesScratch *scratch) {
+    free(scratch);
+}
+
+// Evaluator
+
+// Loads a variable into out; returns 1 if it is uniform.
+static int load_var(int var, const RulesRow *row, double *out) {
+    int n = row->count;
+    const ParameterSet *params = row->params;
+    switch (var) {
+    case VAR_USERS:
+        memcpy(out, row->users, n * sizeof(double));
+        return 0;
+    case VAR_NEW_USERS:
+        if (!row->previous_users) break;
+        for (int i = 0; i < n; i++) out[i] = row->users[i] - row->previous_users[i];
+        return 0;
+    case VAR_STORAGE:
+        for (int i = 0; i < n; i++) out[i] = row->users[i] * params->avg_gb_per_user;
+        return 0;
+    case VAR_CUMULATIVE:
+        if (!row->cumulative) break;
+        memcpy(out, row->cumulative, n * sizeof(double));
+        return 0;
+    case VAR_STEP: out[0] = row->step; return 1;
+    case VAR_MONTH: out[0] = row->step * parameter_step_months(params); return 1;
+    case VAR_STEP_MONTHS: out[0] = parameter_step_months(params); return 1;
+    case VAR_COMPANIES: out[0] = row->companies; return 1;
+    }
+    out[0] = 0;
+    return 1;
+}
+
+static void broadcast(double *row, int n) {
+    for (int i = 1; i < n; i++) row[i] = row[0];
+}
+
+// Width a binary op runs at: 1 when both operands are uniform, else n with
+// a uniform operand broadcast first. The result takes the left slot.
+static int binary_width(RulesScratch *scratch, int top, int n) {
+    unsigned char *uniform = &scratch->uniform[top - 2];
+    if (uniform[0] && uniform[1]) return 1;
+    if (uniform[0]) broadcast(scratch->stack[top - 2], n);
+    if (uniform[1]) broadcast(scratch->stack[top - 1], n);
+    uniform[0] = 0;
+    return n;
+}
+
+#define EACH(body) for (int i = 0; i < w; i++) { body; }
+
+// One instruction at a time over the whole row; each case is a plain loop
+// the compiler vectorizes where it can.
+static void run_program(const RuleProgram *program, RulesScratch *scratch, const RulesRow *row, double *out) {
+    int n = row->count;
+    int top = 0;
+    memset(out, 0, n * sizeof(double));
+    for (int pc = 0; pc < program->count; pc++) {
+        const RuleOp *op = &program->ops[pc];
+        double *x = top >= 2 ? scratch->stack[top - 2] : NULL;
+        double *y = top >= 1 ? scratch->stack[top - 1] : NULL;
+        double *push = scratch->stack[top];
+        int w = n;
+        switch (op->op) {
+        case OP_CONST:
+            push[0] = op->value;
+            scratch->uniform[top++] = 1;
+            continue;
+        case OP_PARAM:
+            push[0] = parameter_get(row->params, &parameter_fields[op->arg]);
+            scratch->uniform[top++] = 1;
+            continue;
+        case OP_VAR:
+            scratch->uniform[top] = load_var(op->arg, row, push);
+            top++;
+            continue;
+        case OP_LET:
+            scratch->uniform[top] = scratch->let_uniform[op->arg];
+            memcpy(push, scratch->lets[op->arg], (scratch->uniform[top] ? 1 : n) * sizeof(double));
+            top++;
+            continue;
+        case OP_SET:
+            scratch->let_uniform[op->arg] = scratch->uniform[--top];
+            memcpy(scratch->lets[op->arg], y, (scratch->uniform[top] ? 1 : n) * sizeof(double));
+            continue;
+        case OP_COST:
+            if (scratch->uniform[--top]) broadcast(y, n);
+            EACH(out[i] -= y[i]);
+            continue;
+        case OP_INCOME:
+            if (scratch->uniform[--top]) broadcast(y, n);
+            EACH(out[i] += y[i]);
+            continue;
+        case OP_NEG: case OP_NOT: case OP_FLOOR: case OP_EXP: case OP_LOG:
+            if (scratch->uniform[top - 1]) w = 1;
+            break;
+        case OP_ONCE:
+            // The fired flags are per path, so the result never is uniform.
+            if (scratch->uniform[top - 2]) broadcast(x, n);
+            if (scratch->uniform[top - 1]) broadcast(y, n);
+            scratch->uniform[top - 2] = 0;
+            break;
+        default:
+            w = binary_width(scratch, top, n);
+            break;
+        }
+
+        switch (op->op) {
+        case OP_ADD: EACH(x[i] = x[i] + y[i]); break;
+        case OP_SUB: EACH(x[i] = x[i] - y[i]); break;
+        case OP_MUL: EACH(x[i] = x[i] * y[i]); break;
+        case OP_DIV: EACH(x[i] = x[i] / y[i]); break;
+        case OP_MOD: EACH(x[i] = floor_mod(x[i], y[i])); break;
+        case OP_POW: EACH(x[i] = pow(x[i], y[i])); break;
+        case OP_LT: EACH(x[i] = x[i] < y[i]); break;
+        case OP_LE: EACH(x[i] = x[i] <= y[i]); break;
+        case OP_GT: EACH(x[i] = x[i] > y[i]); break;
+        case OP_GE: EACH(x[i] = x[i] >= y[i]); break;
+        case OP_EQ: EACH(x[i] = x[i] == y[i]); break;
+        case OP_NE: EACH(x[i] = x[i] != y[i]); break;
+        case OP_AND: EACH(x[i] = x[i] != 0 && y[i] != 0); break;
+        case OP_OR: EACH(x[i] = x[i] != 0 || y[i] != 0); break;
+        case OP_MIN: EACH(x[i] = fmin(x[i], y[i])); break;
+        case OP_MAX: EACH(x[i] = fmax(x[i], y[i])); break;
+        case OP_WHEN: EACH(x[i] = y[i] != 0 ? x[i] : 0); break;
+        case OP_ONCE: {
+            unsigned char *fired = scratch->fired[op->arg];
+            EACH(int pay = y[i] != 0 && !fired[i]; fired[i] |= pay; x[i] = pay ? x[i] : 0);
+            break;
+        }
+        case OP_NEG: EACH(y[i] = -y[i]); break;
+        case OP_NOT: EACH(y[i] = y[i] == 0); break;
+        case OP_FLOOR: EACH(y[i] = floor(y[i])); break;
+        case OP_EXP: EACH(y[i] = exp(y[i])); break;
+        case OP_LOG: EACH(y[i] = log(y[i])); break;
+        }
+        // Every op left is binary but the unary ones.
+        if (op->op < OP_NEG || op->op == OP_WHEN || op->op == OP_ONCE) top--;
+    }
+}
+
+#undef EACH
+
+void forecast_rules_open(const ForecastRules *rules, RulesScratch *scratch, const RulesRow *row, double *balance) {
+    for (int rule = 0; rule < rules->onces; rule++) {
+        memset(scratch->fired[rule], 0, row->count);
+    }
+    run_program(&rules->open, scratch, row, balance);
+}
+
+void forecast_rules_step(const ForecastRules *rules, RulesScratch *scratch, const RulesRow *row, double *net) {
+    run_program(&rules->step, scratch, row, net);
+}
@@ -0,0 +1,62 @@
+#ifndef FORECAST_RULES_H
+#define FORECAST_RULES_H
+
+#include <stddef.h>
+
+#include "forecast_core.h"
+
+// Declarative finance model replacing the built-in price and expenses, the
+// native form of finsim.py's Expense, ConditionalExpense and Revenue
+// objects. One rule per line, '#' starts a comment:
+//
+//   let <name> = <expr>                     value shared by later rules
+//   initial <name> = <expr> [if <cond>]     one-off cost before step one
+//   monthly|extra <name> = <expr> [if <cond>]   cost every step
+//   revenue <name> = <expr> [if <cond>]     income every step
+//
+// A recurring kind followed by `once` counts only at the first step its
+// condition holds. Expressions take numbers, + - * / % ^, comparisons,
+// and/or/not, min(a, b), max(a, b), floor, exp and log over the path's
+// step, month (elapsed months), step_months, users, new_users, storage
+// (GB), companies and cumulative (profit before the step), plus every
+// ParameterSet field by name. Amounts are per step.
+//
+// Rules compile to flat postfix programs evaluated an instruction at a time
+// over a row of paths, so the interpretation cost is paid once per row, not
+// per path.
+typedef struct ForecastRules ForecastRules;
+
+// NULL on error, with a message naming the line in error.
+ForecastRules *forecast_rules_compile(const char *text, char *error, size_t error_size);
+ForecastRules *forecast_rules_load(const char *path, char *error, size_t error_size);
+void forecast_rules_free(ForecastRules *rules);
+
+// Paths one evaluation covers at most.
+#define RULES_WIDTH 256
+
+// One step of `count` paths. users, previous_users and cumulative hold
+// count values each; previous_users is NULL at step 0.
+typedef struct {
+    const ParameterSet *params;
+    int step;
+    double companies;
+    const double *users;
+    const double *previous_users;
+    const double *cumulative;
+    int count;
+} RulesRow;
+
+// Per-thread evaluation state: the value stack, the lets and which `once`
+// rules each path has already paid.
+typedef struct RulesScratch RulesScratch;
+
+RulesScratch *forecast_rules_scratch_create(const ForecastRules *rules);
+void forecast_rules_scratch_free(RulesScratch *scratch);
+
+// Opening balance of each path, minus its initial rules evaluated at step
+// 0. Starts a new group of paths: `once` rules become payable again.
+void forecast_rules_open(const ForecastRules *rules, RulesScratch *scratch, const RulesRow *row, double *balance);
+// Net cash flow of the step for each path: revenue minus costs.
+void forecast_rules_step(const ForecastRules *rules, RulesScratch *scratch, const RulesRow *row, double *net);
+
+#endif
@@ -0,0 +1,112 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "forecast_sampler.h"
+
+int company_size_sampler_init(CompanySizeSampler *sampler, int min_size, int max_size, double mean_company_size) {
+    memset(sampler, 0, sizeof(*sampler));
+    if (max_size < min_size || mean_company_size <= 0) return -1;
+
+    int n = max_size - min_size + 1;
+    sampler->min_size = min_size;
+    sampler->count = n;
+    sampler->prob = malloc(n * sizeof(double));
+    sampler->alias = malloc(n * sizeof(int));
+    sampler->cdf = malloc(n * sizeof(double));
+    sampler->guide = malloc(n * sizeof(int));
+    double *scaled = malloc(n * sizeof(double));
+    int *small = malloc(n * sizeof(int));
+    int *large = malloc(n * sizeof(int));
+    if (!sampler->prob || !sampler->alias || !sampler->cdf || !sampler->guide || !scaled || !small || !large) {
+        free(scaled);
+        free(small);
+        free(large);
+        company_size_sampler_free(sampler);
+        return -1;
+    }
+
+    double sum_weights = 0;
+    for (int j = 0; j < n; j++) {
+        scaled[j] = exp(-j / mean_company_size);
+        sum_weights += scaled[j];
+    }
+
+    double mean = 0;
+    double second = 0;
+    double cumulative = 0;
+    for (int j = 0; j < n; j++) {
+        double p = scaled[j] / sum_weights;
+        double size = min_size + j;
+        mean += p * size;
+        second += p * size * size;
+        cumulative += p;
+        sampler->cdf[j] = cumulative;
+        scaled[j] = p * n;
+    }
+    sampler->mean = mean;
+    sampler->variance = second - mean * mean > 0 ? second - mean * mean : 0;
+    sampler->cdf[n - 1] = 1;
+    for (int k = 0, j = 0; k < n; k++) {
+        while (sampler->cdf[j] <= (double)k / n) j++;
+        sampler->guide[k] = j;
+    }
+
+    // Vose: pair each under-full column with an over-full one.
+    int small_count = 0;
+    int large_count = 0;
+    for (int j = 0; j < n; j++) {
+        if (scaled[j] < 1) {
+            small[small_count++] = j;
+        } else {
+            large[large_count++] = j;
+        }
+    }
+    while (small_count > 0 && large_count > 0) {
+        int less = small[--small_count];
+        int more = large[--large_count];
+        sampler->prob[less] = scaled[less];
+        sampler->alias[less] = more;
+        scaled[more] = (scaled[more] + scaled[less]) - 1;
+        if (scaled[more] < 1) {
+            small[small_count++] = more;
+        } else {
+            large[large_count++] = more;
+        }
+    }
+    // Leftovers are full columns up to rounding error.
+    while (large_count > 0) {
+        int j = large[--large_count];
+        sampler->prob[j] = 1;
+        sampler->alias[j] = j;
+    }
+    while (small_count > 0) {
+        int j = small[--small_count];
+        sampler->prob[j] = 1;
+        sampler->alias[j] = j;
+    }
+
+    free(scaled);
+    free(small);
+    free(large);
+    return 0;
+}
+
+void company_size_sampler_free(CompanySizeSampler *sampler) {
+    free(sampler->prob);
+    free(sampler->alias);
+    free(sampler->cdf);
+    free(sampler->guide);
+    memset(sampler, 0, sizeof(*sampler));
+}
+
+double company_size_total(const CompanySizeSampler *sampler, int companies, double u1, double u2) {
+    // Box-Muller; 1 - u1 keeps the log argument in (0, 1].
+    double z = sqrt(-2 * log(1 - u1)) * cos(2 * M_PI * u2);
+    double total = round(companies * sampler->mean + sqrt(companies * sampler->variance) * z);
+    double lowest = (double)companies * sampler->min_size;
+    double highest = (double)companies * (sampler->min_size + sampler->count - 1);
+    if (total < lowest) total = lowest;
+    if (total > highest) total = highest;
+    return total;
+}
@@ -0,0 +1,49 @@
+#ifndef FORECAST_SAMPLER_H
+#define FORECAST_SAMPLER_H
+
+// Company headcount distribution, P(size = min + j) ~ exp(-j / mean_company_size)
+// over [min, max], prepared once per parameter set as a Walker/Vose alias
+// table so each draw costs O(1) whatever the size range. A guide table over
+// the CDF gives the monotone inverse-transform draw that antithetic and
+// quasi-random sampling need, in O(1) expected time.
+typedef struct {
+    int min_size;
+    int count;
+    double *prob;
+    int *alias;
+    double *cdf;            // P(size <= min + j); the last entry is exactly 1
+    int *guide;             // [k]: first j with cdf[j] > k / count
+    double mean;
+    double variance;
+} CompanySizeSampler;
+
+// Above this many companies in one month, the total headcount is drawn from
+// the normal approximation of the sum instead of one draw per company.
+#define SAMPLER_NORMAL_APPROX_COMPANIES 32
+
+// Returns 0 on success, -1 on an empty range or OOM.
+int company_size_sampler_init(CompanySizeSampler *sampler, int min_size, int max_size, double mean_company_size);
+void company_size_sampler_free(CompanySizeSampler *sampler);
+
+// One headcount from a single uniform in [0, 1): the integer part of
+// u * count picks the column, the fractional part decides column vs alias.
+static inline int company_size_draw(const CompanySizeSampler *sampler, double u) {
+    double x = u * sampler->count;
+    int column = (int)x;
+    if (column >= sampler->count) column = sampler->count - 1;
+    return sampler->min_size + (x - column < sampler->prob[column] ? column : sampler->alias[column]);
+}
+
+// Inverse-transform headcount of u in [0, 1): nondecreasing in u.
+static inline int company_size_quantile(const CompanySizeSampler *sampler, double u) {
+    int k = (int)(u * sampler->count);
+    int j = sampler->guide[k < sampler->count ? k : sampler->count - 1];
+    while (sampler->cdf[j] <= u) j++;
+    return sampler->min_size + j;
+}
+
+// Total headcount of `companies` independent companies, from two uniforms,
+// rounded and clamped to the feasible range.
+double company_size_total(const CompanySizeSampler *sampler, int companies, double u1, double u2);
+
+#endif
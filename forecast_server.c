@@ -0,0 +1,1075 @@
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "forecast_core.h"
+#include "forecast_rules.h"
+
+// Local forecast daemon: the native engine behind HTTP/1.1 on localhost or
+// a Unix socket, with an LRU cache of response bodies keyed by the run's
+// canonical parameters, so index.html and scripts get repeated answers
+// without rerunning them.
+//
+//   POST /forecast   {"preset": 1, "seed": 0, "iterations": 10000, ...}
+//   GET  /presets    the built-in parameter sets
+//   GET  /stats      cache counters
+//
+// A request is a flat JSON object of ParameterSet fields by name, over the
+// preset given by index or name (default 0), plus an optional seed and
+// finance rules text (forecast_rules.h). Requests naming the same run in
+// different words share one cache entry, and identical requests arriving
+// while the run is in flight wait for it instead of starting another.
+//
+// Runs above a path-month budget are refused, and a run is cancelled once
+// every client waiting for it has gone. Browsers may only call from one
+// origin (file:// pages send "null"); requests from any other are refused
+// before they run, since a page can POST here without asking first.
+
+#define SERVER_DEFAULT_PORT 8750
+#define SERVER_DEFAULT_CACHE_MB 64
+#define SERVER_DEFAULT_BUDGET 1e9      // path-months per request
+#define SERVER_DEFAULT_ORIGIN "null"
+#define SERVER_ORIGIN_MAX 256
+#define SERVER_WAIT_POLL_MS 100     // how often waiters check their client
+#define SERVER_IDLE_SECONDS 30
+#define REQUEST_MAX_HEADER 8192
+#define REQUEST_MAX_BODY (1 << 20)
+#define REQUEST_MAX_KEYS 64
+#define CACHE_BUCKETS 1024
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+typedef enum {
+    ENTRY_PENDING,          // the first requester is running it
+    ENTRY_READY,
+    ENTRY_FAILED            // body holds the error; never cached
+} EntryState;
+
+typedef struct CacheEntry {
+    uint64_t hash;
+    unsigned char *key;
+    size_t key_size;
+    EntryState state;
+    int status;             // HTTP status of body
+    char *body;
+    size_t body_size;
+    int refs;               // requests holding the entry
+    int clients;            // of a pending entry: requesters still connected
+    int linked;             // in the table and, once ready, the LRU list
+    struct CacheEntry *bucket_next;
+    struct CacheEntry *newer;
+    struct CacheEntry *older;
+} CacheEntry;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t settled;
+    CacheEntry *buckets[CACHE_BUCKETS];
+    CacheEntry *newest;
+    CacheEntry *oldest;
+    size_t entries;
+    size_t bytes;           // bodies of ready entries
+    size_t capacity;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long coalesced;
+    unsigned long long cancelled;
+} ResultCache;
+
+typedef enum {
+    LOOKUP_HIT,
+    LOOKUP_MISS,
+    LOOKUP_COALESCED,
+    LOOKUP_ABANDONED        // the client left while waiting; no entry
+} LookupOutcome;
+
+static const char *lookup_names[] = {"hit", "miss", "coalesced"};
+
+typedef struct {
+    ForecastPool *pool;
+    ResultCache cache;
+    double budget;          // path-months a request may ask for
+    const char *origin;     // the one browser origin allowed
+} Server;
+
+// Whether the peer of a connection has closed or reset it. Pipelined bytes
+// waiting to be read mean it is still there.
+static int client_gone(int fd) {
+    char byte;
+    ssize_t got = recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+}
+
+static uint64_t fnv_mix(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+static void cache_init(ResultCache *cache, size_t capacity) {
+    memset(cache, 0, sizeof(*cache));
+    pthread_mutex_init(&cache->lock, NULL);
+    pthread_cond_init(&cache->settled, NULL);
+    cache->capacity = capacity;
+}
+
+static void entry_free(CacheEntry *entry) {
+    free(entry->key);
+    free(entry->body);
+    free(entry);
+}
+
+// Takes entry out of the table and the LRU list; it is freed once the last
+// request holding it lets go. Called with the lock held.
+static void cache_unlink(ResultCache *cache, CacheEntry *entry) {
+    CacheEntry **link = &cache->buckets[entry->hash % CACHE_BUCKETS];
+    while (*link != entry) {
+        link = &(*link)->bucket_next;
+    }
+    *link = entry->bucket_next;
+    if (entry->state == ENTRY_READY) {
+        if (entry->newer) entry->newer->older = entry->older;
+        else cache->newest = entry->older;
+        if (entry->older) entry->older->newer = entry->newer;
+        else cache->oldest = entry->newer;
+        cache->bytes -= entry->body_size;
+    }
+    cache->entries--;
+    entry->linked = 0;
+    if (entry->refs == 0) entry_free(entry);
+}
+
+static void lru_push(ResultCache *cache, CacheEntry *entry) {
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    if (cache->newest) cache->newest->newer = entry;
+    else cache->oldest = entry;
+    cache->newest = entry;
+}
+
+// The entry for key with a reference held, waiting for it if another
+// request is running it. A miss inserts a pending entry the caller must
+// settle with cache_settle(). NULL on OOM, or with LOOKUP_ABANDONED if the
+// client on fd went away while waiting.
+static CacheEntry *cache_lookup(ResultCache *cache, unsigned char *key, size_t key_size, int fd,
+                                LookupOutcome *outcome) {
+    uint64_t hash = fnv_mix(FNV_OFFSET, key, key_size);
+    pthread_mutex_lock(&cache->lock);
+    CacheEntry *entry = cache->buckets[hash % CACHE_BUCKETS];
+    while (entry && !(entry->hash == hash && entry->key_size == key_size && !memcmp(entry->key, key, key_size))) {
+        entry = entry->bucket_next;
+    }
+    if (entry) {
+        entry->refs++;
+        if (entry->state == ENTRY_PENDING) {
+            *outcome = LOOKUP_COALESCED;
+            cache->coalesced++;
+            entry->clients++;
+            while (entry->state == ENTRY_PENDING) {
+                struct timespec deadline;
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_nsec += SERVER_WAIT_POLL_MS * 1000000L;
+                if (deadline.tv_nsec >= 1000000000L) {
+                    deadline.tv_sec++;
+                    deadline.tv_nsec -= 1000000000L;
+                }
+                pthread_cond_timedwait(&cache->settled, &cache->lock, &deadline);
+                if (entry->state == ENTRY_PENDING && client_gone(fd)) {
+                    // The runner holds a reference, so the entry stays.
+                    entry->clients--;
+                    entry->refs--;
+                    *outcome = LOOKUP_ABANDONED;
+                    entry = NULL;
+                    break;
+                }
+            }
+        } else {
+            *outcome = LOOKUP_HIT;
+            cache->hits++;
+            // Most recently used moves to the front.
+            if (entry->state == ENTRY_READY && cache->newest != entry) {
+                entry->newer->older = entry->older;
+                if (entry->older) entry->older->newer = entry->newer;
+                else cache->oldest = entry->newer;
+                lru_push(cache, entry);
+            }
+        }
+        free(key);
+    } else if ((entry = calloc(1, sizeof(CacheEntry)))) {
+        entry->hash = hash;
+        entry->key = key;
+        entry->key_size = key_size;
+        entry->state = ENTRY_PENDING;
+        entry->refs = 1;
+        entry->clients = 1;
+        entry->linked = 1;
+        entry->bucket_next = cache->buckets[hash % CACHE_BUCKETS];
+        cache->buckets[hash % CACHE_BUCKETS] = entry;
+        cache->entries++;
+        cache->misses++;
+        *outcome = LOOKUP_MISS;
+    } else {
+        free(key);
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return entry;
+}
+
+// Stores the body of a pending entry and wakes its waiters. Successful
+// bodies are kept, evicting the least recently used beyond capacity (the
+// new one too if it alone is larger); errors, and the bodies of cancelled
+// runs, are handed to the waiters and dropped.
+static void cache_settle(ResultCache *cache, CacheEntry *entry, int status, char *body, size_t body_size) {
+    pthread_mutex_lock(&cache->lock);
+    entry->status = status;
+    entry->body = body;
+    entry->body_size = body_size;
+    if (!entry->linked) {
+        entry->state = ENTRY_FAILED;
+    } else if (status == 200) {
+        entry->state = ENTRY_READY;
+        lru_push(cache, entry);
+        cache->bytes += body_size;
+        while (cache->bytes > cache->capacity) {
+            cache_unlink(cache, cache->oldest);
+        }
+    } else {
+        entry->state = ENTRY_FAILED;
+        cache_unlink(cache, entry);
+    }
+    pthread_cond_broadcast(&cache->settled);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+static void cache_release(ResultCache *cache, CacheEntry *entry) {
+    pthread_mutex_lock(&cache->lock);
+    if (--entry->refs == 0 && !entry->linked) entry_free(entry);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// --- Requests --------------------------------------------------------------
+
+typedef enum {
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_BOOL,
+    JSON_NULL
+} JsonType;
+
+typedef struct {
+    char *key;
+    JsonType type;
+    double number;
+    char *string;
+} JsonMember;
+
+typedef struct {
+    const char *p;
+    const char *end;
+} JsonCursor;
+
+static void json_skip_space(JsonCursor *c) {
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\n' || *c->p == '\r')) c->p++;
+}
+
+static void utf8_put(char **out, unsigned code) {
+    unsigned char *o = (unsigned char *)*out;
+    if (code < 0x80) {
+        *o++ = code;
+    } else if (code < 0x800) {
+        *o++ = 0xC0 | code >> 6;
+        *o++ = 0x80 | (code & 0x3F);
+    } else if (code < 0x10000) {
+        *o++ = 0xE0 | code >> 12;
+        *o++ = 0x80 | (code >> 6 & 0x3F);
+        *o++ = 0x80 | (code & 0x3F);
+    } else {
+        *o++ = 0xF0 | code >> 18;
+        *o++ = 0x80 | (code >> 12 & 0x3F);
+        *o++ = 0x80 | (code >> 6 & 0x3F);
+        *o++ = 0x80 | (code & 0x3F);
+    }
+    *out = (char *)o;
+}
+
+static int json_hex4(JsonCursor *c, unsigned *code) {
+    if (c->end - c->p < 4) return -1;
+    *code = 0;
+    for (int i = 0; i < 4; i++) {
+        char h = *c->p++;
+        int digit = h >= '0' && h <= '9' ? h - '0' : h >= 'a' && h <= 'f' ? h - 'a' + 10
+                  : h >= 'A' && h <= 'F' ? h - 'A' + 10 : -1;
+        if (digit < 0) return -1;
+        *code = *code << 4 | digit;
+    }
+    return 0;
+}
+
+// A JSON string at the cursor, unescaped into a new NUL-terminated buffer
+// (escaped text never grows).
+static char *json_string(JsonCursor *c) {
+    if (c->p >= c->end || *c->p != '"') return NULL;
+    c->p++;
+    char *text = malloc(c->end - c->p + 1);
+    char *out = text;
+    while (text && c->p < c->end && *c->p != '"') {
+        char ch = *c->p++;
+        if ((unsigned char)ch < 0x20) break;
+        if (ch != '\\') {
+            *out++ = ch;
+            continue;
+        }
+        if (c->p >= c->end) break;
+        char escape = *c->p++;
+        unsigned code;
+        switch (escape) {
+        case '"': case '\\': case '/': *out++ = escape; continue;
+        case 'b': *out++ = '\b'; continue;
+        case 'f': *out++ = '\f'; continue;
+        case 'n': *out++ = '\n'; continue;
+        case 'r': *out++ = '\r'; continue;
+        case 't': *out++ = '\t'; continue;
+        case 'u':
+            if (json_hex4(c, &code) != 0) break;
+            if (code >= 0xD800 && code < 0xDC00) {
+                unsigned low;
+                if (c->end - c->p < 6 || c->p[0] != '\\' || c->p[1] != 'u') break;
+                c->p += 2;
+                if (json_hex4(c, &low) != 0 || low < 0xDC00 || low >= 0xE000) break;
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            } else if (code >= 0xDC00 && code < 0xE000) {
+                break;
+            }
+            utf8_put(&out, code);
+            continue;
+        }
+        c->p = c->end;      // bad escape
+    }
+    if (!text || c->p >= c->end) {
+        free(text);
+        return NULL;
+    }
+    c->p++;
+    *out = '\0';
+    return text;
+}
+
+static int json_literal(JsonCursor *c, const char *word) {
+    size_t n = strlen(word);
+    if ((size_t)(c->end - c->p) < n || memcmp(c->p, word, n) != 0) return 0;
+    c->p += n;
+    return 1;
+}
+
+static void members_free(JsonMember *members, int count) {
+    for (int i = 0; i < count; i++) {
+        free(members[i].key);
+        free(members[i].string);
+    }
+}
+
+// Parses a flat JSON object of numbers, strings, booleans and nulls.
+// Returns the member count or -1 with a message.
+static int json_parse_object(const char *text, size_t size, JsonMember *members, int max_members,
+                             char *error, size_t error_size) {
+    JsonCursor c = {text, text + size};
+    int count = 0;
+    json_skip_space(&c);
+    if (c.p >= c.end || *c.p++ != '{') goto fail;
+    json_skip_space(&c);
+    if (c.p < c.end && *c.p == '}') {
+        c.p++;
+    } else {
+        for (;;) {
+            if (count == max_members) {
+                snprintf(error, error_size, "more than %d fields", max_members);
+                members_free(members, count);
+                return -1;
+            }
+            JsonMember *member = &members[count];
+            memset(member, 0, sizeof(*member));
+            json_skip_space(&c);
+            if (!(member->key = json_string(&c))) goto fail;
+            count++;
+            json_skip_space(&c);
+            if (c.p >= c.end || *c.p++ != ':') goto fail;
+            json_skip_space(&c);
+            if (c.p < c.end && *c.p == '"') {
+                member->type = JSON_STRING;
+                if (!(member->string = json_string(&c))) goto fail;
+            } else if (json_literal(&c, "true")) {
+                member->type = JSON_BOOL;
+                member->number = 1;
+            } else if (json_literal(&c, "false")) {
+                member->type = JSON_BOOL;
+            } else if (json_literal(&c, "null")) {
+                member->type = JSON_NULL;
+            } else {
+                char number[64];
+                size_t n = 0;
+                while (c.p + n < c.end && n + 1 < sizeof(number) && strchr("+-.0123456789eE", c.p[n])) {
+                    number[n] = c.p[n];
+                    n++;
+                }
+                number[n] = '\0';
+                char *stop;
+                member->type = JSON_NUMBER;
+                member->number = strtod(number, &stop);
+                if (n == 0 || *stop != '\0' || !isfinite(member->number)) goto fail;
+                c.p += n;
+            }
+            json_skip_space(&c);
+            if (c.p < c.end && *c.p == ',') {
+                c.p++;
+                continue;
+            }
+            if (c.p < c.end && *c.p == '}') {
+                c.p++;
+                break;
+            }
+            goto fail;
+        }
+    }
+    json_skip_space(&c);
+    if (c.p == c.end) return count;
+fail:
+    snprintf(error, error_size, "expected a flat JSON object near byte %d", (int)(c.p - text));
+    members_free(members, count);
+    return -1;
+}
+
+typedef struct {
+    ParameterSet params;
+    uint64_t seed;
+    char *rules;            // finance rules text, or NULL
+} ForecastRequest;
+
+static const JsonMember *member_find(const JsonMember *members, int count, const char *key) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(members[i].key, key) == 0) return &members[i];
+    }
+    return NULL;
+}
+
+// Reads a request body into req; 0, or -1 with a message.
+static int request_parse(const char *body, size_t size, ForecastRequest *req, char *error, size_t error_size) {
+    JsonMember members[REQUEST_MAX_KEYS];
+    int count = json_parse_object(body, size, members, REQUEST_MAX_KEYS, error, error_size);
+    if (count < 0) return -1;
+
+    memset(req, 0, sizeof(*req));
+    int status = 0;
+    int preset = 0;
+    const JsonMember *member = member_find(members, count, "preset");
+    if (member && member->type == JSON_STRING) {
+        for (preset = 0; preset < parameter_set_count; preset++) {
+            if (strcmp(parameter_set_names[preset], member->string) == 0) break;
+        }
+    } else if (member && member->type == JSON_NUMBER && member->number == floor(member->number)) {
+        preset = member->number >= 0 && member->number < parameter_set_count ? (int)member->number : -1;
+    } else if (member) {
+        preset = -1;
+    }
+    if (preset < 0 || preset >= parameter_set_count) {
+        snprintf(error, error_size, "unknown preset");
+        status = -1;
+    } else {
+        req->params = parameter_sets[preset];
+    }
+
+    for (int i = 0; i < count && status == 0; i++) {
+        member = &members[i];
+        if (strcmp(member->key, "preset") == 0) continue;
+        if (strcmp(member->key, "seed") == 0) {
+            // A string carries seeds past the 2^53 a JSON number holds exactly.
+            int valid = 0;
+            if (member->type == JSON_NUMBER) {
+                valid = member->number >= 0 && member->number < 18446744073709551616.0 &&
+                        member->number == floor(member->number);
+                if (valid) req->seed = (uint64_t)member->number;
+            } else if (member->type == JSON_STRING && member->string[0] >= '0' && member->string[0] <= '9') {
+                char *stop;
+                errno = 0;
+                req->seed = strtoull(member->string, &stop, 0);
+                valid = *stop == '\0' && errno == 0;
+            }
+            if (!valid) {
+                snprintf(error, error_size, "seed must be an unsigned 64-bit integer");
+                status = -1;
+            }
+        } else if (strcmp(member->key, "rules") == 0) {
+            if (member->type == JSON_STRING) {
+                free(req->rules);
+                req->rules = strdup(member->string);
+            } else if (member->type != JSON_NULL) {
+                snprintf(error, error_size, "rules must be a string");
+                status = -1;
+            }
+        } else {
+            const ParameterField *field = parameter_field_find(member->key);
+            if (!field) {
+                snprintf(error, error_size, "unknown field '%.64s'", member->key);
+                status = -1;
+            } else if (member->type != JSON_NUMBER) {
+                snprintf(error, error_size, "%s must be a number", field->name);
+                status = -1;
+            } else if (field->is_int && fabs(member->number) > INT_MAX) {
+                snprintf(error, error_size, "%s out of range", field->name);
+                status = -1;
+            } else {
+                parameter_set(&req->params, field, member->number);
+            }
+        }
+    }
+    members_free(members, count);
+    if (status != 0) {
+        free(req->rules);
+        req->rules = NULL;
+    }
+    return status;
+}
+
+// Canonical key of a request: every field as the engine sees it, the seed
+// and the rules text, so requests that only differ in how they name the run
+// share an entry. The text keeps its NUL, since empty rules are a model
+// with no revenue or costs rather than the built-in one.
+static unsigned char *request_key(const ForecastRequest *req, size_t *size) {
+    size_t rules_size = req->rules ? strlen(req->rules) + 1 : 0;
+    *size = parameter_field_count * sizeof(double) + sizeof(uint64_t) + rules_size;
+    unsigned char *key = malloc(*size);
+    if (!key) return NULL;
+    unsigned char *p = key;
+    for (int i = 0; i < parameter_field_count; i++) {
+        double value = parameter_get(&req->params, &parameter_fields[i]);
+        memcpy(p, &value, sizeof(value));
+        p += sizeof(value);
+    }
+    memcpy(p, &req->seed, sizeof(req->seed));
+    if (rules_size) memcpy(p + sizeof(req->seed), req->rules, rules_size);
+    return key;
+}
+
+// --- Responses -------------------------------------------------------------
+
+static void json_number(FILE *out, double value) {
+    if (isfinite(value)) fprintf(out, "%.17g", value);
+    else fputs("null", out);
+}
+
+static void json_quoted(FILE *out, const char *text) {
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+        if (*p == '"' || *p == '\\') fprintf(out, "\\%c", *p);
+        else if (*p < 0x20) fprintf(out, "\\u%04x", *p);
+        else fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+// Fields at the shortest precision that reads back as the same float, so
+// 0.12 is not echoed as 0.11999999731779099.
+static void json_params(FILE *out, const ParameterSet *params) {
+    fputc('{', out);
+    for (int i = 0; i < parameter_field_count; i++) {
+        double value = parameter_get(params, &parameter_fields[i]);
+        char text[32];
+        for (int digits = 6; digits <= 9; digits++) {
+            snprintf(text, sizeof(text), "%.*g", digits, value);
+            if ((float)strtod(text, NULL) == (float)value) break;
+        }
+        fprintf(out, "%s\"%s\": %s", i ? ", " : "", parameter_fields[i].name, text);
+    }
+    fputc('}', out);
+}
+
+static void json_series(FILE *out, const char *name, const double *values, int count) {
+    fprintf(out, ",\n\"%s\": [", name);
+    for (int i = 0; i < count; i++) {
+        if (i) fputc(',', out);
+        json_number(out, values[i]);
+    }
+    fputc(']', out);
+}
+
+static void json_result(FILE *out, const ForecastRequest *req, const ForecastResult *result) {
+    fprintf(out, "{\"seed\": %llu, \"months\": %d, \"iterations\": %d, \"step_months\": ",
+            (unsigned long long)req->seed, result->months, result->iterations);
+    json_number(out, parameter_step_months(&req->params));
+    fputs(",\n\"params\": ", out);
+    json_params(out, &req->params);
+#define JSON_SCALAR(name) fputs(",\n\"" #name "\": ", out); json_number(out, result->name);
+    JSON_SCALAR(total_net_profit)
+    JSON_SCALAR(roi)
+    JSON_SCALAR(risk_of_no_return)
+    JSON_SCALAR(avg_break_even_month)
+    JSON_SCALAR(profit_std_error)
+    JSON_SCALAR(risk_std_error)
+#undef JSON_SCALAR
+#define JSON_SERIES(name) json_series(out, #name, result->name, result->months);
+    FORECAST_RESULT_SERIES(JSON_SERIES)
+#undef JSON_SERIES
+    fputs(",\n\"break_even_histogram\": [", out);
+    for (int month = 0; month < result->months; month++) {
+        fprintf(out, "%s%d", month ? "," : "", result->break_even_histogram[month]);
+    }
+    fputs("]}\n", out);
+}
+
+static char *json_error(const char *message, size_t *size) {
+    char *body = NULL;
+    FILE *out = open_memstream(&body, size);
+    if (!out) return NULL;
+    fputs("{\"error\": ", out);
+    json_quoted(out, message);
+    fputs("}\n", out);
+    fclose(out);
+    return body;
+}
+
+// A run in flight for the requester on fd and any that coalesced onto its
+// entry. Once all of them have gone the run is cancelled and the entry
+// unlinked, so a later request starts afresh.
+typedef struct {
+    ResultCache *cache;
+    CacheEntry *entry;
+    int fd;
+    int gone;               // fd's client has left
+} RunWatch;
+
+static int watch_progress(void *ctx, const ForecastResult *partial) {
+    (void)partial;
+    RunWatch *watch = ctx;
+    ResultCache *cache = watch->cache;
+    pthread_mutex_lock(&cache->lock);
+    if (!watch->gone && client_gone(watch->fd)) {
+        watch->gone = 1;
+        watch->entry->clients--;
+    }
+    int cancel = watch->entry->clients == 0;
+    if (cancel && watch->entry->linked) {
+        cache_unlink(cache, watch->entry);
+        cache->cancelled++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return cancel;
+}
+
+// Runs req and returns its body and HTTP status.
+static char *run_forecast(Server *server, const ForecastRequest *req, RunWatch *watch, int *status, size_t *size) {
+    ForecastRules *rules = NULL;
+    char error[256];
+    if (req->rules && !(rules = forecast_rules_compile(req->rules, error, sizeof(error)))) {
+        char message[300];
+        snprintf(message, sizeof(message), "rules: %s", error);
+        *status = 400;
+        return json_error(message, size);
+    }
+    ForecastOptions options = {server->pool, req->seed};
+    options.rules = rules;
+    options.progress = watch_progress;
+    options.progress_ctx = watch;
+    ForecastResult result;
+    int run_status = forecast_run(&req->params, &options, &result);
+    forecast_rules_free(rules);
+    if (run_status == FORECAST_CANCELLED) {
+        *status = 503;
+        return json_error("cancelled: no client is waiting", size);
+    }
+    if (run_status != 0) {
+        *status = 400;
+        return json_error("forecast failed: invalid parameters or out of memory", size);
+    }
+
+    char *body = NULL;
+    FILE *out = open_memstream(&body, size);
+    if (out) {
+        json_result(out, req, &result);
+        fclose(out);
+    }
+    forecast_result_free(&result);
+    *status = 200;
+    return body;
+}
+
+// --- HTTP ------------------------------------------------------------------
+
+typedef struct {
+    int status;
+    char *body;             // owned unless entry is set
+    size_t body_size;
+    CacheEntry *entry;      // cached body, released after sending
+    const char *cache;      // X-Forecast-Cache value, or NULL
+} Response;
+
+static const char *status_text(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 400: return "Bad Request";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 503: return "Service Unavailable";
+    default: return "Internal Server Error";
+    }
+}
+
+static void respond_error(Response *response, int status, const char *message) {
+    response->status = status;
+    response->body = json_error(message, &response->body_size);
+}
+
+// Answers a forecast request from the client on fd; -1 if the client went
+// away before it was answered.
+static int handle_forecast(Server *server, int fd, const char *body, size_t size, Response *response) {
+    ForecastRequest req;
+    char error[128];
+    if (request_parse(body, size, &req, error, sizeof(error)) != 0) {
+        respond_error(response, 400, error);
+        return 0;
+    }
+    if ((double)req.params.iterations * req.params.months > server->budget) {
+        free(req.rules);
+        snprintf(error, sizeof(error), "iterations x months exceeds the budget of %.0f path-months", server->budget);
+        respond_error(response, 413, error);
+        return 0;
+    }
+    size_t key_size;
+    unsigned char *key = request_key(&req, &key_size);
+    LookupOutcome outcome = LOOKUP_MISS;
+    CacheEntry *entry = key ? cache_lookup(&server->cache, key, key_size, fd, &outcome) : NULL;
+    if (!entry) {
+        free(req.rules);
+        if (outcome == LOOKUP_ABANDONED) return -1;
+        respond_error(response, 500, "out of memory");
+        return 0;
+    }
+    if (outcome == LOOKUP_MISS) {
+        int status;
+        size_t body_size = 0;
+        RunWatch watch = {&server->cache, entry, fd, 0};
+        char *result = run_forecast(server, &req, &watch, &status, &body_size);
+        if (!result) {
+            status = 500;
+            result = json_error("out of memory", &body_size);
+        }
+        cache_settle(&server->cache, entry, status, result, body_size);
+    }
+    free(req.rules);
+    response->status = entry->status;
+    response->body = entry->body;
+    response->body_size = entry->body_size;
+    response->entry = entry;
+    response->cache = lookup_names[outcome];
+    return 0;
+}
+
+static void handle_presets(Response *response) {
+    FILE *out = open_memstream(&response->body, &response->body_size);
+    if (!out) return;
+    fputs("{\"presets\": [", out);
+    for (int i = 0; i < parameter_set_count; i++) {
+        fprintf(out, "%s\n{\"preset\": %d, \"name\": ", i ? "," : "", i);
+        json_quoted(out, parameter_set_names[i]);
+        fputs(", \"params\": ", out);
+        json_params(out, &parameter_sets[i]);
+        fputc('}', out);
+    }
+    fputs("]}\n", out);
+    fclose(out);
+    response->status = 200;
+}
+
+static void handle_stats(Server *server, Response *response) {
+    ResultCache *cache = &server->cache;
+    FILE *out = open_memstream(&response->body, &response->body_size);
+    if (!out) return;
+    pthread_mutex_lock(&cache->lock);
+    fprintf(out, "{\"entries\": %zu, \"bytes\": %zu, \"capacity\": %zu, \"hits\": %llu, \"misses\": %llu, "
+            "\"coalesced\": %llu, \"cancelled\": %llu, \"threads\": %d}\n", cache->entries, cache->bytes,
+            cache->capacity, cache->hits, cache->misses, cache->coalesced, cache->cancelled,
+            forecast_pool_threads(server->pool));
+    pthread_mutex_unlock(&cache->lock);
+    fclose(out);
+    response->status = 200;
+}
+
+static int write_all(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    return 0;
+}
+
+// Header and body in one writev, so a kept-alive connection is not held up
+// by Nagle's algorithm between them.
+static int send_response(int fd, const Server *server, const Response *response, int keep_alive) {
+    char header[512 + SERVER_ORIGIN_MAX];
+    int length = snprintf(header, sizeof(header),
+                          "HTTP/1.1 %d %s\r\n"
+                          "Content-Type: application/json\r\n"
+                          "Content-Length: %zu\r\n"
+                          "Access-Control-Allow-Origin: %s\r\n"
+                          "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
+                          "Access-Control-Allow-Headers: Content-Type\r\n"
+                          "%s%s%s"
+                          "Connection: %s\r\n\r\n",
+                          response->status, status_text(response->status), response->body_size,
+                          server->origin, response->cache ? "X-Forecast-Cache: " : "", response->cache ? response->cache : "",
+                          response->cache ? "\r\n" : "", keep_alive ? "keep-alive" : "close");
+    struct iovec iov[2] = {{header, length}, {response->body, response->body_size}};
+    return write_all(fd, iov, response->body_size ? 2 : 1);
+}
+
+// Value of header `name` in the header block, or NULL.
+static const char *header_value(const char *headers, const char *name, size_t *length) {
+    size_t name_length = strlen(name);
+    for (const char *line = strstr(headers, "\r\n"); line; line = strstr(line, "\r\n")) {
+        line += 2;
+        if (strncasecmp(line, name, name_length) == 0 && line[name_length] == ':') {
+            const char *value = line + name_length + 1;
+            while (*value == ' ' || *value == '\t') value++;
+            const char *end = strstr(value, "\r\n");
+            *length = end ? (size_t)(end - value) : strlen(value);
+            return value;
+        }
+    }
+    return NULL;
+}
+
+typedef struct {
+    Server *server;
+    int fd;
+} Connection;
+
+// Serves the requests of one connection until the client closes it, asks
+// to, or stays idle past SERVER_IDLE_SECONDS.
+static void *serve_connection(void *arg) {
+    Connection *connection = arg;
+    Server *server = connection->server;
+    int fd = connection->fd;
+    free(connection);
+
+    char *buffer = malloc(REQUEST_MAX_HEADER + REQUEST_MAX_BODY + 1);
+    size_t filled = 0;
+    int keep_alive = buffer != NULL;
+    while (keep_alive) {
+        // Header block.
+        char *header_end = NULL;
+        while (!(header_end = filled ? strstr(buffer, "\r\n\r\n") : NULL)) {
+            if (filled >= REQUEST_MAX_HEADER) break;
+            ssize_t got = read(fd, buffer + filled, REQUEST_MAX_HEADER - filled);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) break;
+            filled += got;
+            buffer[filled] = '\0';
+        }
+        if (!header_end) break;
+        *header_end = '\0';
+        size_t header_size = header_end + 4 - buffer;
+
+        char method[8], path[64];
+        int minor = 0;
+        if (sscanf(buffer, "%7s %63s HTTP/1.%d", method, path, &minor) != 3) break;
+        size_t length;
+        const char *value = header_value(buffer, "Connection", &length);
+        keep_alive = minor >= 1;
+        if (value && length == 5 && strncasecmp(value, "close", 5) == 0) keep_alive = 0;
+        if (value && length == 10 && strncasecmp(value, "keep-alive", 10) == 0) keep_alive = 1;
+        value = header_value(buffer, "Content-Length", &length);
+        long long content_length = value ? strtoll(value, NULL, 10) : 0;
+
+        Response response = {0};
+        if (content_length < 0 || content_length > REQUEST_MAX_BODY) {
+            respond_error(&response, 413, "request too large");
+            keep_alive = 0;
+        } else {
+            // Body, after whatever of it came with the header.
+            size_t want = header_size + content_length;
+            while (filled < want) {
+                ssize_t got = read(fd, buffer + filled, want - filled);
+                if (got < 0 && errno == EINTR) continue;
+                if (got <= 0) break;
+                filled += got;
+            }
+            if (filled < want) break;
+            const char *body = buffer + header_size;
+            // Clients other than browsers send no Origin.
+            value = header_value(buffer, "Origin", &length);
+            int foreign = value && !(length == strlen(server->origin) && strncmp(value, server->origin, length) == 0);
+
+            if (foreign) {
+                respond_error(&response, 403, "origin not allowed");
+            } else if (strcmp(method, "OPTIONS") == 0) {
+                response.status = 204;
+            } else if (strcmp(path, "/forecast") == 0) {
+                if (strcmp(method, "POST") != 0) {
+                    respond_error(&response, 405, "POST a JSON request to /forecast");
+                } else if (handle_forecast(server, fd, body, content_length, &response) != 0) {
+                    break;
+                }
+            } else if (strcmp(path, "/presets") == 0 && strcmp(method, "GET") == 0) {
+                handle_presets(&response);
+            } else if (strcmp(path, "/stats") == 0 && strcmp(method, "GET") == 0) {
+                handle_stats(server, &response);
+            } else {
+                respond_error(&response, 404, "not found");
+            }
+            // Keep what the client pipelined after this request.
+            memmove(buffer, buffer + want, filled - want);
+            filled -= want;
+            buffer[filled] = '\0';
+        }
+        if (response.status == 0) respond_error(&response, 500, "out of memory");
+        if (send_response(fd, server, &response, keep_alive) != 0) keep_alive = 0;
+        if (response.entry) cache_release(&server->cache, response.entry);
+        else free(response.body);
+    }
+    free(buffer);
+    close(fd);
+    return NULL;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-p port | -U socket] [-t threads] [-c cache_mb] [-b path_months] [-O origin]\n",
+            prog);
+}
+
+// Binds the listening socket: localhost:port, or a Unix socket at path,
+// replacing a stale socket file.
+static int listen_on(int port, const char *socket_path) {
+    int fd;
+    if (socket_path) {
+        struct sockaddr_un address = {.sun_family = AF_UNIX};
+        if (strlen(socket_path) >= sizeof(address.sun_path)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        strcpy(address.sun_path, socket_path);
+        struct stat st;
+        if (stat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(socket_path);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0) goto fail;
+    } else {
+        struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(port),
+                                      .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+        int on = 1;
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0) goto fail;
+    }
+    if (listen(fd, 64) == 0) return fd;
+fail:
+    if (fd >= 0) close(fd);
+    return -1;
+}
+
+int main(int argc, char **argv) {
+    int port = SERVER_DEFAULT_PORT;
+    const char *socket_path = NULL;
+    int threads = 0;
+    long cache_mb = SERVER_DEFAULT_CACHE_MB;
+    double budget = SERVER_DEFAULT_BUDGET;
+    const char *origin = SERVER_DEFAULT_ORIGIN;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:U:t:c:b:O:h")) != -1) {
+        switch (opt) {
+        case 'p': port = atoi(optarg); break;
+        case 'U': socket_path = optarg; break;
+        case 't': threads = atoi(optarg); break;
+        case 'c': cache_mb = atol(optarg); break;
+        case 'b': budget = atof(optarg); break;
+        case 'O': origin = optarg; break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (port <= 0 || port > 65535 || cache_mb < 0 || !(budget > 0) || !*origin ||
+        strlen(origin) >= SERVER_ORIGIN_MAX || strpbrk(origin, "\r\n")) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int listener = listen_on(port, socket_path);
+    if (listener < 0) {
+        perror(socket_path ? socket_path : "listen");
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    Server server;
+    server.pool = forecast_pool_create(threads);
+    server.budget = budget;
+    server.origin = origin;
+    cache_init(&server.cache, (size_t)cache_mb << 20);
+    if (socket_path) {
+        fprintf(stderr, "serving on %s (%d threads, %ld MiB cache)\n", socket_path,
+                forecast_pool_threads(server.pool), cache_mb);
+    } else {
+        fprintf(stderr, "serving on http://127.0.0.1:%d (%d threads, %ld MiB cache)\n", port,
+                forecast_pool_threads(server.pool), cache_mb);
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (;;) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED || errno == EMFILE || errno == ENFILE) continue;
+            perror("accept");
+            break;
+        }
+        struct timeval idle = {SERVER_IDLE_SECONDS, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+        if (!socket_path) {
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        }
+        Connection *connection = malloc(sizeof(Connection));
+        pthread_t thread;
+        if (connection) {
+            connection->server = &server;
+            connection->fd = fd;
+        }
+        if (!connection || pthread_create(&thread, &attr, serve_connection, connection) != 0) {
+            free(connection);
+            close(fd);
+        }
+    }
+    close(listener);
+    forecast_pool_destroy(server.pool);
+    return 1;
+}
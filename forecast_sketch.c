@@ -0,0 +1,139 @@
+#include <math.h>
+#include <string.h>
+
+#include "forecast_sketch.h"
+
+// Labels stay well inside int64_t and exact as doubles.
+#define SKETCH_MAX_LABEL 0x1p52
+
+void sketch_reset(QuantileSketch *sketch) {
+    memset(sketch, 0, sizeof(*sketch));
+    sketch->exponent = SKETCH_MIN_EXPONENT;
+    sketch->scale = ldexp(1, -SKETCH_MIN_EXPONENT);
+}
+
+static int64_t floor_label(double x, double scale) {
+    double y = x * scale;
+    int64_t label = (int64_t)y;
+    return label - (y < label);
+}
+
+// floor(label / 2^shift) for negative labels too.
+static int64_t coarser_label(int64_t label, int shift) {
+    return label >= 0 ? label >> shift : -((-label - 1) >> shift) - 1;
+}
+
+// Smallest exponent from `exponent` up at which [min, max] fits the bins.
+static int fit_exponent(double min, double max, int exponent) {
+    for (;; exponent++) {
+        double scale = ldexp(1, -exponent);
+        if (fabs(min * scale) < SKETCH_MAX_LABEL && fabs(max * scale) < SKETCH_MAX_LABEL &&
+            floor_label(max, scale) - floor_label(min, scale) < SKETCH_BINS) {
+            return exponent;
+        }
+    }
+}
+
+// Adds the bins of `from` to `bins`, which has the given exponent and origin.
+static void add_relabelled(uint32_t *bins, int exponent, int64_t origin, const QuantileSketch *from) {
+    int shift = exponent - from->exponent;
+    for (int b = 0; b < SKETCH_BINS; b++) {
+        if (from->bins[b]) {
+            bins[coarser_label(from->origin + b, shift) - origin] += from->bins[b];
+        }
+    }
+}
+
+// Rebins `sketch` (and `other`, if any) into the smallest exponent that fits
+// [min, max], centring the range in the bins so that a few more values
+// outside it do not need another pass.
+static void rebin(QuantileSketch *sketch, const QuantileSketch *other, double min, double max) {
+    int exponent = sketch->exponent;
+    if (other && other->exponent > exponent) exponent = other->exponent;
+    exponent = fit_exponent(min, max, exponent);
+    double scale = ldexp(1, -exponent);
+    int64_t low = floor_label(min, scale);
+    int64_t span = floor_label(max, scale) - low;
+    int64_t origin = low - (SKETCH_BINS - 1 - span) / 2;
+
+    uint32_t bins[SKETCH_BINS] = {0};
+    if (sketch->count > 0) add_relabelled(bins, exponent, origin, sketch);
+    if (other) add_relabelled(bins, exponent, origin, other);
+    memcpy(sketch->bins, bins, sizeof(bins));
+    sketch->exponent = exponent;
+    sketch->scale = scale;
+    sketch->origin = origin;
+    sketch->min = min;
+    sketch->max = max;
+}
+
+void sketch_push_grow(QuantileSketch *sketch, double x) {
+    if (!isfinite(x)) return;
+    double min = sketch->count > 0 && sketch->min < x ? sketch->min : x;
+    double max = sketch->count > 0 && sketch->max > x ? sketch->max : x;
+    rebin(sketch, NULL, min, max);
+    sketch->bins[floor_label(x, sketch->scale) - sketch->origin]++;
+    sketch->count++;
+}
+
+void sketch_add(QuantileSketch *sketch, const double *values, int count) {
+    if (count == 0) return;
+    double min = values[0];
+    double max = values[0];
+    for (int i = 1; i < count; i++) {
+        min = values[i] < min ? values[i] : min;
+        max = values[i] > max ? values[i] : max;
+    }
+    if (!isfinite(min) || !isfinite(max)) {
+        for (int i = 0; i < count; i++) {
+            sketch_push(sketch, values[i]);
+        }
+        return;
+    }
+
+    if (sketch->count > 0) {
+        if (sketch->min < min) min = sketch->min;
+        if (sketch->max > max) max = sketch->max;
+    }
+    if (sketch->count == 0 || fabs(min * sketch->scale) >= SKETCH_MAX_LABEL ||
+        fabs(max * sketch->scale) >= SKETCH_MAX_LABEL || floor_label(min, sketch->scale) < sketch->origin ||
+        floor_label(max, sketch->scale) - sketch->origin >= SKETCH_BINS) {
+        rebin(sketch, NULL, min, max);
+    }
+    for (int i = 0; i < count; i++) {
+        sketch->bins[floor_label(values[i], sketch->scale) - sketch->origin]++;
+    }
+    sketch->count += count;
+    sketch->min = min;
+    sketch->max = max;
+}
+
+void sketch_merge(QuantileSketch *into, const QuantileSketch *from) {
+    if (from->count == 0) return;
+    if (into->count == 0) {
+        *into = *from;
+        return;
+    }
+    double min = into->min < from->min ? into->min : from->min;
+    double max = into->max > from->max ? into->max : from->max;
+    rebin(into, from, min, max);
+    into->count += from->count;
+}
+
+double sketch_quantile(const QuantileSketch *sketch, double q) {
+    if (sketch->count == 0) return NAN;
+    double target = q * sketch->count;
+    double width = ldexp(1, sketch->exponent);
+    double below = 0;
+    for (int b = 0; b < SKETCH_BINS; b++) {
+        uint32_t count = sketch->bins[b];
+        if (count > 0 && below + count >= target) {
+            double value = ldexp((double)(sketch->origin + b), sketch->exponent) + (target - below) / count * width;
+            if (value < sketch->min) value = sketch->min;
+            if (value > sketch->max) value = sketch->max;
+            return value;
+        }
+        below += count;
+    }
+    return sketch->max;
+}
@@ -0,0 +1,58 @@
+#ifndef FORECAST_SKETCH_H
+#define FORECAST_SKETCH_H
+
+#include <stdint.h>
+
+// Quantile sketch over SKETCH_BINS equal bins of width 2^exponent, aligned
+// to multiples of the width. The exponent is always the smallest (down to
+// SKETCH_MIN_EXPONENT) at which [min, max] fits the bins, and a bin count is
+// the exact number of values in that bin, so the sketch of a set of values
+// is the same whatever order they were pushed or merged in. Memory is fixed;
+// a quantile is off by at most 2 (max - min) / SKETCH_BINS, usually far
+// less after interpolation within the bin.
+#define SKETCH_BINS 1024
+#define SKETCH_MIN_EXPONENT -10
+
+typedef struct {
+    int exponent;
+    double scale;           // 2^-exponent
+    int64_t origin;         // label of bins[0]; bin b covers [b, b + 1) * 2^exponent
+    int64_t count;
+    double min;
+    double max;
+    uint32_t bins[SKETCH_BINS];
+} QuantileSketch;
+
+void sketch_reset(QuantileSketch *sketch);
+// Rebins until x fits, then counts it; ignores NAN and infinities. Slow
+// path of sketch_push().
+void sketch_push_grow(QuantileSketch *sketch, double x);
+// Counts `count` values at once: one range check for all of them, then a
+// plain increment per value. Same result as pushing them one by one.
+void sketch_add(QuantileSketch *sketch, const double *values, int count);
+void sketch_merge(QuantileSketch *into, const QuantileSketch *from);
+
+// Value at quantile q in [0, 1], interpolated linearly within its bin and
+// clamped to the exact min and max. NAN on an empty sketch.
+double sketch_quantile(const QuantileSketch *sketch, double q);
+
+static inline void sketch_push(QuantileSketch *sketch, double x) {
+    double y = x * sketch->scale;
+    if (!(y > -0x1p52 && y < 0x1p52)) {
+        sketch_push_grow(sketch, x);
+        return;
+    }
+    int64_t label = (int64_t)y;
+    label -= y < label;
+    uint64_t index = (uint64_t)(label - sketch->origin);
+    if (index >= SKETCH_BINS || sketch->count == 0) {
+        sketch_push_grow(sketch, x);
+        return;
+    }
+    sketch->bins[index]++;
+    sketch->count++;
+    if (x < sketch->min) sketch->min = x;
+    if (x > sketch->max) sketch->max = x;
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef FORECAST_STATS_H
+#define FORECAST_STATS_H
+
+#include <math.h>
+
+// Running mean/variance (Welford), mergeable with Chan's pairwise update so
+// partial results from different workers combine without revisiting paths.
+typedef struct {
+    double count;
+    double mean;
+    double m2;
+} RunningMoments;
+
+static inline void moments_push(RunningMoments *m, double x) {
+    m->count += 1;
+    double delta = x - m->mean;
+    m->mean += delta / m->count;
+    m->m2 += delta * (x - m->mean);
+}
+
+static inline void moments_merge(RunningMoments *into, const RunningMoments *from) {
+    if (from->count == 0) return;
+    if (into->count == 0) {
+        *into = *from;
+        return;
+    }
+    double count = into->count + from->count;
+    double delta = from->mean - into->mean;
+    into->mean += delta * from->count / count;
+    into->m2 += from->m2 + delta * delta * into->count * from->count / count;
+    into->count = count;
+}
+
+// Population standard deviation, matching np.std().
+static inline double moments_std(const RunningMoments *m) {
+    return m->count > 0 ? sqrt(m->m2 / m->count) : 0;
+}
+
+#endif
@@ -0,0 +1,309 @@
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "forecast_store.h"
+
+#define STORE_SERIES_ALIGN 64
+#define STORE_PAGE 4096
+
+typedef struct {
+    const char *name;
+    size_t offset;
+} SeriesField;
+
+#define SERIES_FIELD(name) {#name, offsetof(ForecastResult, name)},
+
+static const SeriesField series_fields[] = {
+    FORECAST_RESULT_SERIES(SERIES_FIELD)
+};
+
+#undef SERIES_FIELD
+
+#define SERIES_FIELD_COUNT ((int)(sizeof(series_fields) / sizeof(series_fields[0])))
+#define HISTOGRAM_SERIES "break_even_histogram"
+
+static uint64_t align_up(uint64_t offset, uint64_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+static int write_zeros(FILE *file, uint64_t bytes) {
+    static const char zeros[STORE_PAGE];
+    while (bytes > 0) {
+        size_t n = bytes < sizeof(zeros) ? (size_t)bytes : sizeof(zeros);
+        if (fwrite(zeros, 1, n, file) != n) return -1;
+        bytes -= n;
+    }
+    return 0;
+}
+
+// Pads the file from `offset` to `target`.
+static int pad_to(FILE *file, uint64_t *offset, uint64_t target) {
+    int failed = write_zeros(file, target - *offset) != 0;
+    *offset = target;
+    return failed;
+}
+
+static int write_block(FILE *file, uint64_t *offset, const void *data, size_t size) {
+    *offset += size;
+    return fwrite(data, 1, size, file) != size;
+}
+
+// Writes every path, a chunk at a time, each month row padded to the
+// chunk width so a partial last chunk keeps the layout.
+static int write_paths(FILE *file, uint64_t *offset, const StoreFileHeader *header, const ParameterSet *params,
+                       const ForecastOptions *options) {
+    int months = params->months;
+    int chunk = header->path_chunk;
+    double *users = malloc((size_t)months * chunk * sizeof(double));
+    double *profit = malloc((size_t)months * chunk * sizeof(double));
+    int32_t *break_even = malloc((size_t)chunk * sizeof(int32_t));
+    int *months_out = malloc((size_t)chunk * sizeof(int));
+    int failed = !users || !profit || !break_even || !months_out;
+
+    for (uint64_t first = 0; first < header->iterations && !failed; first += chunk) {
+        int count = header->iterations - first < (uint64_t)chunk ? (int)(header->iterations - first) : chunk;
+        uint64_t chunk_start = *offset;
+        failed = forecast_simulate_paths(params, options, (int)first, count, users, profit, months_out) != 0;
+        for (int month = 0; month < months && !failed; month++) {
+            failed = write_block(file, offset, users + (size_t)month * count, count * sizeof(double)) ||
+                     pad_to(file, offset, *offset + (uint64_t)(chunk - count) * sizeof(double));
+        }
+        for (int month = 0; month < months && !failed; month++) {
+            failed = write_block(file, offset, profit + (size_t)month * count, count * sizeof(double)) ||
+                     pad_to(file, offset, *offset + (uint64_t)(chunk - count) * sizeof(double));
+        }
+        for (int i = 0; i < count; i++) {
+            break_even[i] = months_out[i];
+        }
+        failed = failed || write_block(file, offset, break_even, count * sizeof(int32_t)) ||
+                 pad_to(file, offset, chunk_start + header->chunk_size);
+    }
+
+    free(users);
+    free(profit);
+    free(break_even);
+    free(months_out);
+    return failed;
+}
+
+int forecast_store_write(const char *path, const ParameterSet *params, const ForecastOptions *options,
+                         const ForecastResult *result, int with_paths) {
+    if (result->months != params->months) return -1;
+    FILE *file = fopen(path, "wb");
+    if (!file) return -1;
+
+    int months = result->months;
+    StoreFileHeader header = {{0}};
+    memcpy(header.magic, STORE_FILE_MAGIC, sizeof(STORE_FILE_MAGIC));
+    header.version = STORE_FILE_VERSION;
+    header.header_size = sizeof(header);
+    header.months = months;
+    header.parameter_count = parameter_field_count;
+    header.series_count = SERIES_FIELD_COUNT + 1;
+    header.iterations = result->iterations;
+    header.seed = options ? options->seed : 0;
+    header.total_net_profit = result->total_net_profit;
+    header.roi = result->roi;
+    header.risk_of_no_return = result->risk_of_no_return;
+    header.avg_break_even_month = result->avg_break_even_month;
+    header.parameters_offset = sizeof(header);
+    header.series_offset = header.parameters_offset + header.parameter_count * sizeof(StoreParameter);
+
+    // Series offsets, then where the paths start.
+    StoreSeries series[SERIES_FIELD_COUNT + 1];
+    uint64_t offset = header.series_offset + header.series_count * sizeof(StoreSeries);
+    memset(series, 0, sizeof(series));
+    for (uint32_t i = 0; i < header.series_count; i++) {
+        int histogram = i == SERIES_FIELD_COUNT;
+        strncpy(series[i].name, histogram ? HISTOGRAM_SERIES : series_fields[i].name, sizeof(series[i].name) - 1);
+        series[i].type = histogram ? STORE_SERIES_I32 : STORE_SERIES_F64;
+        series[i].offset = offset = align_up(offset, STORE_SERIES_ALIGN);
+        offset += (uint64_t)months * (histogram ? sizeof(int32_t) : sizeof(double));
+    }
+    if (with_paths) {
+        header.path_chunk = STORE_PATH_CHUNK;
+        header.chunk_size = align_up((uint64_t)STORE_PATH_CHUNK * (2 * months * sizeof(double) + sizeof(int32_t)),
+                                     STORE_PAGE);
+        header.paths_offset = align_up(offset, STORE_PAGE);
+    }
+
+    offset = 0;
+    int failed = write_block(file, &offset, &header, sizeof(header));
+    for (int i = 0; i < parameter_field_count && !failed; i++) {
+        StoreParameter parameter = {{0}, parameter_get(params, &parameter_fields[i])};
+        strncpy(parameter.name, parameter_fields[i].name, sizeof(parameter.name) - 1);
+        failed = write_block(file, &offset, &parameter, sizeof(parameter));
+    }
+    failed = failed || write_block(file, &offset, series, header.series_count * sizeof(StoreSeries));
+    for (int i = 0; i < SERIES_FIELD_COUNT && !failed; i++) {
+        const double *values = *(double *const *)((const char *)result + series_fields[i].offset);
+        failed = pad_to(file, &offset, series[i].offset) || write_block(file, &offset, values, months * sizeof(double));
+    }
+    if (!failed) {
+        int32_t *histogram = malloc(months * sizeof(int32_t));
+        failed = !histogram;
+        for (int month = 0; month < months && !failed; month++) {
+            histogram[month] = result->break_even_histogram[month];
+        }
+        failed = failed || pad_to(file, &offset, series[SERIES_FIELD_COUNT].offset) ||
+                 write_block(file, &offset, histogram, months * sizeof(int32_t));
+        free(histogram);
+    }
+    if (with_paths && !failed) {
+        failed = pad_to(file, &offset, header.paths_offset) || write_paths(file, &offset, &header, params, options);
+    }
+
+    if (fclose(file) != 0) failed = 1;
+    if (failed) remove(path);
+    return failed ? -1 : 0;
+}
+
+// Nonzero when [offset, offset + size) lies inside the mapping.
+static int in_map(const ForecastStore *store, uint64_t offset, uint64_t size) {
+    return offset <= store->size && size <= store->size - offset;
+}
+
+static int store_map(ForecastStore *store) {
+    const StoreFileHeader *h = store->header;
+    if (store->size < sizeof(*h) || memcmp(h->magic, STORE_FILE_MAGIC, sizeof(STORE_FILE_MAGIC)) != 0 ||
+        h->version != STORE_FILE_VERSION || h->header_size != sizeof(*h) || h->months < 1 || h->iterations < 1 ||
+        h->iterations > INT32_MAX ||
+        !in_map(store, h->parameters_offset, (uint64_t)h->parameter_count * sizeof(StoreParameter)) ||
+        !in_map(store, h->series_offset, (uint64_t)h->series_count * sizeof(StoreSeries))) {
+        return -1;
+    }
+
+    const StoreParameter *parameters = (const StoreParameter *)((const char *)store->map + h->parameters_offset);
+    for (uint32_t i = 0; i < h->parameter_count; i++) {
+        char name[sizeof(parameters[i].name) + 1] = {0};
+        memcpy(name, parameters[i].name, sizeof(parameters[i].name));
+        const ParameterField *field = parameter_field_find(name);
+        if (field) parameter_set(&store->params, field, parameters[i].value);
+    }
+
+    // Every series the result needs must be there; unknown ones are skipped.
+    const StoreSeries *series = (const StoreSeries *)((const char *)store->map + h->series_offset);
+    ForecastResult *r = &store->result;
+    r->months = h->months;
+    r->iterations = (int)h->iterations;
+    for (uint32_t i = 0; i < h->series_count; i++) {
+        int i32 = series[i].type == STORE_SERIES_I32;
+        uint64_t size = (uint64_t)h->months * (i32 ? sizeof(int32_t) : sizeof(double));
+        if (!in_map(store, series[i].offset, size) || series[i].offset % STORE_SERIES_ALIGN != 0) return -1;
+        void *values = (char *)store->map + series[i].offset;
+        if (i32 && strncmp(series[i].name, HISTOGRAM_SERIES, sizeof(series[i].name)) == 0) {
+            r->break_even_histogram = values;
+            continue;
+        }
+        for (int f = 0; f < SERIES_FIELD_COUNT && !i32; f++) {
+            if (strncmp(series[i].name, series_fields[f].name, sizeof(series[i].name)) == 0) {
+                *(double **)((char *)r + series_fields[f].offset) = values;
+            }
+        }
+    }
+    if (!r->break_even_histogram) return -1;
+    for (int f = 0; f < SERIES_FIELD_COUNT; f++) {
+        if (!*(double **)((char *)r + series_fields[f].offset)) return -1;
+    }
+    r->total_net_profit = h->total_net_profit;
+    r->roi = h->roi;
+    r->risk_of_no_return = h->risk_of_no_return;
+    r->avg_break_even_month = h->avg_break_even_month;
+    r->profit_std_error = NAN;     // not stored
+    r->risk_std_error = NAN;
+    store->seed = h->seed;
+
+    if (h->path_chunk > 0) {
+        uint64_t chunks = (h->iterations + h->path_chunk - 1) / h->path_chunk;
+        uint64_t min_chunk = (uint64_t)h->path_chunk * (2 * h->months * sizeof(double) + sizeof(int32_t));
+        if (h->chunk_size < min_chunk || h->paths_offset % STORE_PAGE != 0 || h->paths_offset > store->size ||
+            chunks > (store->size - h->paths_offset) / h->chunk_size) {
+            return -1;
+        }
+        // Viewers jump between chunks; readahead would only page in paths
+        // nobody looks at.
+        madvise((char *)store->map + h->paths_offset, chunks * h->chunk_size, MADV_RANDOM);
+    }
+    return 0;
+}
+
+int forecast_store_open(ForecastStore *store, const char *path) {
+    memset(store, 0, sizeof(*store));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    store->map = map;
+    store->size = st.st_size;
+    store->header = map;
+    if (store_map(store) != 0) {
+        forecast_store_close(store);
+        return -1;
+    }
+    return 0;
+}
+
+void forecast_store_close(ForecastStore *store) {
+    if (store->map) munmap(store->map, store->size);
+    memset(store, 0, sizeof(*store));
+}
+
+int forecast_store_has_paths(const ForecastStore *store) {
+    return store->header && store->header->path_chunk > 0;
+}
+
+// Start of the chunk holding path.
+static const char *chunk_of(const ForecastStore *store, int path) {
+    const StoreFileHeader *h = store->header;
+    return (const char *)store->map + h->paths_offset + (uint64_t)(path / h->path_chunk) * h->chunk_size;
+}
+
+int forecast_store_month(const ForecastStore *store, int month, int first, const double **users,
+                         const double **profit) {
+    if (!forecast_store_has_paths(store) || month < 0 || month >= (int)store->header->months || first < 0 ||
+        first >= store->result.iterations) {
+        return 0;
+    }
+    const StoreFileHeader *h = store->header;
+    int chunk = h->path_chunk;
+    int in_chunk = first % chunk;
+    const double *rows = (const double *)chunk_of(store, first);
+    if (users) *users = rows + (size_t)month * chunk + in_chunk;
+    if (profit) *profit = rows + (size_t)(h->months + month) * chunk + in_chunk;
+    int count = chunk - in_chunk;
+    return first + count > store->result.iterations ? store->result.iterations - first : count;
+}
+
+int forecast_store_path(const ForecastStore *store, int path, double *users, double *profit,
+                        int *break_even_month) {
+    if (!forecast_store_has_paths(store) || path < 0 || path >= store->result.iterations) {
+        return -1;
+    }
+    const StoreFileHeader *h = store->header;
+    int chunk = h->path_chunk;
+    int months = h->months;
+    int in_chunk = path % chunk;
+    const double *rows = (const double *)chunk_of(store, path);
+    for (int month = 0; month < months; month++) {
+        if (users) users[month] = rows[(size_t)month * chunk + in_chunk];
+        if (profit) profit[month] = rows[(size_t)(months + month) * chunk + in_chunk];
+    }
+    if (break_even_month) {
+        const int32_t *break_even = (const int32_t *)(rows + (size_t)2 * months * chunk);
+        *break_even_month = break_even[in_chunk];
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+#ifndef FORECAST_STORE_H
+#define FORECAST_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "forecast_core.h"
+
+// Result file laid out for mmap(), so a past run reopens without being
+// recomputed and a viewer pages in only what it shows. Host byte order:
+//   StoreFileHeader
+//   StoreParameter[parameter_count]    every ParameterSet field, by name
+//   StoreSeries[series_count]          the per-month ForecastResult arrays
+//   series data, each on a 64-byte boundary
+//   optional raw paths from paths_offset, page aligned: chunks of
+//   path_chunk paths, chunk_size bytes apart, each holding users and
+//   cumulative profit as [month][path_chunk] doubles, then the break-even
+//   month of every path as int32
+#define STORE_FILE_MAGIC "FCSTORE"
+#define STORE_FILE_VERSION 1
+#define STORE_PATH_CHUNK 4096
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t months;
+    uint32_t parameter_count;
+    uint32_t series_count;
+    uint32_t path_chunk;            // 0 without raw paths
+    uint64_t iterations;
+    uint64_t seed;
+    uint64_t parameters_offset;
+    uint64_t series_offset;
+    uint64_t paths_offset;
+    uint64_t chunk_size;
+    double total_net_profit;
+    double roi;
+    double risk_of_no_return;
+    double avg_break_even_month;
+} StoreFileHeader;
+
+typedef struct {
+    char name[40];
+    double value;
+} StoreParameter;
+
+enum {
+    STORE_SERIES_F64,
+    STORE_SERIES_I32
+};
+
+typedef struct {
+    char name[48];
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+} StoreSeries;
+
+// Writes params and result, and with with_paths every path of the run,
+// regenerated a chunk at a time on options->pool from options->seed.
+// 0 on success.
+int forecast_store_write(const char *path, const ParameterSet *params, const ForecastOptions *options,
+                         const ForecastResult *result, int with_paths);
+
+// An open store. The result's arrays point into the read-only mapping and
+// stay valid until forecast_store_close(); never free or write them.
+typedef struct {
+    void *map;
+    size_t size;
+    const StoreFileHeader *header;
+    ParameterSet params;
+    uint64_t seed;
+    ForecastResult result;
+} ForecastStore;
+
+// Maps the file and checks its layout; nothing is read beyond the header
+// and tables until used. 0 on success.
+int forecast_store_open(ForecastStore *store, const char *path);
+void forecast_store_close(ForecastStore *store);
+int forecast_store_has_paths(const ForecastStore *store);
+
+// Zero-copy view of one month of the stored paths from `first` to the end
+// of its chunk: returns how many paths users/profit point at, 0 without
+// stored paths or out of range. Either output may be NULL.
+int forecast_store_month(const ForecastStore *store, int month, int first, const double **users,
+                         const double **profit);
+// Copies one path's users and cumulative profit (months values each, NULL
+// to skip) and break-even month; pages in one row of its chunk per month.
+int forecast_store_path(const ForecastStore *store, int path, double *users, double *profit,
+                        int *break_even_month);
+
+#endif
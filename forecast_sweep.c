@@ -0,0 +1,226 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "forecast_sweep.h"
+
+static const char *summary_names[] = {
+    "mean_final_profit",
+    "std_final_profit",
+    "p5_final_profit",
+    "p50_final_profit",
+    "p95_final_profit",
+    "risk_of_no_return",
+    "avg_break_even_month"
+};
+
+#define SUMMARY_COLUMNS (int)(sizeof(summary_names) / sizeof(summary_names[0]))
+
+void sweep_init(SweepSpec *spec, const ParameterSet *base) {
+    memset(spec, 0, sizeof(*spec));
+    spec->base = *base;
+}
+
+void sweep_free(SweepSpec *spec) {
+    for (int i = 0; i < spec->axis_count; i++) {
+        free(spec->axes[i].values);
+    }
+    spec->axis_count = 0;
+}
+
+int sweep_add_axis(SweepSpec *spec, const char *arg) {
+    const char *eq = strchr(arg, '=');
+    if (!eq || spec->axis_count == SWEEP_MAX_AXES) return -1;
+
+    char name[64];
+    size_t length = (size_t)(eq - arg);
+    if (length >= sizeof(name)) return -1;
+    memcpy(name, arg, length);
+    name[length] = '\0';
+    const ParameterField *field = parameter_field_find(name);
+    if (!field || field->stage == PARAM_RUN) return -1;
+    for (int i = 0; i < spec->axis_count; i++) {
+        if (spec->axes[i].field == field) return -1;
+    }
+
+    const char *list = eq + 1;
+    double *values = NULL;
+    int count = 0;
+    double start, stop;
+    int steps;
+    char tail;
+    if (sscanf(list, "%lf:%lf:%d%c", &start, &stop, &steps, &tail) == 3) {
+        if (steps < 1) return -1;
+        values = malloc(steps * sizeof(double));
+        if (!values) return -1;
+        for (int i = 0; i < steps; i++) {
+            values[i] = steps == 1 ? start : start + (stop - start) * i / (steps - 1);
+        }
+        count = steps;
+    } else {
+        for (const char *p = list; p; p = strchr(p, ',')) {
+            if (*p == ',') p++;
+            char *next;
+            double value = strtod(p, &next);
+            if (next == p || (*next != ',' && *next != '\0')) {
+                free(values);
+                return -1;
+            }
+            double *grown = realloc(values, (count + 1) * sizeof(double));
+            if (!grown) {
+                free(values);
+                return -1;
+            }
+            values = grown;
+            values[count++] = value;
+        }
+    }
+
+    SweepAxis *axis = &spec->axes[spec->axis_count++];
+    axis->field = field;
+    axis->count = count;
+    axis->values = values;
+    return 0;
+}
+
+long long sweep_point_count(const SweepSpec *spec) {
+    long long points = 1;
+    for (int i = 0; i < spec->axis_count; i++) {
+        points *= spec->axes[i].count;
+    }
+    return points;
+}
+
+void sweep_result_free(SweepResult *result) {
+    if (result->columns) {
+        for (int i = 0; i < result->column_count; i++) {
+            free(result->columns[i]);
+        }
+    }
+    free(result->columns);
+    free(result->names);
+    memset(result, 0, sizeof(*result));
+}
+
+// Applies the index-th combination of the listed axes to params, with the
+// last axis varying fastest.
+static void apply_point(const SweepSpec *spec, const int *axes, int axis_count, long long index, ParameterSet *params) {
+    for (int i = axis_count - 1; i >= 0; i--) {
+        const SweepAxis *axis = &spec->axes[axes[i]];
+        parameter_set(params, axis->field, axis->values[index % axis->count]);
+        index /= axis->count;
+    }
+}
+
+int sweep_run(const SweepSpec *spec, const ForecastOptions *options, SweepResult *result) {
+    memset(result, 0, sizeof(*result));
+
+    // Growth axes outermost, so every run of finance points shares paths.
+    int order[SWEEP_MAX_AXES];
+    int growth_axes = 0;
+    long long growth_points = 1;
+    long long finance_points = 1;
+    for (int i = 0; i < spec->axis_count; i++) {
+        if (spec->axes[i].field->stage == PARAM_GROWTH) {
+            order[growth_axes++] = i;
+            growth_points *= spec->axes[i].count;
+        }
+    }
+    int finance_axes = 0;
+    for (int i = 0; i < spec->axis_count; i++) {
+        if (spec->axes[i].field->stage != PARAM_GROWTH) {
+            order[growth_axes + finance_axes++] = i;
+            finance_points *= spec->axes[i].count;
+        }
+    }
+
+    result->rows = growth_points * finance_points;
+    result->column_count = spec->axis_count + SUMMARY_COLUMNS;
+    result->names = calloc(result->column_count, sizeof(char *));
+    result->columns = calloc(result->column_count, sizeof(double *));
+    if (!result->names || !result->columns) goto fail;
+    for (int i = 0; i < result->column_count; i++) {
+        result->columns[i] = malloc(result->rows * sizeof(double));
+        if (!result->columns[i]) goto fail;
+        result->names[i] = i < spec->axis_count ? spec->axes[order[i]].field->name
+                                                : summary_names[i - spec->axis_count];
+    }
+
+    // Every finance point of a growth point runs in one pass over its paths.
+    if (finance_points > INT_MAX) goto fail;
+    ParameterSet *scenarios = malloc(finance_points * sizeof(ParameterSet));
+    ScenarioSummary *summaries = malloc(finance_points * sizeof(ScenarioSummary));
+    if (!scenarios || !summaries) {
+        free(scenarios);
+        free(summaries);
+        goto fail;
+    }
+
+    long long row = 0;
+    for (long long g = 0; g < growth_points; g++) {
+        ParameterSet growth = spec->base;
+        apply_point(spec, order, growth_axes, g, &growth);
+        int count = (int)finance_points;
+        for (int s = 0; s < count; s++) {
+            scenarios[s] = growth;
+            apply_point(spec, order + growth_axes, finance_axes, s, &scenarios[s]);
+        }
+        if (forecast_run_scenarios(scenarios, count, options, summaries) != 0) {
+            free(scenarios);
+            free(summaries);
+            goto fail;
+        }
+
+        for (int s = 0; s < count; s++, row++) {
+            for (int i = 0; i < spec->axis_count; i++) {
+                result->columns[i][row] = parameter_get(&scenarios[s], spec->axes[order[i]].field);
+            }
+            const ScenarioSummary *summary = &summaries[s];
+            double values[SUMMARY_COLUMNS] = {
+                summary->mean_final_profit, summary->std_final_profit, summary->p5_final_profit,
+                summary->p50_final_profit, summary->p95_final_profit, summary->risk_of_no_return,
+                summary->avg_break_even_month
+            };
+            for (int i = 0; i < SUMMARY_COLUMNS; i++) {
+                result->columns[spec->axis_count + i][row] = values[i];
+            }
+        }
+    }
+
+    free(scenarios);
+    free(summaries);
+    return 0;
+
+fail:
+    sweep_result_free(result);
+    return -1;
+}
+
+int sweep_write(const SweepResult *result, const SweepSpec *spec, uint64_t seed, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (!file) return -1;
+
+    SweepFileHeader header = {0};
+    memcpy(header.magic, SWEEP_FILE_MAGIC, sizeof(SWEEP_FILE_MAGIC));
+    header.version = SWEEP_FILE_VERSION;
+    header.column_count = result->column_count;
+    header.rows = result->rows;
+    header.iterations = spec->base.iterations;
+    header.seed = seed;
+
+    int failed = fwrite(&header, sizeof(header), 1, file) != 1;
+    uint64_t offset = sizeof(header) + (uint64_t)result->column_count * sizeof(SweepFileColumn);
+    for (int i = 0; i < result->column_count && !failed; i++) {
+        SweepFileColumn column = {{0}, offset};
+        strncpy(column.name, result->names[i], sizeof(column.name) - 1);
+        failed = fwrite(&column, sizeof(column), 1, file) != 1;
+        offset += result->rows * sizeof(double);
+    }
+    for (int i = 0; i < result->column_count && !failed; i++) {
+        failed = fwrite(result->columns[i], sizeof(double), result->rows, file) != (size_t)result->rows;
+    }
+
+    if (fclose(file) != 0) failed = 1;
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,71 @@
+#ifndef FORECAST_SWEEP_H
+#define FORECAST_SWEEP_H
+
+#include <stdint.h>
+
+#include "forecast_core.h"
+
+#define SWEEP_MAX_AXES 16
+
+// One swept field and the values it takes.
+typedef struct {
+    const ParameterField *field;
+    int count;
+    double *values;
+} SweepAxis;
+
+// Cartesian product of the axes applied on top of a base parameter set.
+typedef struct {
+    ParameterSet base;
+    int axis_count;
+    SweepAxis axes[SWEEP_MAX_AXES];
+} SweepSpec;
+
+void sweep_init(SweepSpec *spec, const ParameterSet *base);
+void sweep_free(SweepSpec *spec);
+
+// Parses "field=start:stop:count" (count evenly spaced values, both ends
+// included) or "field=v1,v2,..." and appends it as an axis. Sweeps run
+// every path, so run fields such as the tolerances are no axes.
+int sweep_add_axis(SweepSpec *spec, const char *arg);
+long long sweep_point_count(const SweepSpec *spec);
+
+// One row per grid point and one column per axis followed by the summary
+// columns of ScenarioSummary. Rows are ordered with the growth axes
+// outermost; the axis columns say which point a row is.
+typedef struct {
+    long long rows;
+    int column_count;
+    const char **names;
+    double **columns;
+} SweepResult;
+
+// Runs every grid point. Points that differ only in storage or finance
+// fields are evaluated together on one set of simulated user paths.
+int sweep_run(const SweepSpec *spec, const ForecastOptions *options, SweepResult *result);
+void sweep_result_free(SweepResult *result);
+
+// Columnar file layout, host byte order:
+//   SweepFileHeader
+//   SweepFileColumn[column_count]
+//   each column: rows doubles, contiguous, starting at its offset
+#define SWEEP_FILE_MAGIC "FCSWEEP"
+#define SWEEP_FILE_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t column_count;
+    uint64_t rows;
+    uint64_t iterations;
+    uint64_t seed;
+} SweepFileHeader;
+
+typedef struct {
+    char name[56];
+    uint64_t offset;
+} SweepFileColumn;
+
+int sweep_write(const SweepResult *result, const SweepSpec *spec, uint64_t seed, const char *path);
+
+#endif
@@ -0,0 +1,212 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "forecast_trace.h"
+
+// Events kept per thread and capture, about 0.5 MiB per traced thread.
+#define TRACE_EVENTS 8192
+
+typedef struct {
+    const char *name;
+    int stage;                      // -1 for trace_span() events
+    uint64_t start;
+    uint64_t dur;
+    uint64_t paths;
+    uint64_t stage_ns[TRACE_STAGE_COUNT];
+} TraceEvent;
+
+// Written only by the owning thread, with relaxed atomic stores where
+// readers may look concurrently. Buffers outlive their threads so the
+// totals keep counting work of finished runs.
+typedef struct TraceBuffer {
+    struct TraceBuffer *next;
+    int tid;
+    uint64_t ns[TRACE_STAGE_COUNT];
+    uint64_t paths;
+    unsigned capture;               // capture the events belong to
+    int count;
+    int dropped;
+    TraceEvent events[TRACE_EVENTS];
+} TraceBuffer;
+
+const char *const trace_stage_names[TRACE_STAGE_COUNT] = {
+    "setup", "growth", "finance", "aggregate", "draw", "render"
+};
+
+int trace_on;
+
+static pthread_mutex_t buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceBuffer *buffers;
+static int buffer_count;
+static unsigned capture;
+static uint64_t capture_start;
+static __thread TraceBuffer *local;
+
+uint64_t trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec + 1;
+}
+
+void trace_enable(int on) {
+    pthread_mutex_lock(&buffers_lock);
+    if (on && !trace_on) capture_start = trace_now();
+    __atomic_store_n(&trace_on, on, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&buffers_lock);
+}
+
+static TraceBuffer *local_buffer(void) {
+    if (local) return local;
+    TraceBuffer *buffer = calloc(1, sizeof(TraceBuffer));
+    if (!buffer) return NULL;
+    pthread_mutex_lock(&buffers_lock);
+    buffer->tid = ++buffer_count;
+    buffer->capture = capture;
+    buffer->next = buffers;
+    __atomic_store_n(&buffers, buffer, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&buffers_lock);
+    local = buffer;
+    return buffer;
+}
+
+static void add_relaxed(uint64_t *total, uint64_t value) {
+    __atomic_store_n(total, *total + value, __ATOMIC_RELAXED);
+}
+
+// Claims the next event slot of the current capture, or NULL when full.
+static TraceEvent *next_event(TraceBuffer *buffer) {
+    unsigned current = __atomic_load_n(&capture, __ATOMIC_ACQUIRE);
+    if (buffer->capture != current) {
+        __atomic_store_n(&buffer->count, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&buffer->dropped, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&buffer->capture, current, __ATOMIC_RELEASE);
+    }
+    if (buffer->count == TRACE_EVENTS) {
+        __atomic_store_n(&buffer->dropped, buffer->dropped + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    return &buffer->events[buffer->count];
+}
+
+// Publishes the event returned by next_event().
+static void commit_event(TraceBuffer *buffer) {
+    __atomic_store_n(&buffer->count, buffer->count + 1, __ATOMIC_RELEASE);
+}
+
+void trace_slice(TraceStage stage, uint64_t start, uint64_t end) {
+    TraceBuffer *buffer = local_buffer();
+    if (!buffer) return;
+    add_relaxed(&buffer->ns[stage], end - start);
+
+    TraceEvent *event = next_event(buffer);
+    if (!event) return;
+    memset(event, 0, sizeof(*event));
+    event->name = trace_stage_names[stage];
+    event->stage = stage;
+    event->start = start;
+    event->dur = end - start;
+    commit_event(buffer);
+}
+
+void trace_span(const char *name, uint64_t start, uint64_t end, const uint64_t *stage_ns, uint64_t paths) {
+    TraceBuffer *buffer = local_buffer();
+    if (!buffer) return;
+    for (int stage = 0; stage < TRACE_STAGE_COUNT; stage++) {
+        if (stage_ns[stage]) add_relaxed(&buffer->ns[stage], stage_ns[stage]);
+    }
+    add_relaxed(&buffer->paths, paths);
+
+    TraceEvent *event = next_event(buffer);
+    if (!event) return;
+    event->name = name;
+    event->stage = -1;
+    event->start = start;
+    event->dur = end - start;
+    event->paths = paths;
+    memcpy(event->stage_ns, stage_ns, sizeof(event->stage_ns));
+    commit_event(buffer);
+}
+
+void trace_totals(TraceTotals *totals) {
+    memset(totals, 0, sizeof(*totals));
+    for (TraceBuffer *buffer = __atomic_load_n(&buffers, __ATOMIC_ACQUIRE); buffer; buffer = buffer->next) {
+        for (int stage = 0; stage < TRACE_STAGE_COUNT; stage++) {
+            totals->ns[stage] += __atomic_load_n(&buffer->ns[stage], __ATOMIC_RELAXED);
+        }
+        totals->paths += __atomic_load_n(&buffer->paths, __ATOMIC_RELAXED);
+    }
+}
+
+void trace_overlay_update(TraceOverlay *overlay) {
+    uint64_t now = trace_now();
+    overlay->frames++;
+    if (overlay->last_ns == 0) {
+        trace_totals(&overlay->last);
+        overlay->last_ns = now;
+        overlay->frames = 0;
+        return;
+    }
+    double seconds = (now - overlay->last_ns) * 1e-9;
+    if (seconds < 0.5) return;
+
+    TraceTotals totals;
+    trace_totals(&totals);
+    for (int stage = 0; stage < TRACE_STAGE_COUNT; stage++) {
+        overlay->ms_per_frame[stage] = (totals.ns[stage] - overlay->last.ns[stage]) * 1e-6 / overlay->frames;
+    }
+    overlay->paths_per_second = (totals.paths - overlay->last.paths) / seconds;
+    overlay->fps = overlay->frames / seconds;
+    overlay->last = totals;
+    overlay->last_ns = now;
+    overlay->frames = 0;
+}
+
+static void write_event(FILE *f, const TraceEvent *event, int tid, uint64_t origin, int *first) {
+    fprintf(f, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+            *first ? "" : ",", event->name, event->stage >= TRACE_DRAW ? "ui" : "engine", tid,
+            (event->start - origin) * 1e-3, event->dur * 1e-3);
+    *first = 0;
+    if (event->stage >= 0) {
+        fprintf(f, "}");
+        return;
+    }
+    fprintf(f, ",\"args\":{\"paths\":%llu", (unsigned long long)event->paths);
+    for (int stage = 0; stage < TRACE_STAGE_COUNT; stage++) {
+        if (event->stage_ns[stage]) {
+            fprintf(f, ",\"%s_us\":%.3f", trace_stage_names[stage], event->stage_ns[stage] * 1e-3);
+        }
+    }
+    fprintf(f, "}}");
+}
+
+int trace_write_chrome(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+
+    pthread_mutex_lock(&buffers_lock);
+    unsigned current = capture;
+    uint64_t origin = capture_start;
+    int first = 1;
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (TraceBuffer *buffer = buffers; buffer; buffer = buffer->next) {
+        if (__atomic_load_n(&buffer->capture, __ATOMIC_ACQUIRE) != current) continue;
+        int count = __atomic_load_n(&buffer->count, __ATOMIC_ACQUIRE);
+        for (int i = 0; i < count; i++) {
+            if (buffer->events[i].start >= origin) write_event(f, &buffer->events[i], buffer->tid, origin, &first);
+        }
+        int dropped = __atomic_load_n(&buffer->dropped, __ATOMIC_RELAXED);
+        if (dropped) {
+            fprintf(f, "%s\n{\"name\":\"dropped events\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"count\":%d}}",
+                    first ? "" : ",", buffer->tid, dropped);
+            first = 0;
+        }
+    }
+    fprintf(f, "\n]}\n");
+    __atomic_store_n(&capture, current + 1, __ATOMIC_RELEASE);
+    capture_start = trace_now();
+    pthread_mutex_unlock(&buffers_lock);
+    return fclose(f) == 0 ? 0 : -1;
+}
@@ -0,0 +1,84 @@
+#ifndef FORECAST_TRACE_H
+#define FORECAST_TRACE_H
+
+#include <stdint.h>
+
+// Stage timers compiled into the engine and the front-ends. Off by default,
+// when every probe costs one load and branch. Once enabled each thread
+// records into its own buffer, so the hot paths take no locks and share no
+// cache lines; the overlay and the Chrome trace export sum the buffers.
+typedef enum {
+    TRACE_SETUP,        // growth curve, company-size sampler, buffers
+    TRACE_GROWTH,       // user paths, including the company-size draws
+    TRACE_FINANCE,      // storage, revenue/expense math, per-month moments
+    TRACE_AGGREGATE,    // sketches, merges and the result arrays
+    TRACE_DRAW,         // front-end widgets and charts
+    TRACE_RENDER,       // submitting the frame to the GPU and presenting it
+    TRACE_STAGE_COUNT
+} TraceStage;
+
+extern const char *const trace_stage_names[TRACE_STAGE_COUNT];
+extern int trace_on;
+
+static inline int trace_enabled(void) {
+    return __atomic_load_n(&trace_on, __ATOMIC_RELAXED);
+}
+
+void trace_enable(int on);
+// Monotonic nanoseconds; never 0, so 0 can mean "not timing".
+uint64_t trace_now(void);
+
+// Adds [start, end) to the calling thread's totals for stage and logs it as
+// one trace event.
+void trace_slice(TraceStage stage, uint64_t start, uint64_t end);
+// Logs one event called name over [start, end) for work whose stages are
+// interleaved too finely to log one by one: stage_ns[] (time per stage
+// within it) and paths go to the totals and the event's arguments.
+void trace_span(const char *name, uint64_t start, uint64_t end, const uint64_t *stage_ns, uint64_t paths);
+
+// Scoped timer: TRACE_BEGIN(t); ...; TRACE_END(TRACE_GROWTH, t);
+#define TRACE_BEGIN(var) uint64_t var = trace_enabled() ? trace_now() : 0
+#define TRACE_END(stage, var)                                                                        \
+    do {                                                                                             \
+        if (var) trace_slice(stage, var, trace_now());                                               \
+    } while (0)
+
+// Adds the time since *mark to *ns and moves the mark to now. No-op while
+// *mark is 0, i.e. when tracing was off as the span began.
+static inline void trace_lap(uint64_t *mark, uint64_t *ns) {
+    if (*mark) {
+        uint64_t now = trace_now();
+        *ns += now - *mark;
+        *mark = now;
+    }
+}
+
+// Thread time per stage summed over every thread since start-up.
+typedef struct {
+    uint64_t ns[TRACE_STAGE_COUNT];
+    uint64_t paths;
+} TraceTotals;
+
+void trace_totals(TraceTotals *totals);
+
+// Rates for the on-screen overlays, refreshed about twice a second from
+// the totals. Stage times are summed over threads, so with a busy pool
+// they can exceed the frame time.
+typedef struct {
+    TraceTotals last;
+    uint64_t last_ns;
+    int frames;
+    double fps;
+    double ms_per_frame[TRACE_STAGE_COUNT];
+    double paths_per_second;
+} TraceOverlay;
+
+// Call once per frame.
+void trace_overlay_update(TraceOverlay *overlay);
+
+// Writes the events logged since tracing was enabled or since the last
+// write as Chrome trace-event JSON (chrome://tracing, Perfetto) and starts
+// a new capture. Events past a per-thread limit are dropped. 0 on success.
+int trace_write_chrome(const char *path);
+
+#endif
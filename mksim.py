@@ -34,9 +34,10 @@ class Market:
             print(f"Product {product_id} sold {sales} units")
 
 # Example usage
-consumers = [Consumer(id=i, budget=np.random.uniform(100, 500), preference=np.random.uniform(0, 1)) for i in range(100)]
-products = [Product(id=i, price=np.random.uniform(10, 50), quality=np.random.uniform(0, 1)) for i in range(5)]
+if __name__ == "__main__":
+    consumers = [Consumer(id=i, budget=np.random.uniform(100, 500), preference=np.random.uniform(0, 1)) for i in range(100)]
+    products = [Product(id=i, price=np.random.uniform(10, 50), quality=np.random.uniform(0, 1)) for i in range(5)]
 
-market = Market(consumers, products)
-market.simulate(months=12)
-market.report()
\ No newline at end of file
+    market = Market(consumers, products)
+    market.simulate(months=12)
+    market.report()
\ No newline at end of file
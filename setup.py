@@ -1,8 +1,19 @@
 from cx_Freeze import setup, Executable
+from setuptools import Extension
 import sys
 
+# The native engine forecast.py runs on; `make python` builds the same module
+fcforecast = Extension(
+    "fcforecast",
+    sources=["forecast_python.c", "forecast_core.c", "forecast_sampler.c", "forecast_kernel.c",
+             "forecast_sketch.c", "forecast_sweep.c", "forecast_cache.c", "forecast_store.c",
+             "forecast_trace.c", "forecast_market.c", "forecast_rules.c"],
+    extra_compile_args=["-O2", "-pthread"],
+    extra_link_args=["-pthread"],
+)
+
 # Dependencies are automatically detected, but it might need fine tuning.
-build_exe_options = {"packages": ["numpy", "tkinter", "matplotlib"], "excludes": []}
+build_exe_options = {"packages": ["numpy", "tkinter", "matplotlib"], "includes": ["fcforecast"], "excludes": []}
 
 # Determine the base for the executable
 base = None
@@ -14,5 +25,6 @@ setup(
     version="0.1",
     description="Forecast Application",
     options={"build_exe": build_exe_options},
+    ext_modules=[fcforecast],
     executables=[Executable("forecast.py", base=base)]
 )
@@ -0,0 +1,130 @@
+# Runs fcforecast-market and mksim.py's Market.simulate on the same market
+# dumps and compares sales per product and month, the number of buyers and
+# the budget left.
+#
+#     python3 tests/test_market.py [./fcforecast-market]
+
+import os
+import random
+import re
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import mksim
+
+
+def read_market(path):
+    with open(path) as f:
+        numbers = f.read().split()
+    consumers, products = int(numbers[0]), int(numbers[1])
+    values = [float(x) for x in numbers[2:]]
+    assert len(values) == 2 * (consumers + products), path
+    return ([mksim.Consumer(i, values[2 * i], values[2 * i + 1]) for i in range(consumers)],
+            [mksim.Product(j, values[2 * (consumers + j)], values[2 * (consumers + j) + 1]) for j in range(products)])
+
+
+def write_market(path, consumers, products):
+    with open(path, "w") as f:
+        f.write(f"{len(consumers)} {len(products)}\n")
+        for c in consumers:
+            f.write(f"{c.budget!r} {c.preference!r}\n")
+        for p in products:
+            f.write(f"{p.price!r} {p.quality!r}\n")
+
+
+def python_run(path, months):
+    """Per-month sales, buyers and budget left from Market.simulate."""
+    consumers, products = read_market(path)
+    initial = [c.budget for c in consumers]
+    market = mksim.Market(consumers, products)
+    monthly = []
+    for _ in range(months):
+        before = dict(market.sales)
+        market.simulate(months=1)
+        monthly.append([market.sales[p.id] - before[p.id] for p in products])
+    buyers = sum(c.budget != b for c, b in zip(consumers, initial))
+    return [market.sales[p.id] for p in products], monthly, buyers, sum(c.budget for c in consumers)
+
+
+def native_run(binary, args, months):
+    run = subprocess.run([binary, "-m", str(months), "-M"] + args, capture_output=True, text=True, check=True)
+    sales = [int(m) for m in re.findall(r"^Product \d+ sold (\d+) units$", run.stdout, re.M)]
+    monthly = [[int(x) for x in line.split(":")[1].split()]
+               for line in run.stdout.splitlines() if line.startswith("Month ")]
+    summary = re.match(r"(\d+) of \d+ consumers bought, \$(-?[\d.]+) budget left", run.stderr)
+    return sales, monthly, int(summary.group(1)), float(summary.group(2))
+
+
+def compare(name, binary, path, months, threads, extra=()):
+    expected = python_run(path, months)
+    failures = 0
+    for t in threads:
+        sales, monthly, buyers, left = native_run(binary, ["-i", path, "-t", str(t)] + list(extra), months)
+        problems = []
+        if sales != expected[0]:
+            problems.append(f"sales {sales} != {expected[0]}")
+        if monthly != expected[1]:
+            month = next((m for m in range(months) if m >= len(monthly) or monthly[m] != expected[1][m]), months)
+            problems.append(f"month {month + 1} differs")
+        if buyers != expected[2]:
+            problems.append(f"buyers {buyers} != {expected[2]}")
+        if abs(left - expected[3]) > 0.011:
+            problems.append(f"budget left {left:.2f} != {expected[3]:.2f}")
+        for problem in problems:
+            print(f"test_market: {name}, {t} threads: {problem}", file=sys.stderr)
+        failures += bool(problems)
+    return failures
+
+
+def grid_market(rng, consumers, products):
+    """Values on coarse grids, so budgets run down to exactly a price and
+    preferences equal qualities."""
+    return ([mksim.Consumer(i, rng.randrange(0, 40) * 12.5, rng.randrange(0, 9) / 8) for i in range(consumers)],
+            [mksim.Product(j, rng.randrange(1, 9) * 12.5, rng.randrange(0, 9) / 8) for j in range(products)])
+
+
+def uniform_market(rng, consumers, products):
+    """mksim.py's example distributions."""
+    return ([mksim.Consumer(i, rng.uniform(100, 500), rng.uniform(0, 1)) for i in range(consumers)],
+            [mksim.Product(j, rng.uniform(10, 50), rng.uniform(0, 1)) for j in range(products)])
+
+
+def main():
+    binary = sys.argv[1] if len(sys.argv) > 1 else "./fcforecast-market"
+    rng = random.Random(20240517)
+    failures = 0
+    with tempfile.TemporaryDirectory() as directory:
+        path = os.path.join(directory, "market.txt")
+        cases = [
+            ("example", uniform_market(rng, 100, 5), 12),
+            ("ties", grid_market(rng, 9000, 12), 14),
+            ("uniform", uniform_market(rng, 5000, 40), 24),
+            ("one product", grid_market(rng, 300, 1), 50),
+            ("no products", grid_market(rng, 10, 0), 3),
+            ("no consumers", grid_market(rng, 0, 4), 3),
+        ]
+        for name, (consumers, products), months in cases:
+            write_market(path, consumers, products)
+            failures += compare(name, binary, path, months, [1, 3])
+        # Sizes past MARKET_MAX_SIZE or int are refused before any allocation.
+        for header in ("2147483647 1", "4294967297 1", "1 2147483647", "1073741825 0"):
+            with open(path, "w") as f:
+                f.write(header + "\n")
+            run = subprocess.run([binary, "-i", path], capture_output=True, text=True)
+            if run.returncode != 1 or "cannot read" not in run.stderr:
+                print(f"test_market: header {header!r}: exit {run.returncode}, {run.stderr.strip()!r}",
+                      file=sys.stderr)
+                failures += 1
+        # The native example market, dumped by -o, reads back the same.
+        subprocess.run([binary, "-c", "3000", "-k", "25", "-s", "7", "-o", path], capture_output=True, check=True)
+        failures += compare("generated", binary, path, 12, [2])
+    if failures:
+        print(f"test_market: {failures} failures", file=sys.stderr)
+        sys.exit(1)
+    print("test_market: ok")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,358 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "forecast_core.h"
+#include "forecast_rules.h"
+
+// Checks the finance rules compiler and interpreter against values computed
+// by hand: operator precedence, folded constants against the uniform and
+// per-path rows, `if` and `once`, compile errors, and cloud_storage.rules
+// on traced and simulated paths.
+
+#define PATHS 8
+
+static int failures;
+
+#define CHECK(cond, ...) do {                               \
+        if (!(cond)) {                                      \
+            failures++;                                     \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__);                   \
+            fprintf(stderr, "\n");                          \
+        }                                                   \
+    } while (0)
+
+static int close_to(double a, double b) {
+    return a == b || fabs(a - b) <= 1e-9 * fmax(1, fmax(fabs(a), fabs(b)));
+}
+
+static double python_mod(double a, double b) {
+    return a - b * floor(a / b);
+}
+
+// Expressions over placeholders X, Y and Z with the value a C expression of
+// x, y and z gives for them.
+#define EXPRESSION_CASES(CASE)                                                  \
+    CASE("revenue r = X + Y * Z", x + y * z)                                    \
+    CASE("revenue r = (X + Y) * Z", (x + y) * z)                                \
+    CASE("revenue r = X - Y - Z", x - y - z)                                    \
+    CASE("revenue r = X / Y / Z", x / y / z)                                    \
+    CASE("revenue r = X ^ Y ^ 2", pow(x, pow(y, 2)))                            \
+    CASE("revenue r = -X ^ 2", -pow(x, 2))                                      \
+    CASE("revenue r = 2 * -X", 2 * -x)                                          \
+    CASE("revenue r = Z % Y", python_mod(z, y))                                 \
+    CASE("revenue r = X % -Y", python_mod(x, -y))                               \
+    CASE("revenue r = X * 2 + 3 * 4", x * 2 + 12)                               \
+    CASE("revenue r = X < Y + Z", x < y + z)                                    \
+    CASE("revenue r = X > Y and Z < 0 or not X == 3", (x > y && z < 0) || !(x == 3)) \
+    CASE("revenue r = not X > Y or Z >= 0 and Z != 1", !(x > y) || (z >= 0 && z != 1)) \
+    CASE("revenue r = min(X, Y) + max(Y, Z) * floor(Z)", fmin(x, y) + fmax(y, z) * floor(z)) \
+    CASE("revenue r = exp(log(X)) - X", exp(log(x)) - x)                        \
+    CASE("revenue r = X if Y > Z", y > z ? x : 0)                               \
+    CASE("revenue r = X + 1 if Z < 0 or Y == 2", z < 0 || y == 2 ? x + 1 : 0)   \
+    CASE("monthly m = X * Y", -(x * y))                                         \
+    CASE("let a = X * 2\nextra e = 1 if a > 6\nrevenue r = a + Y", 2 * x + y - (2 * x > 6)) \
+    CASE("let a = X\nlet b = a * Y\nmonthly m = b - Z if b > a", -(x * y > x ? x * y - z : 0))
+
+// Which row each placeholder reads from: a literal folded at compile time,
+// a parameter (uniform at run time) or a per-path variable.
+typedef enum {
+    BIND_CONSTANT,
+    BIND_PARAMETER,
+    BIND_PATH
+} Binding;
+
+static const char *const binding_names[] = {"constant", "parameter", "path"};
+
+typedef struct {
+    ParameterSet params;
+    double users[PATHS];
+    double cumulative[PATHS];
+} Fixture;
+
+// X is users or initial_investment, Y storage or colocation_expense, Z
+// cumulative or marketing_expense; every value is exact in a float.
+static void fixture_init(Fixture *f) {
+    f->params = parameter_sets[0];
+    f->params.avg_gb_per_user = 0.5f;
+    f->params.initial_investment = 3;
+    f->params.colocation_expense = 2;
+    f->params.marketing_expense = -1.5f;
+    for (int i = 0; i < PATHS; i++) {
+        f->users[i] = 3 + i;
+        f->cumulative[i] = -1.5 + 0.25 * i;
+    }
+}
+
+static void bound_values(const Fixture *f, const Binding binding[3], int path, double *x, double *y, double *z) {
+    *x = binding[0] == BIND_PATH ? f->users[path] : 3;
+    *y = binding[1] == BIND_PATH ? f->users[path] * 0.5 : 2;
+    *z = binding[2] == BIND_PATH ? f->cumulative[path] : -1.5;
+}
+
+// The rule text with X, Y and Z replaced as bound.
+static void substitute(const char *text, const Binding binding[3], char *out, size_t size) {
+    static const char *const names[3][3] = {
+        {"3", "initial_investment", "users"},
+        {"2", "colocation_expense", "storage"},
+        {"(-1.5)", "marketing_expense", "cumulative"},
+    };
+    size_t n = 0;
+    for (const char *p = text; *p && n + 32 < size; p++) {
+        int slot = *p == 'X' ? 0 : *p == 'Y' ? 1 : *p == 'Z' ? 2 : -1;
+        if (slot < 0) {
+            out[n++] = *p;
+        } else {
+            n += snprintf(out + n, size - n, "%s", names[slot][binding[slot]]);
+        }
+    }
+    out[n] = '\0';
+}
+
+// Net cash flow of one step of the fixture's paths under text; 0 on success.
+static int evaluate(const char *text, const Fixture *f, int count, double *net) {
+    char error[256];
+    ForecastRules *rules = forecast_rules_compile(text, error, sizeof(error));
+    if (!rules) {
+        fprintf(stderr, "cannot compile \"%s\": %s\n", text, error);
+        return -1;
+    }
+    RulesScratch *scratch = forecast_rules_scratch_create(rules);
+    RulesRow row = {&f->params, 3, 5, f->users, NULL, f->cumulative, count};
+    double balance[PATHS];
+    forecast_rules_open(rules, scratch, &row, balance);
+    forecast_rules_step(rules, scratch, &row, net);
+    forecast_rules_scratch_free(scratch);
+    forecast_rules_free(rules);
+    return 0;
+}
+
+static void test_expressions(void) {
+    Fixture f;
+    fixture_init(&f);
+    static const Binding bindings[][3] = {
+        {BIND_CONSTANT, BIND_CONSTANT, BIND_CONSTANT},
+        {BIND_PARAMETER, BIND_PARAMETER, BIND_PARAMETER},
+        {BIND_PATH, BIND_PATH, BIND_PATH},
+        {BIND_PARAMETER, BIND_PATH, BIND_CONSTANT},
+        {BIND_PATH, BIND_CONSTANT, BIND_PARAMETER},
+    };
+    int cases = 0;
+#define RUN_CASE(text, value)                                                   \
+    for (size_t b = 0; b < sizeof(bindings) / sizeof(bindings[0]); b++) {       \
+        char rule[512];                                                         \
+        double net[PATHS];                                                      \
+        substitute(text, bindings[b], rule, sizeof(rule));                      \
+        cases++;                                                                \
+        if (evaluate(rule, &f, PATHS, net) != 0) {                              \
+            failures++;                                                         \
+            continue;                                                           \
+        }                                                                       \
+        for (int i = 0; i < PATHS; i++) {                                       \
+            double x, y, z;                                                     \
+            bound_values(&f, bindings[b], i, &x, &y, &z);                       \
+            double expected = (value);                                          \
+            CHECK(close_to(net[i], expected), "\"%s\" (X %s, Y %s, Z %s) path %d: %.17g, expected %.17g", \
+                  text, binding_names[bindings[b][0]], binding_names[bindings[b][1]], \
+                  binding_names[bindings[b][2]], i, net[i], expected);   \
+        }                                                                       \
+    }
+    EXPRESSION_CASES(RUN_CASE)
+#undef RUN_CASE
+    printf("expressions: %d rule texts\n", cases);
+}
+
+// Initial rules and lets at step 0, and the variables each step sees.
+static void test_open_and_variables(void) {
+    Fixture f;
+    fixture_init(&f);
+    f.params.step_days = 7;
+    double previous[PATHS], balance[PATHS], net[PATHS];
+    for (int i = 0; i < PATHS; i++) previous[i] = f.users[i] - i;
+
+    char error[256];
+    ForecastRules *rules = forecast_rules_compile(
+        "let fee = 10 * step_months   # per week\n"
+        "initial setup = 100 + users\n"
+        "initial license = fee\n"
+        "revenue r = new_users * 1000 + month * 100 + step + companies / 10\n"
+        "monthly m = fee\n", error, sizeof(error));
+    CHECK(rules, "compile: %s", error);
+    if (!rules) return;
+    RulesScratch *scratch = forecast_rules_scratch_create(rules);
+    double step_months = 7 / FORECAST_DAYS_PER_MONTH;
+    RulesRow row = {&f.params, 0, 5, f.users, NULL, NULL, PATHS};
+    forecast_rules_open(rules, scratch, &row, balance);
+    row.step = 4;
+    row.previous_users = previous;
+    row.cumulative = f.cumulative;
+    forecast_rules_step(rules, scratch, &row, net);
+    for (int i = 0; i < PATHS; i++) {
+        CHECK(close_to(balance[i], -(100 + f.users[i]) - 10 * step_months), "open path %d: %g", i, balance[i]);
+        double expected = i * 1000 + 4 * step_months * 100 + 4 + 0.5 - 10 * step_months;
+        CHECK(close_to(net[i], expected), "step path %d: %.17g, expected %.17g", i, net[i], expected);
+    }
+    forecast_rules_scratch_free(scratch);
+    forecast_rules_free(rules);
+}
+
+// `once` pays each path at its own first qualifying step, and again after
+// forecast_rules_open() starts a new group of paths.
+static void test_once(void) {
+    Fixture f;
+    fixture_init(&f);
+    char error[256];
+    ForecastRules *rules = forecast_rules_compile(
+        "extra once overage = users * 10 if users > 6\n"
+        "revenue once launch = 1000\n"
+        "revenue every = 1 if users > 6\n", error, sizeof(error));
+    CHECK(rules, "compile: %s", error);
+    if (!rules) return;
+    RulesScratch *scratch = forecast_rules_scratch_create(rules);
+    for (int group = 0; group < 2; group++) {
+        double users[PATHS], balance[PATHS], net[PATHS], total[PATHS] = {0};
+        RulesRow row = {&f.params, 0, 5, users, NULL, NULL, PATHS};
+        for (int i = 0; i < PATHS; i++) users[i] = i;
+        forecast_rules_open(rules, scratch, &row, balance);
+        for (int step = 0; step < 6; step++) {
+            for (int i = 0; i < PATHS; i++) users[i] = i + step;
+            row.step = step;
+            forecast_rules_step(rules, scratch, &row, net);
+            for (int i = 0; i < PATHS; i++) total[i] += net[i];
+        }
+        for (int i = 0; i < PATHS; i++) {
+            // users = i + step first exceeds 6 at step max(0, 7 - i).
+            int first = i >= 7 ? 0 : 7 - i;
+            double overage = first < 6 ? (i + first) * 10 : 0;
+            double every = first < 6 ? 6 - first : 0;
+            double expected = 1000 - overage + every;
+            CHECK(close_to(total[i], expected), "group %d path %d: %g, expected %g", group, i, total[i], expected);
+        }
+    }
+    forecast_rules_scratch_free(scratch);
+    forecast_rules_free(rules);
+}
+
+static void test_errors(void) {
+    static const struct {
+        const char *text;
+        const char *error;
+    } cases[] = {
+        {"revenue r =", "line 1: expected a value"},
+        {"revenue r = 1 +", "line 1: expected a value"},
+        {"revenue r = * 2", "line 1: expected a value"},
+        {"let a = 1\n\nrevenue r = (a + 1", "line 3: expected )"},
+        {"revenue r = min(1)", "line 1: expected ,"},
+        {"revenue r = 1 2", "line 1: unexpected 2"},
+        {"revenue r = foo", "line 1: unknown name foo"},
+        {"revenue r = sqrt(2)", "line 1: unknown function sqrt"},
+        {"bonus r = 1", "line 1: unknown rule kind bonus"},
+        {"= 1", "line 1: expected let, initial, monthly, extra or revenue"},
+        {"revenue = 1", "line 1: expected a rule name"},
+        {"let users = 1", "line 1: name already in use: users"},
+        {"let price_per_gb = 1", "line 1: name already in use: price_per_gb"},
+        {"let a = 1\nlet a = 2", "line 2: name already in use: a"},
+        {"initial once setup = 1", "line 1: initial rules are always paid once"},
+        {"revenue r = 1 if", "line 1: expected a value"},
+    };
+    char error[256];
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        ForecastRules *rules = forecast_rules_compile(cases[i].text, error, sizeof(error));
+        CHECK(!rules && strcmp(error, cases[i].error) == 0, "\"%s\": got \"%s\", expected \"%s\"", cases[i].text,
+              rules ? "(compiled)" : error, cases[i].error);
+        forecast_rules_free(rules);
+    }
+
+    // Every pending operand takes a stack slot, even a foldable one.
+    char deep[1024] = "revenue r = ";
+    for (int depth = 0; depth < 40; depth++) strcat(deep, "users + (");
+    strcat(deep, "1");
+    for (int depth = 0; depth < 40; depth++) strcat(deep, ")");
+    ForecastRules *rules = forecast_rules_compile(deep, error, sizeof(error));
+    CHECK(!rules && strcmp(error, "line 1: expression too deep") == 0, "deep expression: %s",
+          rules ? "(compiled)" : error);
+    forecast_rules_free(rules);
+
+    char shallow[256] = "revenue r = ";
+    for (int depth = 0; depth < 10; depth++) strcat(shallow, "users + (");
+    strcat(shallow, "1");
+    for (int depth = 0; depth < 10; depth++) strcat(shallow, ")");
+    rules = forecast_rules_compile(shallow, error, sizeof(error));
+    CHECK(rules != NULL, "shallow expression: %s", error);
+    forecast_rules_free(rules);
+}
+
+// cloud_storage.rules against its cash flows worked out step by step on
+// traced paths, and full runs against the traces.
+static void test_cloud_storage(void) {
+    char error[256];
+    ForecastRules *rules = forecast_rules_load("cloud_storage.rules", error, sizeof(error));
+    CHECK(rules, "cloud_storage.rules: %s", error);
+    if (!rules) return;
+
+    static const int steps[] = {0, 7};
+    for (size_t s = 0; s < sizeof(steps) / sizeof(steps[0]); s++) {
+        ParameterSet params = parameter_sets[1];
+        params.iterations = 600;
+        params.months = 60;
+        params.step_days = steps[s];
+        int months = params.months;
+        double step_months = parameter_step_months(&params);
+        double price = params.price_per_gb, gb = params.avg_gb_per_user;
+
+        ForecastPool *pool = forecast_pool_create(3);
+        ForecastOptions options = {pool, 42};
+        options.rules = rules;
+        double *users = malloc((size_t)months * params.iterations * sizeof(double));
+        double *profit = malloc((size_t)months * params.iterations * sizeof(double));
+        int *break_even = malloc(params.iterations * sizeof(int));
+        double *traced_users = malloc(months * sizeof(double));
+        double *traced_profit = malloc(months * sizeof(double));
+        int status = forecast_simulate_paths(&params, &options, 0, params.iterations, users, profit, break_even);
+        CHECK(status == 0, "simulate paths failed");
+
+        static const int paths[] = {0, 1, 255, 256, 599};
+        for (size_t p = 0; status == 0 && p < sizeof(paths) / sizeof(paths[0]); p++) {
+            int path = paths[p], traced_break_even;
+            forecast_trace_path(&params, 42, rules, path, traced_users, traced_profit, &traced_break_even);
+            double cumulative = -200;
+            int expected_break_even = -1;
+            for (int month = 0; month < months; month++) {
+                double storage = traced_users[month] * gb;
+                cumulative += storage * price * step_months - 200 * step_months - storage * 0.02 * step_months;
+                if (expected_break_even < 0 && cumulative >= 0) expected_break_even = month;
+                CHECK(close_to(traced_profit[month], cumulative), "step_days %d path %d month %d: %.17g, expected %.17g",
+                      steps[s], path, month, traced_profit[month], cumulative);
+                size_t cell = (size_t)month * params.iterations + path;
+                CHECK(users[cell] == traced_users[month] && profit[cell] == traced_profit[month],
+                      "step_days %d path %d month %d: run and trace differ", steps[s], path, month);
+            }
+            CHECK(traced_break_even == expected_break_even && break_even[path] == expected_break_even,
+                  "step_days %d path %d: break-even %d / %d, expected %d", steps[s], path, traced_break_even,
+                  break_even[path], expected_break_even);
+        }
+        free(users);
+        free(profit);
+        free(break_even);
+        free(traced_users);
+        free(traced_profit);
+        forecast_pool_destroy(pool);
+    }
+    forecast_rules_free(rules);
+}
+
+int main(void) {
+    test_expressions();
+    test_open_and_variables();
+    test_once();
+    test_errors();
+    test_cloud_storage();
+    if (failures) {
+        fprintf(stderr, "test_rules: %d failures\n", failures);
+        return 1;
+    }
+    printf("test_rules: ok\n");
+    return 0;
+}
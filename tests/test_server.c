@@ -0,0 +1,500 @@
+// Checks the forecast daemon's JSON and HTTP parsing and its result cache.
+// The daemon is one translation unit, so it is included whole with its
+// main() renamed.
+#define main server_main
+#include "forecast_server.c"
+#undef main
+
+static int failures;
+
+#define CHECK(cond, ...) do {                               \
+        if (!(cond)) {                                      \
+            failures++;                                     \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__);                   \
+            fprintf(stderr, "\n");                          \
+        }                                                   \
+    } while (0)
+
+// The single member of a one-member object: its string or number. 0 if
+// it parsed.
+static int parse_one(const char *json, JsonMember *member) {
+    char error[128];
+    int count = json_parse_object(json, strlen(json), member, 1, error, sizeof(error));
+    return count == 1 ? 0 : -1;
+}
+
+static void test_strings(void) {
+    static const struct {
+        const char *json;
+        const char *value;      // NULL: must not parse
+    } cases[] = {
+        {"{\"k\": \"plain\"}", "plain"},
+        {"{\"k\": \"\\\"\\\\\\/\\b\\f\\n\\r\\t\"}", "\"\\/\b\f\n\r\t"},
+        {"{\"k\": \"\\u0041\\u00e9\\u20AC\"}", "A\xC3\xA9\xE2\x82\xAC"},
+        {"{\"k\": \"\\ud83d\\ude00!\"}", "\xF0\x9F\x98\x80!"},
+        {"{\"k\": \"\\uDBFF\\uDFFF\"}", "\xF4\x8F\xBF\xBF"},
+        {"{\"k\": \"caf\xC3\xA9\"}", "caf\xC3\xA9"},
+        {"{\"k\": \"\\x41\"}", NULL},
+        {"{\"k\": \"\\u12\"}", NULL},
+        {"{\"k\": \"\\u12g4\"}", NULL},
+        {"{\"k\": \"\\ud83d\"}", NULL},
+        {"{\"k\": \"\\ud83dx\"}", NULL},
+        {"{\"k\": \"\\ud83d\\u0041\"}", NULL},
+        {"{\"k\": \"\\ude00\"}", NULL},
+        {"{\"k\": \"tab\there\"}", NULL},
+        {"{\"k\": \"open}", NULL},
+        {"{\"k\": \"ends in \\", NULL},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        JsonMember member;
+        int status = parse_one(cases[i].json, &member);
+        if (!cases[i].value) {
+            CHECK(status != 0, "%s: parsed", cases[i].json);
+            if (status == 0) members_free(&member, 1);
+            continue;
+        }
+        CHECK(status == 0 && member.type == JSON_STRING && strcmp(member.string, cases[i].value) == 0,
+              "%s: got \"%s\"", cases[i].json, status == 0 && member.string ? member.string : "(error)");
+        if (status == 0) members_free(&member, 1);
+    }
+}
+
+static void test_numbers_and_objects(void) {
+    static const struct {
+        const char *json;
+        int ok;
+        double value;
+    } cases[] = {
+        {"{\"k\": 2000}", 1, 2000},
+        {"{\"k\": 2000.0}", 1, 2000},
+        {"{\"k\": 2e3}", 1, 2000},
+        {"{\"k\": -0.25}", 1, -0.25},
+        {"{\"k\": 1e308}", 1, 1e308},
+        {"{\"k\": 1e400}", 0, 0},
+        {"{\"k\": -1e400}", 0, 0},
+        {"{\"k\": 1e}", 0, 0},
+        {"{\"k\": .}", 0, 0},
+        {"{\"k\": 1.2.3}", 0, 0},
+        {"{\"k\": nan}", 0, 0},
+        {"{\"k\": true}", 1, 1},
+        {"{\"k\": 1,}", 0, 0},
+        {"{\"k\" 1}", 0, 0},
+        {"{\"k\": 1} x", 0, 0},
+        {"[1]", 0, 0},
+        {"", 0, 0},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        JsonMember member;
+        int status = parse_one(cases[i].json, &member);
+        CHECK((status == 0) == cases[i].ok && (!cases[i].ok || member.number == cases[i].value),
+              "%s: status %d, value %g", cases[i].json, status, status == 0 ? member.number : 0);
+        if (status == 0) members_free(&member, 1);
+    }
+
+    JsonMember members[4];
+    char error[128];
+    const char *json = " { \"a\" : null , \"b\":false,\"c\" : \"\" } ";
+    int count = json_parse_object(json, strlen(json), members, 4, error, sizeof(error));
+    CHECK(count == 3 && members[0].type == JSON_NULL && members[1].type == JSON_BOOL && members[1].number == 0 &&
+          members[2].type == JSON_STRING && members[2].string[0] == '\0', "mixed object: %d", count);
+    if (count > 0) members_free(members, count);
+    json = "{\"a\": 1, \"b\": 2, \"c\": 3, \"d\": 4, \"e\": 5}";
+    CHECK(json_parse_object(json, strlen(json), members, 4, error, sizeof(error)) < 0 &&
+          strcmp(error, "more than 4 fields") == 0, "too many fields: %s", error);
+    CHECK(json_parse_object("{}", 2, members, 4, error, sizeof(error)) == 0, "empty object");
+}
+
+static int parse_request(const char *json, ForecastRequest *req, char *error) {
+    return request_parse(json, strlen(json), req, error, 128);
+}
+
+static void test_requests(void) {
+    static const struct {
+        const char *json;
+        const char *error;      // NULL: must parse
+        uint64_t seed;
+    } cases[] = {
+        {"{\"seed\": 42}", NULL, 42},
+        {"{\"seed\": \"42\"}", NULL, 42},
+        {"{\"seed\": \"18446744073709551615\"}", NULL, 18446744073709551615ull},
+        {"{\"seed\": \"0x10\"}", NULL, 16},
+        {"{\"seed\": 9007199254740992}", NULL, 9007199254740992ull},
+        {"{\"seed\": \"18446744073709551616\"}", "seed must be an unsigned 64-bit integer", 0},
+        {"{\"seed\": \"-1\"}", "seed must be an unsigned 64-bit integer", 0},
+        {"{\"seed\": \" 1\"}", "seed must be an unsigned 64-bit integer", 0},
+        {"{\"seed\": \"12ab\"}", "seed must be an unsigned 64-bit integer", 0},
+        {"{\"seed\": 1.5}", "seed must be an unsigned 64-bit integer", 0},
+        {"{\"seed\": -1}", "seed must be an unsigned 64-bit integer", 0},
+        {"{\"seed\": 1e20}", "seed must be an unsigned 64-bit integer", 0},
+        {"{\"seed\": true}", "seed must be an unsigned 64-bit integer", 0},
+        {"{\"preset\": 2}", "unknown preset", 0},
+        {"{\"preset\": 0.5}", "unknown preset", 0},
+        {"{\"preset\": \"Cloud\"}", "unknown preset", 0},
+        {"{\"iterations\": 1e12}", "iterations out of range", 0},
+        {"{\"iterations\": \"100\"}", "iterations must be a number", 0},
+        {"{\"price\": 1}", "unknown field 'price'", 0},
+        {"{\"rules\": 1}", "rules must be a string", 0},
+        {"{\"rules\": null}", NULL, 0},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        ForecastRequest req;
+        char error[128] = "";
+        int status = parse_request(cases[i].json, &req, error);
+        if (cases[i].error) {
+            CHECK(status != 0 && strcmp(error, cases[i].error) == 0, "%s: got \"%s\"", cases[i].json,
+                  status == 0 ? "(parsed)" : error);
+        } else {
+            CHECK(status == 0 && req.seed == cases[i].seed, "%s: status %d (%s), seed %llu", cases[i].json, status,
+                  error, (unsigned long long)req.seed);
+        }
+        if (status == 0) free(req.rules);
+    }
+}
+
+// Whether two requests name the same run, by their canonical keys.
+static int same_key(const char *a, const char *b) {
+    ForecastRequest requests[2];
+    char error[128];
+    unsigned char *keys[2] = {NULL, NULL};
+    size_t sizes[2] = {0, 0};
+    const char *json[2] = {a, b};
+    for (int i = 0; i < 2; i++) {
+        if (parse_request(json[i], &requests[i], error) != 0) {
+            fprintf(stderr, "%s: %s\n", json[i], error);
+            return -1;
+        }
+        keys[i] = request_key(&requests[i], &sizes[i]);
+        free(requests[i].rules);
+    }
+    int same = sizes[0] == sizes[1] && memcmp(keys[0], keys[1], sizes[0]) == 0;
+    free(keys[0]);
+    free(keys[1]);
+    return same;
+}
+
+static void test_keys(void) {
+    static const struct {
+        const char *a;
+        const char *b;
+        int same;
+    } cases[] = {
+        {"{\"iterations\": 2000}", "{\"iterations\": 2000.0}", 1},
+        {"{\"iterations\": 2000}", "{\"iterations\": 2e3}", 1},
+        {"{\"preset\": 1}", "{\"preset\": \"Cloud Server/S3\"}", 1},
+        {"{\"preset\": 1}", "{\"preset\": \"Cloud Server\\/S3\"}", 1},
+        {"{}", "{\"preset\": 0, \"seed\": 0}", 1},
+        {"{\"seed\": 7}", "{\"seed\": \"7\"}", 1},
+        {"{\"price_per_gb\": 0.1}", "{\"price_per_gb\": 0.10000000149011612}", 1},
+        {"{\"preset\": 1, \"price_per_gb\": 0.12}", "{\"price_per_gb\": 0.12, \"preset\": 1}", 1},
+        {"{\"rules\": null}", "{}", 1},
+        {"{\"preset\": 0}", "{\"preset\": 1}", 0},
+        {"{\"seed\": 7}", "{\"seed\": 8}", 0},
+        {"{\"rules\": \"revenue r = 1\"}", "{\"rules\": \"revenue r = 2\"}", 0},
+        {"{\"rules\": \"\"}", "{}", 0},
+        {"{\"iterations\": 2000}", "{\"iterations\": 2001}", 0},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        int same = same_key(cases[i].a, cases[i].b);
+        CHECK(same == cases[i].same, "%s vs %s: same %d, expected %d", cases[i].a, cases[i].b, same, cases[i].same);
+    }
+}
+
+static unsigned char *key_of(const char *text, size_t *size) {
+    *size = strlen(text);
+    unsigned char *key = malloc(*size);
+    memcpy(key, text, *size);
+    return key;
+}
+
+static char *body_of(const char *text, size_t *size) {
+    *size = strlen(text);
+    return strdup(text);
+}
+
+// Drops every cached body once the tests of a cache are done with it.
+static void cache_empty(ResultCache *cache) {
+    while (cache->oldest) cache_unlink(cache, cache->oldest);
+    CHECK(cache->entries == 0 && cache->bytes == 0, "cache left with %zu entries", cache->entries);
+}
+
+// A socketpair standing in for a client connection: fds[0] is the
+// server's end.
+static void client_open(int fds[2]) {
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        perror("socketpair");
+        exit(1);
+    }
+}
+
+static void test_eviction(void) {
+    ResultCache cache;
+    size_t size, body_size;
+    LookupOutcome outcome;
+    int client[2];
+    client_open(client);
+
+    // With no capacity every body is dropped once its requests let go.
+    cache_init(&cache, 0);
+    for (int round = 0; round < 2; round++) {
+        unsigned char *key = key_of("a", &size);
+        CacheEntry *entry = cache_lookup(&cache, key, size, client[0], &outcome);
+        CHECK(entry && outcome == LOOKUP_MISS, "capacity 0, round %d: outcome %d", round, outcome);
+        char *body = body_of("{\"x\": 1}\n", &body_size);
+        cache_settle(&cache, entry, 200, body, body_size);
+        CHECK(cache.entries == 0 && cache.bytes == 0 && !entry->linked, "capacity 0: entry kept");
+        CHECK(entry->status == 200 && strcmp(entry->body, "{\"x\": 1}\n") == 0, "capacity 0: body lost");
+        cache_release(&cache, entry);
+    }
+    CHECK(cache.misses == 2 && cache.hits == 0, "capacity 0: %llu misses, %llu hits", cache.misses, cache.hits);
+
+    // Room for two 10-byte bodies: the least recently used goes first.
+    cache_init(&cache, 20);
+    const char *keys[] = {"a", "b", "a", "c", "a", "b"};
+    const LookupOutcome expected[] = {LOOKUP_MISS, LOOKUP_MISS, LOOKUP_HIT, LOOKUP_MISS, LOOKUP_HIT, LOOKUP_MISS};
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        unsigned char *key = key_of(keys[i], &size);
+        CacheEntry *entry = cache_lookup(&cache, key, size, client[0], &outcome);
+        CHECK(entry && outcome == expected[i], "LRU lookup %zu (%s): outcome %d, expected %d", i, keys[i], outcome,
+              expected[i]);
+        if (!entry) continue;
+        if (outcome == LOOKUP_MISS) cache_settle(&cache, entry, 200, body_of("0123456789", &body_size), body_size);
+        cache_release(&cache, entry);
+        CHECK(cache.bytes <= cache.capacity, "LRU: %zu bytes over %zu", cache.bytes, cache.capacity);
+    }
+    CHECK(cache.entries == 2, "LRU: %zu entries", cache.entries);
+
+    // Failures reach the requester but are not kept.
+    unsigned char *key = key_of("bad", &size);
+    CacheEntry *entry = cache_lookup(&cache, key, size, client[0], &outcome);
+    cache_settle(&cache, entry, 400, body_of("{\"error\": \"x\"}\n", &body_size), body_size);
+    CHECK(entry->status == 400 && !entry->linked, "failure cached");
+    cache_release(&cache, entry);
+    key = key_of("bad", &size);
+    entry = cache_lookup(&cache, key, size, client[0], &outcome);
+    CHECK(outcome == LOOKUP_MISS, "failure hit: %d", outcome);
+    cache_settle(&cache, entry, 400, body_of("{}", &body_size), body_size);
+    cache_release(&cache, entry);
+    cache_empty(&cache);
+
+    close(client[0]);
+    close(client[1]);
+}
+
+typedef struct {
+    ResultCache *cache;
+    const char *key;
+    int fd;
+    CacheEntry *entry;
+    LookupOutcome outcome;
+} Waiter;
+
+static void *wait_lookup(void *arg) {
+    Waiter *waiter = arg;
+    size_t size;
+    unsigned char *key = key_of(waiter->key, &size);
+    waiter->entry = cache_lookup(waiter->cache, key, size, waiter->fd, &waiter->outcome);
+    return NULL;
+}
+
+// Blocks until `count` lookups have coalesced onto pending entries.
+static void await_coalesced(ResultCache *cache, unsigned long long count) {
+    for (;;) {
+        pthread_mutex_lock(&cache->lock);
+        unsigned long long coalesced = cache->coalesced;
+        pthread_mutex_unlock(&cache->lock);
+        if (coalesced >= count) return;
+        usleep(1000);
+    }
+}
+
+#define WAITERS 6
+
+static void test_coalescing(void) {
+    ResultCache cache;
+    cache_init(&cache, 1 << 20);
+    size_t size, body_size;
+    LookupOutcome outcome;
+    int runner[2], clients[WAITERS][2];
+    client_open(runner);
+
+    // Identical requests while the first runs wait for its body.
+    unsigned char *key = key_of("run", &size);
+    CacheEntry *entry = cache_lookup(&cache, key, size, runner[0], &outcome);
+    CHECK(outcome == LOOKUP_MISS, "first lookup: %d", outcome);
+    Waiter waiters[WAITERS];
+    pthread_t threads[WAITERS];
+    for (int i = 0; i < WAITERS; i++) {
+        client_open(clients[i]);
+        waiters[i] = (Waiter){&cache, "run", clients[i][0], NULL, LOOKUP_MISS};
+        pthread_create(&threads[i], NULL, wait_lookup, &waiters[i]);
+    }
+    await_coalesced(&cache, WAITERS);
+    CHECK(entry->clients == WAITERS + 1 && entry->refs == WAITERS + 1, "pending: %d clients, %d refs",
+          entry->clients, entry->refs);
+    cache_settle(&cache, entry, 200, body_of("{\"run\": 1}\n", &body_size), body_size);
+    for (int i = 0; i < WAITERS; i++) {
+        pthread_join(threads[i], NULL);
+        CHECK(waiters[i].entry == entry && waiters[i].outcome == LOOKUP_COALESCED &&
+              strcmp(waiters[i].entry->body, "{\"run\": 1}\n") == 0, "waiter %d: outcome %d", i, waiters[i].outcome);
+        cache_release(&cache, waiters[i].entry);
+    }
+    cache_release(&cache, entry);
+    CHECK(cache.misses == 1 && cache.coalesced == WAITERS && entry->refs == 0 && cache.entries == 1,
+          "after coalescing: %llu misses, %llu coalesced, %d refs", cache.misses, cache.coalesced, entry->refs);
+
+    // A waiter whose client hangs up stops waiting; the run goes on while
+    // its own requester is there.
+    key = key_of("slow", &size);
+    entry = cache_lookup(&cache, key, size, runner[0], &outcome);
+    Waiter waiter = {&cache, "slow", clients[0][0], NULL, LOOKUP_MISS};
+    pthread_t thread;
+    pthread_create(&thread, NULL, wait_lookup, &waiter);
+    await_coalesced(&cache, WAITERS + 1);
+    close(clients[0][1]);
+    pthread_join(thread, NULL);
+    CHECK(!waiter.entry && waiter.outcome == LOOKUP_ABANDONED && entry->clients == 1 && entry->refs == 1,
+          "abandoned waiter: outcome %d, %d clients, %d refs", waiter.outcome, entry->clients, entry->refs);
+    RunWatch watch = {&cache, entry, runner[0], 0};
+    CHECK(watch_progress(&watch, NULL) == 0 && entry->linked, "run cancelled with its requester waiting");
+
+    // Once the last requester has gone the run is cancelled and forgotten,
+    // so the next identical request starts afresh.
+    close(runner[1]);
+    CHECK(watch_progress(&watch, NULL) == 1 && !entry->linked && cache.cancelled == 1, "run not cancelled");
+    cache_settle(&cache, entry, 503, json_error("cancelled", &body_size), body_size);
+    cache_release(&cache, entry);
+    client_open(runner);
+    key = key_of("slow", &size);
+    entry = cache_lookup(&cache, key, size, runner[0], &outcome);
+    CHECK(outcome == LOOKUP_MISS, "after cancelling: outcome %d", outcome);
+    cache_settle(&cache, entry, 200, body_of("{}", &body_size), body_size);
+    cache_release(&cache, entry);
+    cache_empty(&cache);
+
+    close(runner[0]);
+    close(runner[1]);
+    close(clients[0][0]);
+    for (int i = 1; i < WAITERS; i++) {
+        close(clients[i][0]);
+        close(clients[i][1]);
+    }
+}
+
+// Everything the server sends on one connection for `request`, which
+// should end with the connection closing.
+static char *exchange(Server *server, const char *request) {
+    int fds[2];
+    client_open(fds);
+    Connection *connection = malloc(sizeof(Connection));
+    connection->server = server;
+    connection->fd = fds[0];
+    pthread_t thread;
+    pthread_create(&thread, NULL, serve_connection, connection);
+    if (write(fds[1], request, strlen(request)) != (ssize_t)strlen(request)) perror("write");
+
+    size_t size = 0, capacity = 1 << 16;
+    char *reply = malloc(capacity + 1);
+    ssize_t got;
+    while ((got = read(fds[1], reply + size, capacity - size)) > 0) {
+        size += got;
+        if (size == capacity) reply = realloc(reply, (capacity *= 2) + 1);
+    }
+    reply[size] = '\0';
+    pthread_join(thread, NULL);
+    close(fds[1]);
+    return reply;
+}
+
+static int count_of(const char *text, const char *needle) {
+    int count = 0;
+    for (const char *p = strstr(text, needle); p; p = strstr(p + 1, needle)) count++;
+    return count;
+}
+
+static void test_http(void) {
+    Server server;
+    server.pool = forecast_pool_create(2);
+    server.budget = 1e6;
+    server.origin = "null";
+    cache_init(&server.cache, 1 << 20);
+
+    // Pipelined requests on one kept-alive connection, the last closing it.
+    const char *body = "{\"preset\": 1, \"iterations\": 300, \"months\": 12}";
+    char request[2048];
+    snprintf(request, sizeof(request),
+             "GET /presets HTTP/1.1\r\nHost: x\r\n\r\n"
+             "POST /forecast HTTP/1.1\r\nContent-Length: %zu\r\n\r\n%s"
+             "POST /forecast HTTP/1.1\r\nContent-Length: %zu\r\nOrigin: null\r\n\r\n%s"
+             "GET /stats HTTP/1.1\r\nConnection: close\r\n\r\n",
+             strlen(body), body, strlen(body), body);
+    char *reply = exchange(&server, request);
+    CHECK(count_of(reply, "HTTP/1.1 200 OK\r\n") == 4, "pipelined: %d replies", count_of(reply, "HTTP/1.1 200"));
+    CHECK(count_of(reply, "X-Forecast-Cache: miss") == 1 && count_of(reply, "X-Forecast-Cache: hit") == 1,
+          "pipelined: cache headers");
+    CHECK(count_of(reply, "Access-Control-Allow-Origin: null\r\n") == 4, "pipelined: CORS headers");
+    CHECK(strstr(reply, "\"Cloud Server/S3\"") && strstr(reply, "\"hits\": 1, \"misses\": 1"), "pipelined: bodies");
+    CHECK(count_of(reply, "Connection: keep-alive") == 3 && count_of(reply, "Connection: close") == 1,
+          "pipelined: connection headers");
+    free(reply);
+
+    static const struct {
+        const char *head;       // request line and headers
+        const char *body;       // sent with its Content-Length, or NULL
+        const char *status;
+        const char *reply;      // expected in the reply body, or NULL
+    } cases[] = {
+        {"POST /forecast HTTP/1.1\r\nOrigin: https://example.com", "{}", "403 Forbidden", "origin not allowed"},
+        {"POST /forecast HTTP/1.1\r\nOrigin: nul", "{}", "403 Forbidden", "origin not allowed"},
+        {"OPTIONS /forecast HTTP/1.1\r\nOrigin: https://example.com", NULL, "403 Forbidden", NULL},
+        {"OPTIONS /forecast HTTP/1.1\r\norigin:null", NULL, "204 No Content", NULL},
+        {"POST /forecast HTTP/1.1\r\nContent-Length: 99999999", NULL, "413 Payload Too Large", "request too large"},
+        {"POST /forecast HTTP/1.1", "{\"iterations\": 100001, \"months\": 10}", "413 Payload Too Large",
+         "exceeds the budget of 1000000 path-months"},
+        {"POST /forecast HTTP/1.1", "{\"iterations\": 4294967296}", "400 Bad Request", "iterations out of range"},
+        {"POST /forecast HTTP/1.1", "{\"a\":", "400 Bad Request", "expected a flat JSON object near byte 5"},
+        {"POST /forecast HTTP/1.1", "{\"seed\": 1e400}", "400 Bad Request", "expected a flat JSON object"},
+        {"POST /forecast HTTP/1.1", "{\"preset\": \"\\ud83d\\ude00\"}", "400 Bad Request", "unknown preset"},
+        {"POST /forecast HTTP/1.1", "{\"preset\": \"\\ud83d\"}", "400 Bad Request", "expected a flat JSON object"},
+        {"POST /forecast HTTP/1.1", "{\"rules\": \"revenue r = \"}", "400 Bad Request", "rules: line 1"},
+        {"GET /forecast HTTP/1.1", NULL, "405 Method Not Allowed", NULL},
+        {"GET /nothing HTTP/1.1", NULL, "404 Not Found", "not found"},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (cases[i].body) {
+            snprintf(request, sizeof(request), "%s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n%s",
+                     cases[i].head, strlen(cases[i].body), cases[i].body);
+        } else {
+            snprintf(request, sizeof(request), "%s\r\nConnection: close\r\n\r\n", cases[i].head);
+        }
+        reply = exchange(&server, request);
+        char status[64];
+        snprintf(status, sizeof(status), "HTTP/1.1 %s\r\n", cases[i].status);
+        CHECK(strncmp(reply, status, strlen(status)) == 0 && count_of(reply, "HTTP/1.1 ") == 1 &&
+              (!cases[i].reply || strstr(reply, cases[i].reply)), "%s: %.60s", cases[i].head, reply);
+        free(reply);
+    }
+    // HTTP/1.0 closes after one reply.
+    reply = exchange(&server, "GET /stats HTTP/1.0\r\n\r\n");
+    CHECK(count_of(reply, "HTTP/1.1 200 OK") == 1 && strstr(reply, "Connection: close"), "HTTP/1.0: %.60s", reply);
+    free(reply);
+    cache_empty(&server.cache);
+    forecast_pool_destroy(server.pool);
+}
+
+int main(void) {
+    signal(SIGPIPE, SIG_IGN);
+    test_strings();
+    test_numbers_and_objects();
+    test_requests();
+    test_keys();
+    test_eviction();
+    test_coalescing();
+    test_http();
+    if (failures) {
+        fprintf(stderr, "test_server: %d failures\n", failures);
+        return 1;
+    }
+    printf("test_server: ok\n");
+    return 0;
+}